@@ -7,6 +7,11 @@ struct File {
     2: required binary content;
 }
 
+struct GenerationResults {
+    1: required list<File> files;
+    2: required bool finished;
+}
+
 exception InvalidConfiguration {
 1: string message,
 }
@@ -19,16 +24,41 @@ exception InvalidResource {
 1: string message,
 }
 
+exception InvalidJob {
+1: string message,
+}
+
 exception InternalServerError {
 1: string message,
 }
 
+exception BatchTimeout {
+1: string message,
+// The pdfs generated before the timeout, only set by generateCertificates
+2: list<File> files,
+}
+
+exception CompilationFailed {
+1: string message,
+2: string certificate,
+3: i32 exitCode,
+4: i32 passes,
+5: i64 wallTimeMs,
+// 0 if the compiler ran in a docker container, its usage is not measured
+6: i64 cpuTimeMs,
+7: i64 peakMemory,
+8: string logTail,
+}
+
 service CertificateGenerator {
-  void setConfigurationData(1:string configuration),
-  void addResourceFile(1:File resourceFile),
-  void addTemplateFile(1:File templateFile),
-  void addResourceFiles(1:list<File> resourceFiles),
-  void addTemplateFiles(1:list<File> templateFiles),
-  bool checkJob(),
-  list<File> generateCertificates(),
+  void setConfigurationData(1:string configuration) throws (1:InvalidConfiguration invalidConfiguration, 2:InternalServerError internalServerError),
+  void addResourceFile(1:File resourceFile) throws (1:InvalidResource invalidResource, 2:InternalServerError internalServerError),
+  void addTemplateFile(1:File templateFile) throws (1:InternalServerError internalServerError),
+  void addResourceFiles(1:list<File> resourceFiles) throws (1:InvalidResource invalidResource, 2:InternalServerError internalServerError),
+  void addTemplateFiles(1:list<File> templateFiles) throws (1:InternalServerError internalServerError),
+  bool checkJob() throws (1:InvalidConfiguration invalidConfiguration, 2:InvalidTemplate invalidTemplate, 3:InternalServerError internalServerError),
+  list<File> generateCertificates() throws (1:InvalidConfiguration invalidConfiguration, 2:InvalidTemplate invalidTemplate, 3:InternalServerError internalServerError, 4:BatchTimeout batchTimeout, 5:CompilationFailed compilationFailed),
+  string startGeneration() throws (1:InvalidJob invalidJob, 2:InvalidConfiguration invalidConfiguration, 3:InvalidTemplate invalidTemplate, 4:InternalServerError internalServerError),
+  GenerationResults fetchResults(1:string jobId, 2:i32 maxFiles) throws (1:InvalidJob invalidJob, 2:InvalidConfiguration invalidConfiguration, 3:InvalidTemplate invalidTemplate, 4:InternalServerError internalServerError, 5:BatchTimeout batchTimeout, 6:CompilationFailed compilationFailed),
+  GenerationResults pollResults(1:string jobId, 2:i32 maxFiles) throws (1:InvalidJob invalidJob, 2:InvalidConfiguration invalidConfiguration, 3:InvalidTemplate invalidTemplate, 4:InternalServerError internalServerError, 5:BatchTimeout batchTimeout, 6:CompilationFailed compilationFailed),
 }
@@ -1,117 +1,389 @@
 #include "Batch.hpp"
 
-sem_t Batch::globalRemainingWorkplaces;
-atomic_char Batch::globalRemainingWorkplacesInitialized = false;
-
-Batch::Batch(vector<Student> students, vector<TemplateCertificate> templateCertificates, const string& workingDirectory, const string& outputDirectory)
+Batch::Batch(vector<Student> students, vector<TemplateCertificate> templateCertificates, const string& workingDirectory, const string& outputDirectory, bool singleDocument, unsigned int studentsPerDocument)
 	: students(students)
 	, templateCertificates(templateCertificates)
 	, workingDirectory(workingDirectory)
 	, outputDirectory(outputDirectory)
+	, singleDocument(singleDocument)
+	, studentsPerDocument(max(studentsPerDocument, 1u))
+	, priority(DEFAULT_BATCH_PRIORITY)
+	, queueStatistics {}
+	, deadline(chrono::steady_clock::time_point::max())
+	, deadlineExceeded(false)
+	, killswitch(false)
 {
 }
 
 bool Batch::check() const
 {
 	//Check every student with every template
-	for (TemplateCertificate templateCertificate : templateCertificates) {
-		for (Student student : students) {
-			if (!templateCertificate.checkStudent(student)) {
-				return false;
+	bool valid = true;
+	students.forEachStudent([this, &valid](const Student& student) {
+		for (const TemplateCertificate& templateCertificate : templateCertificates) {
+			if (valid && !templateCertificate.checkStudent(student)) {
+				valid = false;
 			}
 		}
+		return valid;
+	});
+	return valid;
+}
+
+shared_ptr<JobQueue> Batch::getJobQueue()
+{
+	//The jobs are executed by the process wide worker pool, that also limits the total number of compilers
+	if (CONFIG.useThreads && !jobQueue) {
+		jobQueue = WorkerPool::get().createQueue(CONFIG.maxWorkersPerBatch, CONFIG.maxWorkersPerBatch * QUEUED_JOBS_PER_WORKER, priority);
+		jobQueue->setDeadline(deadline);
+	}
+	return jobQueue;
+}
+
+void Batch::prepareFormats()
+{
+	if (!CONFIG.precompilePreamble) {
+		return;
+	}
+	//Templates with the same preamble share a format, it is dumped only once
+	map<string, pair<Certificate, vector<TemplateCertificate*>>> formats;
+	for (TemplateCertificate& templateCertificate : templateCertificates) {
+		if (!templateCertificate.hasFormat()) {
+			continue;
+		}
+		Certificate formatCertificate = templateCertificate.generateFormatCertificate();
+		string formatName = formatCertificate.getName();
+		formats.try_emplace(formatName, move(formatCertificate), vector<TemplateCertificate*>()).first->second.second.push_back(&templateCertificate);
+	}
+
+	//The formats are dumped by the compilers of the batch
+	shared_ptr<JobQueue> jobQueue = getJobQueue();
+	exception_ptr failedJobException;
+	mutex exceptionMutex;
+	for (auto& [formatName, format] : formats) {
+		function<void()> job = [&format = format, &failedJobException, &exceptionMutex, this]() {
+			if (killswitch || checkDeadline()) {
+				return;
+			}
+			//Not every preamble can be dumped, those templates are compiled without a format
+			try {
+				Certificate& formatCertificate = format.first;
+				formatCertificate.setDeadline(deadline);
+				formatCertificate.setTrace(trace.get());
+				if (formatCertificate.generateFormat(workingDirectory, killswitch).empty()) {
+					//The batch got canceled
+					return;
+				}
+				for (TemplateCertificate* templateCertificate : format.second) {
+					templateCertificate->enableFormat();
+				}
+			} catch (const GeneratorError& error) {
+				spdlog::debug("Failed to precompile preamble, compiling without format: {}", error.what());
+			} catch (...) {
+				unique_lock<mutex> lock(exceptionMutex);
+				if (!failedJobException) {
+					failedJobException = std::current_exception();
+				}
+			}
+		};
+		if (jobQueue) {
+			jobQueue->submit(job);
+		} else {
+			job();
+		}
+	}
+	if (jobQueue) {
+		jobQueue->wait();
+	}
+	if (failedJobException) {
+		rethrow_exception(failedJobException);
 	}
-	return true;
 }
 
-void Batch::generateCertificates()
+void Batch::generateCertificates(const function<void(Certificate)>& outputCertificate, const function<void(CombinedCertificate)>& outputCombinedCertificate)
 {
-	for (TemplateCertificate templateCertificate : templateCertificates) {
-		for (Student student : students) {
-			certificates.push_back(templateCertificate.generateCertificate(student));
+	PdfCache* cache = PdfCache::get();
+	//The certificates of each template, that are not combined yet
+	vector<vector<Certificate>> parts(templateCertificates.size());
+	function<void(size_t)> combineParts = [&](size_t templateIndex) {
+		if (parts[templateIndex].size() == 1) {
+			outputCertificate(move(parts[templateIndex].front()));
+		} else if (parts[templateIndex].size() > 1) {
+			outputCombinedCertificate(templateCertificates[templateIndex].generateCombinedCertificate(parts[templateIndex]));
 		}
+		parts[templateIndex].clear();
+	};
+
+	//The students are read one at a time, so every template is applied to a student before the next one is read
+	students.forEachStudent([&](const Student& student) {
+		//The remaining students are not parsed, if the batch got canceled or timed out
+		if (killswitch || checkDeadline()) {
+			return false;
+		}
+		for (size_t i = 0; i < templateCertificates.size(); i++) {
+			TemplateCertificate& templateCertificate = templateCertificates[i];
+			if (!singleDocument || !templateCertificate.canCombine()) {
+				outputCertificate(templateCertificate.generateCertificate(student));
+				continue;
+			}
+			//Combine the certificates of up to studentsPerDocument students into one document
+			Certificate certificate = templateCertificate.generateCertificate(student);
+			//Cached certificates are retrieved separately
+			if (cache != nullptr && cache->contains(certificate.generateCacheKey(resourcesHash))) {
+				outputCertificate(move(certificate));
+			} else {
+				parts[i].push_back(move(certificate));
+			}
+			if (parts[i].size() >= studentsPerDocument) {
+				combineParts(i);
+			}
+		}
+		return true;
+	});
+	if (killswitch || checkDeadline()) {
+		return;
+	}
+	for (size_t i = 0; i < templateCertificates.size(); i++) {
+		combineParts(i);
 	}
 }
 
 void Batch::outputCertificates()
 {
+	static Metrics::Histogram& batchSeconds = Metrics::get().histogram("certgen_batch_seconds", "Time to render and compile the certificates of a batch");
+	static Metrics::Counter& batchErrors = Metrics::get().counter("certgen_batch_errors_total", "Batches, that failed or timed out");
+	static Metrics::Counter& batchTimeouts = Metrics::get().counter("certgen_batch_timeouts_total", "Batches, that did not finish before their deadline");
+	static Metrics::Counter& generatedPdfs = Metrics::get().counter("certgen_generated_pdfs_total", "Pdfs generated by batches");
+	Metrics::ScopedTimer timer(batchSeconds, &batchErrors);
 	outputFiles.clear();
-	if (CONFIG.useThreads) {
-		atomic_bool killswitch = false;
-		exception_ptr failedThreadException;
-		mutex failedThreadExceptionMutex;
-		sem_t remainingWorkplaces;
-		sem_init(&remainingWorkplaces, 0, CONFIG.maxWorkersPerBatch);
-		vector<thread> threads;
-		mutex outputFilesMutex;
-		for (Certificate certificate : certificates) {
-			threads.emplace_back([=, &outputFilesMutex, &remainingWorkplaces, &failedThreadException, &failedThreadExceptionMutex, &killswitch]() {
-				try {
-					sem_wait(&remainingWorkplaces);
-					sem_wait(&globalRemainingWorkplaces);
-					if (!killswitch) {
-						string generatedPDF = certificate.generatePDF(workingDirectory, outputDirectory, killswitch);
-						if (!killswitch) {
-							unique_lock<mutex> lock(outputFilesMutex);
-							outputFiles.push_back(generatedPDF);
-							lock.unlock();
-						}
-					}
-					sem_post(&globalRemainingWorkplaces);
-					sem_post(&remainingWorkplaces);
-				} catch (...) {
-					killswitch = true;
-					sem_post(&globalRemainingWorkplaces);
-					sem_post(&remainingWorkplaces);
-					unique_lock<mutex> lock(failedThreadExceptionMutex);
-					if (!failedThreadException) {
-						failedThreadException = std::current_exception();
-					}
-					lock.unlock();
-				}
-			});
+	exception_ptr failedJobException;
+	mutex outputFilesMutex;
+	shared_ptr<JobQueue> jobQueue = getJobQueue();
+
+	//Adds the generated pdfs of a job, the caller has to lock outputFilesMutex when using threads
+	function<void(const vector<filesystem::path>&)> addOutputFiles = [this](const vector<filesystem::path>& generatedPDFs) {
+		for (const filesystem::path& generatedPDF : generatedPDFs) {
+			if (generatedPDF.empty()) {
+				continue;
+			}
+			generatedPdfs.increment();
+			outputFiles.push_back(generatedPDF.string());
+			if (outputCallback) {
+				outputCallback(outputFiles.back());
+			}
 		}
-		for (thread& t : threads) {
-			t.join();
+	};
+
+	//Runs a job generating pdfs, on the worker pool if threads are used
+	//Jobs submitted by other jobs do not wait for a free place in the queue, as that could block every worker
+	function<void(function<vector<filesystem::path>()>, const string&, bool)> runJob = [&](function<vector<filesystem::path>()> job, const string& name, bool submittedByJob) {
+		if (!jobQueue) {
+			if (!killswitch && !checkDeadline()) {
+				addOutputFiles(job());
+			}
+			return;
 		}
-		unique_lock<mutex> lock(failedThreadExceptionMutex);
-		if (failedThreadException) {
-			rethrow_exception(failedThreadException);
+		chrono::steady_clock::time_point submitted = chrono::steady_clock::now();
+		function<void()> queuedJob = [job, name, submitted, &addOutputFiles, &outputFilesMutex, &failedJobException, this]() {
+			if (trace) {
+				trace->record(Trace::QUEUE_WAIT, submitted, chrono::steady_clock::now(), name);
+			}
+			if (killswitch || checkDeadline()) {
+				return;
+			}
+			try {
+				vector<filesystem::path> generatedPDFs = job();
+				if (!killswitch) {
+					unique_lock<mutex> lock(outputFilesMutex);
+					addOutputFiles(generatedPDFs);
+				}
+			} catch (...) {
+				//Compilers terminated at the deadline fail, the batch is reported as timed out instead
+				if (checkDeadline()) {
+					return;
+				}
+				killswitch = true;
+				ProcessReaper::get().notifyKillswitch();
+				unique_lock<mutex> lock(outputFilesMutex);
+				if (!failedJobException) {
+					failedJobException = std::current_exception();
+				}
+			}
+		};
+		jobQueue->submit(queuedJob, !submittedByJob);
+	};
+	//The jobs own their certificates, so the rendered content is freed as soon as the pdf is generated
+	function<void(Certificate, bool)> runCertificate = [&](Certificate certificate, bool submittedByJob) {
+		certificate.setDeadline(deadline);
+		certificate.setTrace(trace.get());
+		shared_ptr<const Certificate> jobCertificate = make_shared<const Certificate>(move(certificate));
+		function<vector<filesystem::path>()> job = [jobCertificate, this]() {
+			return vector<filesystem::path> { jobCertificate->generatePDF(workingDirectory, outputDirectory, killswitch, resourcesHash) };
+		};
+		runJob(job, jobCertificate->getName(), submittedByJob);
+	};
+	function<void(CombinedCertificate)> runCombinedCertificate = [&](CombinedCertificate combinedCertificate) {
+		combinedCertificate.setDeadline(deadline);
+		combinedCertificate.setTrace(trace.get());
+		shared_ptr<const CombinedCertificate> jobCertificate = make_shared<const CombinedCertificate>(move(combinedCertificate));
+		function<vector<filesystem::path>()> job = [jobCertificate, &runCertificate, this]() {
+			try {
+				return jobCertificate->generatePDFs(workingDirectory, outputDirectory, killswitch, resourcesHash);
+			} catch (const LatexExecutionError& error) {
+				//Some templates do not work in one document, their certificates are compiled one by one
+				spdlog::warn("Failed to compile {} as one document, compiling its certificates separately: {}", jobCertificate->getName(), error.what());
+				spdlog::debug("End of the log of {}:\n{}", jobCertificate->getName(), error.getRun().logTail);
+				for (const Certificate& part : jobCertificate->getParts()) {
+					runCertificate(part, true);
+				}
+				return vector<filesystem::path>();
+			}
+		};
+		runJob(job, jobCertificate->getName(), false);
+	};
+
+	//Certificates are compiled while the following ones are rendered
+	try {
+		generateCertificates([&runCertificate](Certificate certificate) { runCertificate(move(certificate), false); }, runCombinedCertificate);
+	} catch (...) {
+		//The queued jobs reference this stack frame, so they have to finish before it is left
+		if (jobQueue) {
+			cancel();
+			jobQueue->wait();
 		}
-	} else {
-		for (Certificate certificate : certificates) {
-			atomic_bool killswitch = false;
-			string generatedPDF = certificate.generatePDF(workingDirectory, outputDirectory, killswitch);
-			outputFiles.push_back(generatedPDF);
+		throw;
+	}
+
+	if (jobQueue) {
+		jobQueue->wait();
+		queueStatistics = jobQueue->getStatistics();
+		spdlog::debug("Batch {} ran {} compiler jobs, at most {} were queued, they waited {}ms at most", workingDirectory, queueStatistics.executedJobs, queueStatistics.peakQueuedJobs, chrono::duration_cast<chrono::milliseconds>(queueStatistics.maxWaitTime).count());
+		if (queueStatistics.droppedJobs > 0) {
+			deadlineExceeded = true;
 		}
 	}
+	if (deadlineExceeded) {
+		batchTimeouts.increment();
+		stringstream message;
+		message << "Batch exceeded its timeout of " << CONFIG.batchTimeout << " seconds, " << outputFiles.size() << " pdfs were generated";
+		throw BatchTimeoutError(message.str());
+	}
+	if (failedJobException) {
+		rethrow_exception(failedJobException);
+	}
+}
+
+bool Batch::checkDeadline()
+{
+	if (chrono::steady_clock::now() < deadline) {
+		return false;
+	}
+	deadlineExceeded = true;
+	return true;
 }
 
 void Batch::executeBatch()
 {
-	generateCertificates();
-	outputCertificates();
+	deadlineExceeded = false;
+	if (CONFIG.batchTimeout > 0) {
+		deadline = chrono::steady_clock::now() + chrono::seconds(CONFIG.batchTimeout);
+	}
+
+	//The compiler jobs of this batch are placed into a shared cgroup
+	CgroupManager* cgroups = CgroupManager::get();
+	if (cgroups != nullptr) {
+		cgroups->createBatchGroup(workingDirectory, priority * DEFAULT_CGROUP_WEIGHT / DEFAULT_BATCH_PRIORITY);
+	}
+	trace = make_unique<Trace>(traceId.empty() ? workingDirectory : traceId);
+	try {
+		//The format dumps and the compiler jobs share the queue of this execution
+		prepareFormats();
+		outputCertificates();
+	} catch (...) {
+		if (cgroups != nullptr) {
+			//The pooled containers of the batch run in its cgroup
+			if (DockerPool::get() != nullptr) {
+				DockerPool::get()->releaseBatch(workingDirectory);
+			}
+			cgroups->removeBatchGroup(workingDirectory);
+		}
+		jobQueue.reset();
+		finishTrace();
+		throw;
+	}
+	if (cgroups != nullptr) {
+		//The pooled containers of the batch run in its cgroup
+		if (DockerPool::get() != nullptr) {
+			DockerPool::get()->releaseBatch(workingDirectory);
+		}
+		cgroups->removeBatchGroup(workingDirectory);
+	}
+	jobQueue.reset();
+	finishTrace();
+}
+
+void Batch::finishTrace()
+{
+	spdlog::info(trace->summary());
+	spdlog::info(trace->compilerSummary());
+	//A trace, that can not be written, must not fail the batch
+	try {
+		filesystem::path traceFile = trace->writeChromeTrace();
+		if (!traceFile.empty()) {
+			spdlog::debug("Wrote trace of batch {} to {}", workingDirectory, traceFile.string());
+		}
+	} catch (const FileAccessError& error) {
+		spdlog::warn("Failed to write trace of batch {}: {}", workingDirectory, error.what());
+	}
+	trace.reset();
+}
+
+void Batch::setTraceId(const string& traceId)
+{
+	this->traceId = traceId;
 }
 
 Batch::Batch(json batchConfiguration)
+	: priority(DEFAULT_BATCH_PRIORITY)
+	, deadline(chrono::steady_clock::time_point::max())
+	, deadlineExceeded(false)
+	, killswitch(false)
 {
-	if (!globalRemainingWorkplacesInitialized.fetch_or(true)) {
-		spdlog::trace("Initialized global workers");
-		sem_init(&globalRemainingWorkplaces, 0, CONFIG.maxWorkers);
+	//The students are moved out of the configuration, so they are not copied
+	if (batchConfiguration.contains("students")) {
+		students = StudentStream(move(batchConfiguration["students"]));
 	}
+	loadConfiguration(move(batchConfiguration));
+}
+
+Batch::Batch(json batchConfiguration, StudentStream students)
+	: students(students)
+	, priority(DEFAULT_BATCH_PRIORITY)
+	, deadline(chrono::steady_clock::time_point::max())
+	, deadlineExceeded(false)
+	, killswitch(false)
+{
+	loadConfiguration(move(batchConfiguration));
+}
+
+void Batch::loadConfiguration(json batchConfiguration)
+{
 	try {
-		//Load students
-		spdlog::trace("Loading Students");
-		for (json person : batchConfiguration["students"]) {
-			cout << person["name"] << " " << person["surname"] << endl;
-			students.push_back(Student(person));
+		//The configuration is stored once and shared as global properties by all templates
+		if (batchConfiguration.is_object()) {
+			batchConfiguration.erase("students");
 		}
+		shared_ptr<const json> globalProperties = make_shared<const json>(move(batchConfiguration));
+		const json& configuration = *globalProperties;
+		const string& configuredWorkingDirectory = configuration.at("workingDirectory").get_ref<const string&>();
+
 		//Load templates
 		spdlog::trace("Loading Templates");
-		for (string templateFile : batchConfiguration["templates"]) {
+		for (const json& templateFileName : configuration.value("templates", json::array())) {
+			const string& templateFile = templateFileName.get_ref<const string&>();
 			filesystem::path templateFilePath(templateFile);
 			if (templateFilePath.is_relative()) {
-				templateFilePath = batchConfiguration["workingDirectory"].get<string>();
+				templateFilePath = configuredWorkingDirectory;
 				templateFilePath.append(templateFile);
 			}
 			spdlog::trace("Loading template file {}", templateFilePath.string());
@@ -129,13 +401,19 @@ Batch::Batch(json batchConfiguration)
 			//Generate base file name
 			string basename = templateFilePath.stem();
 
-			//TODO Maybe not push everything as global
-			templateCertificates.push_back(TemplateCertificate(basename, templateCertificateContent, batchConfiguration));
+			templateCertificates.emplace_back(basename, templateCertificateContent, globalProperties);
 		}
 
+		//Load single document mode
+		singleDocument = configuration.value("singleDocument", DEFAULT_SINGLE_DOCUMENT);
+		studentsPerDocument = max(configuration.value<unsigned int>("studentsPerDocument", DEFAULT_STUDENTS_PER_DOCUMENT), 1u);
+
+		//Load priority
+		setPriority(configuration.value<unsigned int>("priority", DEFAULT_BATCH_PRIORITY));
+
 		//Load directories
-		outputDirectory = batchConfiguration["outputDirectory"];
-		workingDirectory = batchConfiguration["workingDirectory"];
+		outputDirectory = configuration.at("outputDirectory").get<string>();
+		workingDirectory = configuredWorkingDirectory;
 		outputDirectory.append("/");
 		workingDirectory.append("/");
 		try {
@@ -149,10 +427,12 @@ Batch::Batch(json batchConfiguration)
 
 		//Copy resources to working directory
 		spdlog::trace("Copying Resources");
-		for (string resourceFile : batchConfiguration["resources"]) {
+		vector<filesystem::path> resourceFiles;
+		for (const json& resourceFileName : configuration.value("resources", json::array())) {
+			const string& resourceFile = resourceFileName.get_ref<const string&>();
 			filesystem::path resourceFilePath(resourceFile);
 			if (resourceFilePath.is_relative()) {
-				resourceFilePath = batchConfiguration["workingDirectory"].get<string>();
+				resourceFilePath = configuredWorkingDirectory;
 				resourceFilePath.append(resourceFile);
 			}
 			spdlog::trace("Loading resource file {}", resourceFilePath.string());
@@ -160,25 +440,20 @@ Batch::Batch(json batchConfiguration)
 			filesystem::path targetFilePath(workingDirectory);
 			targetFilePath.append(resourceFilePath.filename().string());
 
-			//Check if file is already there
-			error_code ec;
-			if (!filesystem::equivalent(targetFilePath, resourceFilePath, ec)) {
-				ifstream input(resourceFilePath, ios::in | ios::binary);
-				if (!input) {
-					stringstream message;
-					message << "Error reading resource file " << resourceFilePath.string();
-					throw FileAccessError(message.str());
-				}
-				ofstream output(targetFilePath, ios::out | ios::binary);
-				if (!input) {
-					stringstream message;
-					message << "Error writing resource file " << targetFilePath.string();
-					throw FileAccessError(message.str());
-				}
-				output << input.rdbuf();
-				output.close();
-				input.close();
+			stageResource(resourceFilePath, targetFilePath);
+			resourceFiles.push_back(targetFilePath);
+		}
+
+		//Hash resources, they are part of the key of cached pdfs
+		if (PdfCache::get() != nullptr) {
+			sort(resourceFiles.begin(), resourceFiles.end());
+			Sha256 resourcesHasher;
+			for (const filesystem::path& resourceFile : resourceFiles) {
+				resourcesHasher.update(resourceFile.filename().string());
+				resourcesHasher.update("\0", 1);
+				resourcesHasher.update(Sha256::hashFile(resourceFile));
 			}
+			resourcesHash = resourcesHasher.hexDigest();
 		}
 	} catch (const nlohmann::detail::exception&) {
 		stringstream message;
@@ -191,7 +466,68 @@ Batch::~Batch()
 {
 }
 
+void Batch::stageResource(const filesystem::path& resourceFile, const filesystem::path& targetFile)
+{
+	//Check if file is already there
+	error_code error;
+	if (filesystem::equivalent(targetFile, resourceFile, error)) {
+		return;
+	}
+	error.clear();
+	uintmax_t resourceSize = filesystem::file_size(resourceFile, error);
+	filesystem::file_time_type resourceTime = filesystem::last_write_time(resourceFile, error);
+	if (error) {
+		stringstream message;
+		message << "Error reading resource file " << resourceFile.string();
+		throw FileAccessError(message.str());
+	}
+
+	//Keep a copy staged by an earlier batch, if it did not change
+	uintmax_t targetSize = filesystem::file_size(targetFile, error);
+	if (!error && targetSize == resourceSize) {
+		if (filesystem::last_write_time(targetFile, error) == resourceTime && !error) {
+			return;
+		}
+		if (Sha256::hashFile(targetFile) == Sha256::hashFile(resourceFile)) {
+			filesystem::last_write_time(targetFile, resourceTime, error);
+			return;
+		}
+	}
+	error.clear();
+	filesystem::remove(targetFile, error);
+
+	//Link the resource, if that is not possible copy it
+	error.clear();
+	filesystem::create_hard_link(resourceFile, targetFile, error);
+	if (error) {
+		Certificate::copyFile(resourceFile, targetFile);
+		//The modification time shows, that the copy is up to date
+		filesystem::last_write_time(targetFile, resourceTime, error);
+	}
+}
+
 vector<string> Batch::getOutputFiles() const
 {
 	return outputFiles;
 }
+
+void Batch::setOutputCallback(function<void(const string&)> outputCallback)
+{
+	this->outputCallback = outputCallback;
+}
+
+void Batch::setPriority(unsigned int priority)
+{
+	this->priority = clamp(priority, 1u, (unsigned int)MAX_BATCH_PRIORITY);
+}
+
+JobQueue::Statistics Batch::getQueueStatistics() const
+{
+	return queueStatistics;
+}
+
+void Batch::cancel()
+{
+	killswitch = true;
+	ProcessReaper::get().notifyKillswitch();
+}
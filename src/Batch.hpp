@@ -2,17 +2,25 @@
 #define BATCH_HPP
 
 #include "Certificate.hpp"
+#include "CgroupManager.hpp"
+#include "CombinedCertificate.hpp"
 #include "Configuration.hpp"
 #include "Exceptions.hpp"
+#include "PdfCache.hpp"
+#include "Sha256.hpp"
 #include "Student.hpp"
+#include "StudentStream.hpp"
 #include "TemplateCertificate.hpp"
+#include "Trace.hpp"
+#include "WorkerPool.hpp"
 #include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
-#include <semaphore.h>
 #include <string>
 #include <thread>
 #include <vector>
@@ -23,6 +31,12 @@
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
 
+#define DEFAULT_SINGLE_DOCUMENT false
+#define DEFAULT_STUDENTS_PER_DOCUMENT 100
+#define QUEUED_JOBS_PER_WORKER 2
+#define DEFAULT_BATCH_PRIORITY DEFAULT_QUEUE_WEIGHT
+#define MAX_BATCH_PRIORITY MAX_QUEUE_WEIGHT
+
 using json = nlohmann::json;
 using namespace std;
 
@@ -37,19 +51,105 @@ using namespace std;
  * 
  * If the batch is executed, certificates from every template
  * will be generated for every student
+ *
+ * In single document mode the certificates of up to studentsPerDocument
+ * students are compiled as one CombinedCertificate and split afterwards.
+ * If a combined document fails to compile, its certificates are compiled
+ * one by one. Certificates that are in the PdfCache are never combined.
+ *
+ * Rendering and compiling are pipelined: Rendered certificates are queued
+ * for the compilers right away. At most QUEUED_JOBS_PER_WORKER jobs per
+ * compiler are waiting, when the queue is full rendering pauses.
+ *
+ * Concurrent batches share the compilers of the WorkerPool by their priority.
+ *
+ * The execution of a batch has to finish within Configuration::batchTimeout.
+ * At the deadline rendering stops, queued compiler jobs are dropped and
+ * running compilers are terminated. The PDFs generated so far are kept.
+ *
+ * Every execution is traced, the time spent in each stage of generating the
+ * pdfs is logged when it is finished. If Trace::setOutputDirectory was called,
+ * a Chrome trace of the execution is written.
  */
 class Batch {
 
 private:
-	vector<Student> students;
+	StudentStream students;
 	vector<TemplateCertificate> templateCertificates;
-	vector<Certificate> certificates;
 	vector<string> outputFiles;
 	string workingDirectory;
 	string outputDirectory;
-	static sem_t globalRemainingWorkplaces;
-	static atomic_char globalRemainingWorkplacesInitialized;
-	void generateCertificates();
+	string resourcesHash;
+	bool singleDocument;
+	unsigned int studentsPerDocument;
+	unsigned int priority;
+	JobQueue::Statistics queueStatistics;
+	chrono::steady_clock::time_point deadline;
+	atomic_bool deadlineExceeded;
+	atomic_bool killswitch;
+	function<void(const string&)> outputCallback;
+	string traceId;
+	unique_ptr<Trace> trace;
+	//The queue of the compiler jobs of the current execution
+	shared_ptr<JobQueue> jobQueue;
+
+	/** @brief Returns the queue of the compiler jobs of the current execution
+    * @return The queue, that is created on first use, nullptr if threads are not used
+    */
+	shared_ptr<JobQueue> getJobQueue();
+
+	/** @brief Dumps the formats of the templates with a precompiled preamble
+    *
+    * The formats are dumped by the compilers of the batch queue, the templates
+    * of formats that could not be dumped are compiled without a format.
+    */
+	void prepareFormats();
+
+	/** @brief Logs the summary of the trace of the execution and writes its Chrome trace
+    */
+	void finishTrace();
+
+	/** @brief Checks whether the deadline of the execution passed
+    * @return Boolean that indicates whether the deadline passed
+    *
+    * If the deadline passed, the batch is marked as timed out.
+    */
+	bool checkDeadline();
+
+	/** @brief Loads everything but the students from a batch configuration
+    * @param [in] batchConfiguration is a json containing the configuration values
+    * @throw InvalidConfigurationError if a configuration value is missing or invalid
+    * @throw FileAccessError if a template or resource can not be read
+    *
+    * The configuration becomes the global properties of the TemplateCertificates,
+    * it is stored once and referenced by all of them.
+    */
+	void loadConfiguration(json batchConfiguration);
+
+	/** @brief Puts a resource file into the working directory
+    * @param [in] resourceFile the path of the resource file
+    * @param [in] targetFile the path of the resource file in the working directory
+    * @throw FileAccessError if the resource file can not be read or staged
+    *
+    * The resource file is hardlinked, or copied with Certificate::copyFile, if linking
+    * is not possible. An existing target file is kept, if size and modification time
+    * or content are equal to the resource file.
+    */
+	static void stageResource(const filesystem::path& resourceFile, const filesystem::path& targetFile);
+
+	/** @brief Renders the certificates of all students
+    * @param [in] outputCertificate a function getting every certificate, that is compiled on its own
+    * @param [in] outputCombinedCertificate a function getting every combined certificate
+    *
+    * The functions are called as soon as a certificate is rendered. Rendering stops,
+    * if the batch gets canceled.
+    */
+	void generateCertificates(const function<void(Certificate)>& outputCertificate, const function<void(CombinedCertificate)>& outputCombinedCertificate);
+
+	/** @brief Renders the certificates and compiles them to the output directory
+    *
+    * The certificates are compiled on the worker pool while the following certificates are rendered.
+    */
 	void outputCertificates();
 
 public:
@@ -58,11 +158,13 @@ public:
     * @param [in] templateCertificates is a vector of TemplateCertificate
     * @param [in] workingDirectory a string specifying the directory to be used for temporary files
     * @param [in] outputDirectory a string specifying the directory where the pdf should be put
+    * @param [in] singleDocument a bool specifying whether the certificates of a template are compiled as one document
+    * @param [in] studentsPerDocument the maximum number of students in one document in single document mode
     * @return A pointer to the created Batch
     *
     * This method creates a Batch.
     */
-	Batch(vector<Student> students, vector<TemplateCertificate> templateCertificates, const string& workingDirectory, const string& outputDirectory);
+	Batch(vector<Student> students, vector<TemplateCertificate> templateCertificates, const string& workingDirectory, const string& outputDirectory, bool singleDocument = DEFAULT_SINGLE_DOCUMENT, unsigned int studentsPerDocument = DEFAULT_STUDENTS_PER_DOCUMENT);
 
 	/** @brief Constructor that creates a Batch from a json
     * @param [in] batchConfiguration is a json containing the configuration values
@@ -70,10 +172,21 @@ public:
     *
     * This method creates a Batch.
     * It loads the Students, the TemplateCertificates, the workingDirectory 
-    * and the outputDirectory from the batchConfiguration
+    * and the outputDirectory from the batchConfiguration.
+    * The optional values singleDocument and studentsPerDocument enable single document mode.
     */
 	Batch(json batchConfiguration);
 
+	/** @brief Constructor that creates a Batch from a json and a StudentStream
+    * @param [in] batchConfiguration is a json containing the configuration values, its students are ignored
+    * @param [in] students is a StudentStream containing the students of the batch
+    * @return A pointer to the created Batch
+    *
+    * This method creates a Batch like Batch(json), but the students are read
+    * from the StudentStream while the Batch is checked and executed.
+    */
+	Batch(json batchConfiguration, StudentStream students);
+
 	/** @brief Destructor that also deletes the working directory
     *
     * This method destroys a Batch and deletes the working directory
@@ -91,6 +204,8 @@ public:
     *
     * This method will generate the Certificates and
     * compile them to PDFs in the output folder.
+    * @throw BatchTimeoutError if the batch did not finish within Configuration::batchTimeout,
+    *        the PDFs generated until then are in the output folder
     */
 	void executeBatch();
 
@@ -100,6 +215,43 @@ public:
     * 
     */
 	vector<string> getOutputFiles() const;
+
+	/** @brief Sets a function, that is called for every generated PDF file
+    * @param [in] outputCallback a function getting the path of the generated PDF
+    *
+    * The function is called as soon as a PDF is in the output folder, while
+    * the batch is still executing. It may be called from multiple threads,
+    * but never concurrently.
+    */
+	void setOutputCallback(function<void(const string&)> outputCallback);
+
+	/** @brief Sets the priority of this batch
+    * @param [in] priority a int between 1 and MAX_BATCH_PRIORITY, DEFAULT_BATCH_PRIORITY if it is not set
+    *
+    * While other batches are executing, a batch gets a share of the compilers
+    * proportional to its priority. The priority also sets the cpu.weight of the
+    * cgroup of the batch.
+    */
+	void setPriority(unsigned int priority);
+
+	/** @brief Sets the id of the batch in its traces
+    * @param [in] traceId the id, like the id of the connection, the working directory is used if it is not set
+    */
+	void setTraceId(const string& traceId);
+
+	/** @brief Returns the statistics of the job queue of the last execution
+    * @return The number of compiler jobs and how long they waited for a compiler
+    *
+    * The statistics are empty, if the batch was not executed with threads.
+    */
+	JobQueue::Statistics getQueueStatistics() const;
+
+	/** @brief Cancels the execution of this batch
+    *
+    * Running compiler processes are killed and executeBatch returns
+    * as soon as possible. Can be called from any thread.
+    */
+	void cancel();
 };
 
 #endif
@@ -3,9 +3,57 @@
 Certificate::Certificate(const string& name, const string& content)
 	: name(name)
 	, content(content)
+	, deadline(chrono::steady_clock::time_point::max())
+	, trace(nullptr)
 {
 }
 
+Certificate::Certificate(const string& name, const string& content, const string& format)
+	: name(name)
+	, content(content)
+	, format(format)
+	, deadline(chrono::steady_clock::time_point::max())
+	, trace(nullptr)
+{
+}
+
+Certificate::JobDirectoryGuard::JobDirectoryGuard(const filesystem::path& jobDirectory, Trace* trace, const string& name)
+	: jobDirectory(jobDirectory)
+	, trace(trace)
+	, name(name)
+{
+}
+
+Certificate::JobDirectoryGuard::~JobDirectoryGuard()
+{
+	if (jobDirectory.empty()) {
+		return;
+	}
+	Trace::Span cleanSpan(trace, Trace::CLEAN_WORKING_DIRECTORY, name);
+	error_code ignoreErrors;
+	filesystem::remove_all(jobDirectory, ignoreErrors);
+}
+
+void Certificate::setDeadline(chrono::steady_clock::time_point deadline)
+{
+	this->deadline = deadline;
+}
+
+void Certificate::setTrace(Trace* trace)
+{
+	this->trace = trace;
+}
+
+void Certificate::setTemplateName(const string& templateName)
+{
+	this->templateName = templateName;
+}
+
+const string& Certificate::getTemplateName() const
+{
+	return templateName;
+}
+
 const string Certificate::getName() const
 {
 	return name;
@@ -16,6 +64,11 @@ const string Certificate::getContent() const
 	return content;
 }
 
+const string Certificate::getFormat() const
+{
+	return format;
+}
+
 void Certificate::writeToWorkingDirectory(const filesystem::path& workingDirectory) const{
 	ofstream output;
 	filesystem::path completePath(workingDirectory);
@@ -32,36 +85,118 @@ void Certificate::writeToWorkingDirectory(const filesystem::path& workingDirecto
 }
 
 filesystem::path Certificate::moveResultToOutputDirectory(const filesystem::path& workingDirectory, const filesystem::path& outputDirectory) const{
-	//Set names for moving
-	filesystem::path finalPath(outputDirectory);
-	finalPath.append(name);
-	finalPath.replace_extension(".pdf");
 	filesystem::path temporaryPath(workingDirectory);
 	temporaryPath.append(name);
 	temporaryPath.replace_extension(".pdf");
+	return moveFile(temporaryPath, outputDirectory);
+}
+
+filesystem::path Certificate::moveFile(const filesystem::path& file, const filesystem::path& directory){
+	//Set names for moving
+	filesystem::path finalPath(directory);
+	finalPath.append(file.filename().string());
+	filesystem::path temporaryPath(file);
 	//Try moving; will fail, if files are on different filesystems
 	int moveSuccessful = rename(temporaryPath.c_str(), finalPath.c_str());
 	//If moving failed, copy files instead
 	if (moveSuccessful != 0) {
-		ofstream finalPdf(finalPath, ios::out | ios::binary);
-		if (!finalPdf) {
-			stringstream message;
-			message << "Error while opening final pdf file " << finalPath;
-			throw FileAccessError(message.str());
-		}
-		ifstream temporaryPdf(temporaryPath, ios::in | ios::binary);
-		if (!temporaryPdf) {
-			stringstream message;
-			message << "Error while opening temporary pdf file " << temporaryPath;
-			throw FileAccessError(message.str());
-		}
-		finalPdf << temporaryPdf.rdbuf();
-		finalPdf.close();
-		temporaryPdf.close();
+		//The old file may be linked to a cached pdf, so it must not be overwritten
+		error_code ignoreErrors;
+		filesystem::remove(finalPath, ignoreErrors);
+		copyFile(temporaryPath, finalPath);
 	}
 	return finalPath;
 }
 
+void Certificate::copyFile(const filesystem::path& from, const filesystem::path& to){
+	int input = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+	if (input < 0) {
+		stringstream message;
+		message << "Error while opening file " << from;
+		throw FileAccessError(message.str());
+	}
+	int output = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (output < 0) {
+		close(input);
+		stringstream message;
+		message << "Error while creating file " << to;
+		throw FileAccessError(message.str());
+	}
+
+	//Share the data with a reflink, if the filesystem supports it
+	if (ioctl(output, FICLONE, input) == 0) {
+		close(input);
+		close(output);
+		return;
+	}
+
+	//Copy inside the kernel, copy_file_range is not supported between some filesystems
+	struct stat inputInfo;
+	bool copied = fstat(input, &inputInfo) == 0;
+	size_t remaining = copied ? inputInfo.st_size : 0;
+	bool useCopyFileRange = true;
+	while (copied && remaining > 0) {
+		ssize_t copiedBytes = -1;
+		if (useCopyFileRange) {
+			copiedBytes = copy_file_range(input, nullptr, output, nullptr, remaining, 0);
+			if (copiedBytes < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+				useCopyFileRange = false;
+				continue;
+			}
+		} else {
+			copiedBytes = sendfile(output, input, nullptr, remaining);
+		}
+		if (copiedBytes < 0 && errno == EINTR) {
+			continue;
+		}
+		//Stop at an unexpected end of the file or on errors
+		if (copiedBytes <= 0) {
+			copied = copiedBytes == 0;
+			break;
+		}
+		remaining -= copiedBytes;
+	}
+	close(input);
+	if (close(output) != 0 || !copied) {
+		stringstream message;
+		message << "Error while copying " << from << " to " << to;
+		throw FileAccessError(message.str());
+	}
+}
+
+filesystem::path Certificate::createJobDirectory(const filesystem::path& workingDirectory, const vector<string>& generatedNames) const{
+	static atomic<unsigned long> jobCounter(0);
+	filesystem::path jobDirectory(workingDirectory);
+	jobDirectory.append(name + ".job" + to_string(jobCounter++));
+	try {
+		filesystem::create_directory(jobDirectory);
+		for (const filesystem::directory_entry& file : filesystem::directory_iterator(workingDirectory)) {
+			string stem = file.path().stem().string();
+			if (!file.is_regular_file() || find(generatedNames.begin(), generatedNames.end(), stem) != generatedNames.end()) {
+				continue;
+			}
+			filesystem::path linkedFile(jobDirectory);
+			linkedFile.append(file.path().filename().string());
+			error_code error;
+			filesystem::create_hard_link(file.path(), linkedFile, error);
+			if (error) {
+				copyFile(file.path(), linkedFile);
+			}
+		}
+	} catch (const filesystem::filesystem_error& error) {
+		error_code ignoreErrors;
+		filesystem::remove_all(jobDirectory, ignoreErrors);
+		stringstream message;
+		message << "Error while creating job directory " << jobDirectory << ": " << error.what();
+		throw FileAccessError(message.str());
+	} catch (const FileAccessError& error) {
+		error_code ignoreErrors;
+		filesystem::remove_all(jobDirectory, ignoreErrors);
+		throw;
+	}
+	return jobDirectory;
+}
+
 void Certificate::cleanWorkingDirectory(const filesystem::path& workingDirectory) const{
 	//Generate names of temporary files
 	filesystem::path baseName(workingDirectory);
@@ -69,151 +204,452 @@ void Certificate::cleanWorkingDirectory(const filesystem::path& workingDirectory
 	filesystem::path pdfFile = baseName;
 	filesystem::path auxFile = baseName;
 	filesystem::path texFile = baseName;
+	filesystem::path logFile = baseName;
 	pdfFile.replace_extension(".pdf");
 	auxFile.replace_extension(".aux");
 	texFile.replace_extension(".tex");
+	logFile.replace_extension(".log");
 	//Remove temporary files
 	error_code ignoreErrors;
 	filesystem::remove(pdfFile, ignoreErrors);
 	filesystem::remove(auxFile, ignoreErrors);
 	filesystem::remove(texFile, ignoreErrors);
+	filesystem::remove(logFile, ignoreErrors);
 }
 
-vector<string> Certificate::generateLatexArguments(const filesystem::path& workingDirectory) const{
+vector<string> Certificate::generateDockerArguments(const filesystem::path& workingDirectory, const filesystem::path& cgroup) const{
 	vector<string> arguments;
-	//If we are using docker we execute latex in a container
-	if (CONFIG.docker) {
-		arguments.push_back("docker");
-		arguments.push_back("run");
-		arguments.push_back("--rm");
-		arguments.push_back("-v");
-		string mount = filesystem::canonical(filesystem::path(workingDirectory)).string();
-		mount.append(":/src/");
-		arguments.push_back(mount);
-		arguments.push_back("-w=/src/");
-		arguments.push_back("--network=none");
-		arguments.push_back("--security-opt=no-new-privileges");
-		arguments.push_back("--ipc=none");
-		string memory = "--memory=";
-		memory.append(to_string(CONFIG.maxMemoryPerWorker));
-		arguments.push_back(memory);
-		string user = "--user=";
-		user.append(to_string(getuid()));
-		arguments.push_back(user);
-		arguments.push_back("--cap-drop=ALL");
-		arguments.push_back("madmanfred/alpine-xetex");
+	arguments.push_back("docker");
+	arguments.push_back("run");
+	arguments.push_back("--rm");
+	arguments.push_back("-v");
+	string mount = filesystem::canonical(filesystem::path(workingDirectory)).string();
+	mount.append(":/src/");
+	arguments.push_back(mount);
+	arguments.push_back("-w=/src/");
+	arguments.push_back("--network=none");
+	arguments.push_back("--security-opt=no-new-privileges");
+	arguments.push_back("--ipc=none");
+	string memory = "--memory=";
+	memory.append(to_string(CONFIG.maxMemoryPerWorker));
+	arguments.push_back(memory);
+	string user = "--user=";
+	user.append(to_string(getuid()));
+	arguments.push_back(user);
+	arguments.push_back("--cap-drop=ALL");
+	if (!cgroup.empty()) {
+		arguments.push_back(CgroupManager::generateDockerArgument(cgroup));
 	}
+	arguments.push_back(DOCKER_IMAGE);
+	return arguments;
+}
+
+vector<string> Certificate::generateCompilerArguments(bool dumpFormat) const{
+	vector<string> arguments;
 	arguments.push_back("xelatex");
 	arguments.push_back("-halt-on-error");
 	arguments.push_back("-interaction=batchmode");
 	arguments.push_back("-no-shell-escape");
+	if (dumpFormat) {
+		//Start from the default format and dump a new one named after the certificate
+		arguments.push_back("-ini");
+		arguments.push_back("-jobname=" + name);
+		arguments.push_back("&xelatex");
+	} else if (!format.empty()) {
+		arguments.push_back("-fmt=" + format);
+	}
 	string inputFileArgument(name);
 	inputFileArgument.append(".tex");
 	arguments.push_back(inputFileArgument);
 	return arguments;
 }
 
-void Certificate::executeProgram(vector<string> arguments, const filesystem::path& workingDirectory) const{
-	char* charguments[50];
-	for (unsigned int i = 0; i < arguments.size(); i++) {
-		charguments[i] = const_cast<char*>(arguments[i].c_str());
+vector<string> Certificate::generateLatexArguments(const filesystem::path& workingDirectory, bool dumpFormat) const{
+	vector<string> arguments;
+	//If we are using docker we execute latex in a container
+	if (CONFIG.docker) {
+		arguments = generateDockerArguments(workingDirectory);
 	}
-	charguments[arguments.size()] = nullptr;
-	
-	//Set cpu time limit
-	rlimit cpulimit;
-	cpulimit.rlim_cur = CONFIG.maxCpuTimePerWorker;
-	cpulimit.rlim_max = CONFIG.maxCpuTimePerWorker + 1;
-	setrlimit(RLIMIT_CPU, &cpulimit);
-
-	//Set memory limit
-	rlimit memlimit;
-	memlimit.rlim_cur = CONFIG.maxMemoryPerWorker;
-	memlimit.rlim_max = CONFIG.maxMemoryPerWorker;
-	setrlimit(RLIMIT_AS, &memlimit);
-
-	//Increase niceness
-	nice(5);
-
-	//Redirect stdout to /dev/null
-	int fd = open("/dev/null", O_WRONLY | O_CREAT, 0666); // open the file /dev/null
-	dup2(fd, 1);
-
-	//Change into workingDirectory
-	chdir(workingDirectory.c_str());
-	
-	execvp(charguments[0], charguments);
+	vector<string> compilerArguments = generateCompilerArguments(dumpFormat);
+	arguments.insert(arguments.end(), compilerArguments.begin(), compilerArguments.end());
+	return arguments;
+}
 
-	//Error, exec returned
-	//close(fd);
-	stringstream message;
-	message << "Error while starting " << charguments[0] << ", probably texlive is not installed or not in path";
-	throw LatexMissingError(message.str());
+string Certificate::generateCacheKey(const string& resourcesHash) const{
+	//The docker arguments only specify how latex is run, so they are not part of the key
+	Sha256 key;
+	key.update(content);
+	key.update("\0", 1);
+	key.update(resourcesHash);
+	for (const string& argument : generateCompilerArguments()) {
+		key.update("\0", 1);
+		key.update(argument);
+	}
+	//Pdfs compiled with fewer passes may have wrong references
+	key.update("\0", 1);
+	key.update("passes=" + to_string(CONFIG.maxLatexPasses));
+	return key.hexDigest();
+}
+
+int Certificate::waitForProcess(const pid_t& childPid, const atomic_bool& killswitch, rusage* usage) const{
+	//Wait until process has finished, the reaper takes care of the timeout and the killswitch
+	chrono::milliseconds timeout = chrono::seconds(CONFIG.workerTimeout);
+	if (deadline != chrono::steady_clock::time_point::max()) {
+		chrono::milliseconds remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+		timeout = clamp(remaining, chrono::milliseconds(0), timeout);
+	}
+	return ProcessReaper::get().waitForExit(childPid, killswitch, timeout, usage);
+}
+
+string Certificate::readLogTail(const filesystem::path& workingDirectory) const
+{
+	filesystem::path logFile(workingDirectory);
+	logFile.append(name);
+	logFile.replace_extension(".log");
+	ifstream input(logFile, ios::binary | ios::ate);
+	if (!input) {
+		return "";
+	}
+	//Only the end of the log contains the error, it can be megabytes long
+	const streamoff maxBytes = 4096;
+	streamoff size = input.tellg();
+	streamoff offset = max(size - maxBytes, (streamoff)0);
+	input.seekg(offset);
+	string tail(size - offset, '\0');
+	input.read(tail.data(), tail.size());
+	tail.resize(input.gcount());
+
+	size_t start = tail.size();
+	for (int lines = 0; lines <= 20 && start != string::npos && start > 0; lines++) {
+		start = tail.rfind('\n', start - 1);
+	}
+	if (start != string::npos && start < tail.size()) {
+		tail.erase(0, start + 1);
+	}
+	return tail;
 }
 
-int Certificate::waitForProcess(const pid_t& childPid, const atomic_bool& killswitch) const{
-	//Wait until process has finished, or timeout occurred
+bool Certificate::runLatex(const vector<string>& arguments, const filesystem::path& workingDirectory, const atomic_bool& killswitch, CompilerRun& run, const filesystem::path& containerGroup) const
+{
+	static Metrics::Gauge& activeCompilers = Metrics::get().gauge("certgen_active_compilers", "Compiler processes, that are currently running");
+	static Metrics::Histogram& compilerSeconds = Metrics::get().histogram("certgen_compiler_seconds", "Run time of compiler processes");
+	static Metrics::Histogram& compilerCpuSeconds = Metrics::get().histogram("certgen_compiler_cpu_seconds", "Cpu time used by compiler processes");
+	static Metrics::Histogram& compilerPeakMemory = Metrics::get().histogram("certgen_compiler_peak_memory_bytes", "Peak memory of compiler processes", "", Metrics::memoryBuckets);
+	static Metrics::Counter& compilerErrors = Metrics::get().counter("certgen_compiler_errors_total", "Compiler processes, that failed to start or exited with an error");
+	Metrics::ScopedTimer timer(compilerSeconds, &compilerErrors);
+
+	//Start the latex process with limited resources
+	ProcessLauncher launcher(arguments, workingDirectory);
+	launcher.setCpuTimeLimit(CONFIG.maxCpuTimePerWorker);
+	launcher.setMemoryLimit(CONFIG.maxMemoryPerWorker);
+	launcher.setNiceness(5);
+	//With docker only the docker client runs here, the container is placed into containerGroup
+	CgroupManager* cgroups = CgroupManager::get();
+	filesystem::path cgroup = containerGroup;
+	if (!CONFIG.docker && cgroups != nullptr) {
+		cgroup = cgroups->createJobGroup(workingDirectory);
+		if (!cgroup.empty()) {
+			launcher.setCgroup(cgroup);
+		}
+	}
 	int status;
-	int result = 0;
-	chrono::time_point end = chrono::system_clock::now() + chrono::seconds(CONFIG.workerTimeout);
-	chrono::time_point now = chrono::system_clock::now();
-	result = waitpid(childPid, &status, WNOHANG);
-	while (result == 0) {
-		this_thread::sleep_for(10ms);
-		now = chrono::system_clock::now();
-		if (end < now) {
-			if (end < (now + 2s)) {
-				kill(childPid, SIGKILL);
-			} else {
-				kill(childPid, SIGTERM);
+	rusage usage = {};
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool launched = false;
+	try {
+		pid_t childPid;
+		{
+			Trace::Span launchSpan(trace, Trace::LAUNCH, name);
+			childPid = launcher.launch();
+		}
+		launched = true;
+		activeCompilers.add(1);
+
+		//Wait until process has finished, or timeout occurred
+		Trace::Span compileSpan(trace, Trace::COMPILE, name);
+		status = waitForProcess(childPid, killswitch, &usage);
+	} catch (...) {
+		if (launched) {
+			activeCompilers.add(-1);
+		}
+		if (!cgroup.empty()) {
+			cgroups->removeJobGroup(cgroup);
+		}
+		throw;
+	}
+	activeCompilers.add(-1);
+
+	//The usage of this pass
+	CompilerRun pass;
+	pass.certificate = name;
+	pass.exitCode = WIFSIGNALED(status) ? -WTERMSIG(status) : WEXITSTATUS(status);
+	pass.passes = 1;
+	pass.wallTime = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+	//The usage of the docker client is not the usage of the compiler
+	pass.measured = !CONFIG.docker || !cgroup.empty();
+	if (!CONFIG.docker) {
+		pass.cpuTime = chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+		//ru_maxrss is in kilobytes
+		pass.peakMemory = (long long)usage.ru_maxrss * 1024;
+	}
+	if (!cgroup.empty()) {
+		CgroupManager::Usage cgroupUsage = cgroups->removeJobGroup(cgroup);
+		pass.peakMemory = max(pass.peakMemory, (long long)cgroupUsage.peakMemory);
+		pass.cpuTime = max(pass.cpuTime, cgroupUsage.cpuTime);
+	}
+	if (pass.measured) {
+		spdlog::debug("{} in {} exited with code {} after {}ms, it used {}ms of cpu time and {} bytes of memory", arguments[0], workingDirectory.string(), pass.exitCode, chrono::duration_cast<chrono::milliseconds>(pass.wallTime).count(), chrono::duration_cast<chrono::milliseconds>(pass.cpuTime).count(), pass.peakMemory);
+		compilerCpuSeconds.observe(chrono::duration<double>(pass.cpuTime).count());
+		compilerPeakMemory.observe(pass.peakMemory);
+	} else {
+		spdlog::debug("{} in {} exited with code {} after {}ms", arguments[0], workingDirectory.string(), pass.exitCode, chrono::duration_cast<chrono::milliseconds>(pass.wallTime).count());
+	}
+
+	run.certificate = name;
+	run.exitCode = pass.exitCode;
+	run.passes++;
+	run.wallTime += pass.wallTime;
+	run.cpuTime += pass.cpuTime;
+	run.peakMemory = max(run.peakMemory, pass.peakMemory);
+	run.measured = run.measured && pass.measured;
+
+	//Return if killswitch got set
+	if (killswitch) return false;
+
+	bool failed = status != EXIT_SUCCESS;
+	if (trace != nullptr) {
+		trace->recordCompilerRun(templateName.empty() ? name : templateName, pass, failed);
+	}
+
+	//Check if latex was successful
+	if (failed) {
+		run.logTail = readLogTail(workingDirectory);
+		stringstream message;
+		message << "Error while executing " << arguments[0] << " for " << name << ", it ";
+		if (run.exitCode < 0) {
+			message << "was killed by signal " << -run.exitCode;
+		} else {
+			message << "exited with code " << run.exitCode;
+		}
+		message << " in pass " << run.passes << " after " << chrono::duration_cast<chrono::milliseconds>(run.wallTime).count() << "ms";
+		if (run.measured) {
+			message << ", using " << chrono::duration_cast<chrono::milliseconds>(run.cpuTime).count() << "ms of cpu time and " << run.peakMemory << " bytes of memory";
+		}
+		throw LatexExecutionError(message.str(), run);
+	}
+	return true;
+}
+
+bool Certificate::runInSandbox(const vector<string>& command, const filesystem::path& workingDirectory, const atomic_bool& killswitch, CompilerRun& run) const
+{
+	DockerPool* pool = CONFIG.docker ? DockerPool::get() : nullptr;
+	DockerPool::Container container;
+	if (pool != nullptr && pool->acquire(workingDirectory, container)) {
+		bool finished;
+		try {
+			finished = runLatex(pool->generateExecArguments(container, workingDirectory, command), workingDirectory, killswitch, run);
+		} catch (...) {
+			pool->release(container, true);
+			throw;
+		}
+		pool->release(container, !finished);
+		return finished;
+	}
+
+	vector<string> arguments;
+	filesystem::path cgroup;
+	//If we are using docker we execute the command in a new container
+	if (CONFIG.docker) {
+		CgroupManager* cgroups = CgroupManager::get();
+		cgroup = cgroups != nullptr ? cgroups->createJobGroup(workingDirectory, true) : "";
+		try {
+			arguments = generateDockerArguments(workingDirectory, cgroup);
+		} catch (...) {
+			if (!cgroup.empty()) {
+				cgroups->removeJobGroup(cgroup);
 			}
+			throw;
 		}
-		if (killswitch) {
-			kill(childPid, SIGKILL);
+	}
+	arguments.insert(arguments.end(), command.begin(), command.end());
+	return runLatex(arguments, workingDirectory, killswitch, run, cgroup);
+}
+
+map<string, string> Certificate::readAuxiliaryFiles(const filesystem::path& workingDirectory) const
+{
+	static const char* extensions[] = { ".aux", ".toc", ".lof", ".lot", ".out" };
+	map<string, string> auxiliaryFiles;
+	for (const char* extension : extensions) {
+		filesystem::path file(workingDirectory);
+		file.append(name);
+		file.replace_extension(extension);
+		ifstream input(file, ios::binary);
+		if (!input) {
+			continue;
 		}
+		stringstream content;
+		content << input.rdbuf();
+		auxiliaryFiles[extension] = content.str();
+	}
+	return auxiliaryFiles;
+}
 
-		result = waitpid(childPid, &status, WNOHANG);
+bool Certificate::needsRerun(const filesystem::path& workingDirectory, map<string, string>& auxiliaryFiles) const
+{
+	map<string, string> writtenFiles = readAuxiliaryFiles(workingDirectory);
+	bool changed = false;
+	for (const auto& [extension, content] : writtenFiles) {
+		auto previous = auxiliaryFiles.find(extension);
+		if (previous == auxiliaryFiles.end()) {
+			//A missing file was read as empty
+			changed = changed || (extension != ".aux" && !content.empty());
+		} else {
+			changed = changed || previous->second != content;
+		}
+	}
+	auxiliaryFiles = move(writtenFiles);
+	if (changed) {
+		return true;
 	}
 
-	//Error while waiting for child
-	if (result < 0) {
-		throw LatexExecutionError("Error while waiting for latex");
+	filesystem::path logFile(workingDirectory);
+	logFile.append(name);
+	logFile.replace_extension(".log");
+	ifstream input(logFile, ios::binary);
+	if (!input) {
+		return false;
 	}
-	
-	return status;
+	stringstream log;
+	log << input.rdbuf();
+	return logRequestsRerun(log.str());
 }
 
-filesystem::path Certificate::generatePDF(const filesystem::path& workingDirectory, const filesystem::path& outputDirectory, const atomic_bool& killswitch) const
+bool Certificate::logRequestsRerun(const string& log)
 {
-	writeToWorkingDirectory(workingDirectory);
-	vector<string> arguments = generateLatexArguments(workingDirectory);
-	
-	if (killswitch) return "";
+	//Join the lines, that latex wrapped after 79 characters
+	string joined;
+	joined.reserve(log.size());
+	size_t lineStart = 0;
+	while (lineStart < log.size()) {
+		size_t lineEnd = log.find('\n', lineStart);
+		if (lineEnd == string::npos) {
+			lineEnd = log.size();
+		}
+		joined.append(log, lineStart, lineEnd - lineStart);
+		if (lineEnd - lineStart != 79) {
+			joined += '\n';
+		}
+		lineStart = lineEnd + 1;
+	}
 
-	//Fork for latex process
-	int childPid = vfork();
-	if (childPid == -1) {
-		throw ForkFailedError("Error while forking, vfork() returned childPID -1");
-	} else if (childPid == 0) {
-		executeProgram(arguments, workingDirectory);
-	} else {
-		//Wait until process has finished, or timeout occurred
-		int status = waitForProcess(childPid, killswitch);
-		
-		//Return if killswitch got set
-		if (killswitch) return "";
+	//The messages of the kernel, hyperref, lastpage, longtable, rerunfilecheck and biblatex
+	static const char* requests[] = { "Rerun to get", "Rerun LaTeX", "rerun LaTeX", "Please rerun" };
+	for (const char* request : requests) {
+		if (joined.find(request) != string::npos) {
+			return true;
+		}
+	}
+	return false;
+}
 
-		//Check if latex was successful
-		if (status != EXIT_SUCCESS) {
-			stringstream message;
-			message << "Error while executing " << arguments[0] << ", it exited with code " << status;
-			throw LatexExecutionError(message.str());
+bool Certificate::compile(const vector<string>& arguments, const filesystem::path& workingDirectory, const atomic_bool& killswitch, CompilerRun& run) const
+{
+	static Metrics::Counter& reruns = Metrics::get().counter("certgen_latex_reruns_total", "Additional latex passes, because latex requested a rerun");
+	map<string, string> auxiliaryFiles = readAuxiliaryFiles(workingDirectory);
+	while (true) {
+		if (!runInSandbox(arguments, workingDirectory, killswitch, run)) return false;
+		if (!needsRerun(workingDirectory, auxiliaryFiles)) {
+			return true;
+		}
+		if (run.passes >= CONFIG.maxLatexPasses) {
+			spdlog::debug("Latex still requests a rerun of {} after {} passes", name, run.passes);
+			return true;
+		}
+		spdlog::debug("Latex requested a rerun of {} after pass {}", name, run.passes);
+		reruns.increment();
+	}
+}
+
+filesystem::path Certificate::generatePDF(const filesystem::path& workingDirectory, const filesystem::path& outputDirectory, const atomic_bool& killswitch, const string& resourcesHash) const
+{
+	//Use the cached pdf, if this certificate was compiled before
+	PdfCache* cache = PdfCache::get();
+	string cacheKey;
+	if (cache != nullptr) {
+		Trace::Span span(trace, Trace::CACHE_LOOKUP, name);
+		cacheKey = generateCacheKey(resourcesHash);
+		filesystem::path cachedPdf(outputDirectory);
+		cachedPdf.append(name);
+		cachedPdf.replace_extension(".pdf");
+		if (cache->retrieve(cacheKey, cachedPdf)) {
+			return cachedPdf;
 		}
 	}
 
+	static Metrics::Histogram& generateSeconds = Metrics::get().histogram("certgen_certificate_seconds", "Time to generate the pdf of a certificate, that was not cached");
+	static Metrics::Counter& generateErrors = Metrics::get().counter("certgen_certificate_errors_total", "Certificates, whose pdf could not be generated");
+	Metrics::ScopedTimer timer(generateSeconds, &generateErrors);
+	Trace::Span span(trace, Trace::GENERATE_PDF, name);
+	filesystem::path jobDirectory;
+	JobDirectoryGuard jobDirectoryGuard(jobDirectory, trace, name);
+	{
+		Trace::Span createSpan(trace, Trace::CREATE_JOB_DIRECTORY, name);
+		jobDirectory = createJobDirectory(workingDirectory, { name });
+	}
+	{
+		Trace::Span writeSpan(trace, Trace::WRITE_TO_WORKING_DIRECTORY, name);
+		writeToWorkingDirectory(jobDirectory);
+	}
+	vector<string> arguments = generateCompilerArguments();
+	
+	if (killswitch) return "";
+
+	CompilerRun run;
+	if (!compile(arguments, jobDirectory, killswitch, run)) return "";
+
 	//Move pdf file to output directory
-	filesystem::path finalPdf = moveResultToOutputDirectory(workingDirectory, outputDirectory);
-	//Clean temporary files from working directory
-	cleanWorkingDirectory(workingDirectory);
+	filesystem::path finalPdf;
+	{
+		Trace::Span moveSpan(trace, Trace::MOVE_RESULT_TO_OUTPUT_DIRECTORY, name);
+		finalPdf = moveResultToOutputDirectory(jobDirectory, outputDirectory);
+	}
+	if (cache != nullptr) {
+		Trace::Span storeSpan(trace, Trace::CACHE_STORE, name);
+		cache->store(cacheKey, finalPdf);
+	}
 	return finalPdf;
 }
+
+filesystem::path Certificate::generateFormat(const filesystem::path& workingDirectory, const atomic_bool& killswitch) const
+{
+	filesystem::path formatFile(workingDirectory);
+	formatFile.append(name);
+	formatFile.replace_extension(".fmt");
+
+	//Formats are named after their content, so an existing one can be reused
+	if (filesystem::exists(formatFile)) return formatFile;
+
+	writeToWorkingDirectory(workingDirectory);
+	vector<string> arguments = generateCompilerArguments(true);
+
+	if (killswitch) return "";
+
+	//The temporary files would be linked into every job directory
+	CompilerRun run;
+	bool finished;
+	try {
+		finished = runInSandbox(arguments, workingDirectory, killswitch, run);
+	} catch (...) {
+		cleanWorkingDirectory(workingDirectory);
+		throw;
+	}
+	cleanWorkingDirectory(workingDirectory);
+	if (!finished) return "";
+
+	if (!filesystem::exists(formatFile)) {
+		stringstream message;
+		message << "Latex did not dump the format file " << formatFile;
+		throw LatexExecutionError(message.str());
+	}
+	return formatFile;
+}
@@ -1,18 +1,32 @@
 #ifndef CERTIFICATE_HPP
 #define CERTIFICATE_HPP
 
+#include "CgroupManager.hpp"
 #include "Configuration.hpp"
+#include "DockerPool.hpp"
 #include "Exceptions.hpp"
+#include "Metrics.hpp"
+#include "PdfCache.hpp"
+#include "ProcessLauncher.hpp"
+#include "ProcessReaper.hpp"
+#include "Sha256.hpp"
+#include "Trace.hpp"
+#include <algorithm>
 #include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <cstring>
 #include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <linux/fs.h>
+#include <map>
 #include <sstream>
 #include <string>
+#include <sys/ioctl.h>
 #include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <thread>
 #include <unistd.h>
@@ -31,9 +45,40 @@ using namespace std;
  */
 class Certificate {
 
-private:
+protected:
 	string name;
 	string content;
+	string format;
+	chrono::steady_clock::time_point deadline;
+	Trace* trace;
+	string templateName;
+
+	/**
+	 * @brief Removes a job directory, when the scope is left
+	 *
+	 * The job directory contains links or copies of every file of the working
+	 * directory, so it has to be removed on every path out of a compile job,
+	 * including errors and cancelation.
+	 */
+	class JobDirectoryGuard {
+	private:
+		const filesystem::path& jobDirectory;
+		Trace* trace;
+		const string& name;
+
+	public:
+		/** @brief Constructor that guards a job directory
+        * @param [in] jobDirectory the job directory, it is not removed while it is empty
+        * @param [in] trace the Trace getting the duration of the removal, or nullptr
+        * @param [in] name the name of the certificate, it has to outlive the guard
+        * @return A pointer to the created JobDirectoryGuard
+        */
+		JobDirectoryGuard(const filesystem::path& jobDirectory, Trace* trace, const string& name);
+
+		/** @brief Destructor that removes the job directory
+        */
+		~JobDirectoryGuard();
+	};
 	
 	/** @brief Writes the latex file to the given directory
     * @param [in] workingDirectory a string specifying the directory where the file should be placed
@@ -53,45 +98,163 @@ private:
     * Moves the generated pdf file from workingDirectory to outputDirectory
     */
 	filesystem::path moveResultToOutputDirectory(const filesystem::path& workingDirectory, const filesystem::path& outputDirectory) const;
-	
+
+	/** @brief Moves a file into a directory
+    * @param [in] file the path of the file to be moved
+    * @param [in] directory a string specifying the directory where the file should be put
+    * @return A string containing the new location of the file.
+    * 
+    * Renames the file, if that is not possible, because file and directory
+    * are on different filesystems, the file gets copied instead.
+    */
+	static filesystem::path moveFile(const filesystem::path& file, const filesystem::path& directory);
+
+	/** @brief Creates a private working directory for one compile job
+    * @param [in] workingDirectory a string specifying the working directory of the batch
+    * @param [in] generatedNames the names of the files generated by the job, without extension
+    * @return The path of the created directory
+    * @throw FileAccessError if the directory can not be created
+    * 
+    * Creates a uniquely named subdirectory of workingDirectory, so parallel jobs
+    * never share temporary files. The files of workingDirectory, like resources
+    * and formats, are hardlinked into it, or copied if linking is not possible.
+    * Files named like generated files are not linked, so they can not be
+    * overwritten through the link.
+    */
+	filesystem::path createJobDirectory(const filesystem::path& workingDirectory, const vector<string>& generatedNames) const;
+
 	/** @brief Removes temporary files from the working directory
     * @param [in] workingDirectory a string specifying the directory where the temporary files are.
     * 
-    * Removes the pdf, aux and tex files from the working directory
+    * Removes the pdf, aux, tex and log files from the working directory
     */
 	void cleanWorkingDirectory(const filesystem::path& workingDirectory) const;
 	
-	/** @brief Generates the arguments for execvp to execute latex
+	/** @brief Generates the arguments for execvp to start a docker container
+	* @param [in] workingDirectory a string specifying the directory that gets mounted into the container
+	* @param [in] cgroup the cgroup, that the container is started below, empty for the default cgroup of docker
     * @return A vector of strings containing arguments.
     * 
-    * Generates the arguments for execvp to execute latex
+    * Generates the arguments for execvp to start a sandboxed docker container,
+    * the command to be executed in the container has to be appended.
     */
-	vector<string> generateLatexArguments(const filesystem::path& workingDirectory) const;
-	
-	/** @brief Executes a program
-	* @param [in] arguments a vector of strings containing arguments.
+	vector<string> generateDockerArguments(const filesystem::path& workingDirectory, const filesystem::path& cgroup = "") const;
+
+	/** @brief Generates the arguments of the latex compiler
+	* @param [in] dumpFormat a bool specifying if latex should dump a format file instead of producing a pdf
+    * @return A vector of strings containing arguments.
     * 
-    * Executes the program specified in arguments with execvp.
-    * Before executing the program, the working directory is set to
-    * workingDirectory the resources of the process are limited with
-    * setrlimit, stdout is redirected to /dev/null
-    * and niceness is increased
+    * Generates the latex command, without the docker command to run it in a container.
     */
-	void executeProgram(vector<string> arguments, const filesystem::path& workingDirectory) const;
+	vector<string> generateCompilerArguments(bool dumpFormat = false) const;
+
+	/** @brief Generates the arguments for execvp to execute latex
+	* @param [in] workingDirectory a string specifying the directory where latex is executed
+	* @param [in] dumpFormat a bool specifying if latex should dump a format file instead of producing a pdf
+    * @return A vector of strings containing arguments.
+    * 
+    * Generates the arguments for execvp to execute latex.
+    * If the certificate has a format, latex is started with that format.
+    * If dumpFormat is set, latex is started in ini mode and the format
+    * file will be named after the certificate.
+    */
+	vector<string> generateLatexArguments(const filesystem::path& workingDirectory, bool dumpFormat = false) const;
 	
 	/** @brief Waits for the process to finish or kills it
 	* @param [in] childPid a pid_t of the process to be waited for
 	* @param [in] killswitch a atomic_bool triggering the sending of a kill signal to the child
+	* @param [out] usage the resource usage of the process, if it is not nullptr
     * @return A int containing the exit status of the process
     * 
-    * Waits until the process with childPid exits.
-    * If the timeout set in Configuration is exceeded, the process with
-    * childPid gets send a SIGTERM signal every 10ms. If it does not
-    * terminate withing 2 seconds it gets send SIGKILL instead.
-    * If killswitch gets set the process with childPid gets send SIGKILL
-    * every 10ms.
+    * Waits until the process with childPid exits, using the ProcessReaper.
+    * If the timeout set in Configuration or the deadline of the certificate
+    * is exceeded, the process with childPid gets send a SIGTERM signal. If it does not terminate
+    * within 2 seconds it gets send SIGKILL instead.
+    * If killswitch gets set the process with childPid gets send SIGKILL,
+    * as soon as ProcessReaper::notifyKillswitch is called.
+    */
+	int waitForProcess(const pid_t& childPid, const atomic_bool& killswitch, rusage* usage = nullptr) const;
+
+	/** @brief Reads the end of the latex log of this certificate
+	* @param [in] workingDirectory a string specifying the directory where latex was executed
+    * @return A string containing at most the last 20 lines of the log, empty if there is no log
+    */
+	string readLogTail(const filesystem::path& workingDirectory) const;
+
+	/** @brief Runs latex and waits for it
+	* @param [in] arguments a vector of strings containing arguments.
+	* @param [in] workingDirectory a string specifying the directory where latex is executed
+	* @param [in] killswitch a atomic_bool triggering cancelation of the execution, when set.
+	* @param [in,out] run the CompilerRun, that gets the resource usage of the process added
+	* @param [in] containerGroup the cgroup of the job, if arguments start a docker container below it
+    * @return false if the execution got canceled by the killswitch, true otherwise
+    * @throw LatexExecutionError if latex exited with an error, it contains the run and the end of the log
+    * @throw LatexMissingError if latex can not be executed
+    * 
+    * Starts the program specified in arguments with a ProcessLauncher and waits for it to finish.
+    * This is also used for other programs working on the results of latex.
+    * Every run is counted as a pass and recorded in the Trace, if one is set.
+    * Without docker the process is started in the cgroup of the job if there is one,
+    * the cpu time and peak memory include the processes it forked. With docker the
+    * process is only the docker client, so the usage is only measured, if the
+    * container runs below containerGroup. The cgroup of the job is removed afterwards.
+    */
+	bool runLatex(const vector<string>& arguments, const filesystem::path& workingDirectory, const atomic_bool& killswitch, CompilerRun& run, const filesystem::path& containerGroup = "") const;
+
+	/** @brief Runs a command in the sandbox and waits for it
+	* @param [in] command a vector of strings containing the command and its arguments
+	* @param [in] workingDirectory a string specifying the directory where the command is executed
+	* @param [in] killswitch a atomic_bool triggering cancelation of the execution, when set.
+	* @param [in,out] run the CompilerRun, that gets the resource usage of the command added
+    * @return false if the execution got canceled by the killswitch, true otherwise
+    * @throw LatexExecutionError if the command exited with an error
+    * 
+    * If docker is used, the command is executed in a container of the DockerPool.
+    * If the pool is disabled or has no container available, a new container is started,
+    * below the cgroup of the job if cgroups are enabled.
+    */
+	bool runInSandbox(const vector<string>& command, const filesystem::path& workingDirectory, const atomic_bool& killswitch, CompilerRun& run) const;
+
+	/** @brief Reads the files, that latex writes in one pass and reads in the next one
+	* @param [in] workingDirectory a string specifying the directory where latex is executed
+    * @return A map from the extension to the content of every existing auxiliary file
+    *
+    * These are the .aux file containing the labels and the files of the table of contents,
+    * the lists of figures and tables and the pdf bookmarks.
+    */
+	map<string, string> readAuxiliaryFiles(const filesystem::path& workingDirectory) const;
+
+	/** @brief Checks if latex has to be run again to get references, page numbers or the table of contents right
+	* @param [in] workingDirectory a string specifying the directory where latex was executed
+	* @param [in,out] auxiliaryFiles the auxiliary files before the last pass, they are replaced by the ones written by it
+    * @return true if the log requests a rerun or latex wrote different auxiliary files than it read
+    *
+    * The .aux file is only compared, if it existed before the pass. Latex always writes
+    * it and already requests a rerun in the log, if the labels changed.
+    */
+	bool needsRerun(const filesystem::path& workingDirectory, map<string, string>& auxiliaryFiles) const;
+
+	/** @brief Checks if a latex log contains a request to run latex again
+	* @param [in] log a string containing the log of latex
+    * @return true if latex or a package requested a rerun
+    *
+    * Latex wraps the lines of the log after 79 characters, so wrapped lines are joined first.
+    */
+	static bool logRequestsRerun(const string& log);
+
+	/** @brief Compiles the certificate and runs latex again, as long as it requests a rerun
+	* @param [in] arguments a vector of strings containing the command running latex
+	* @param [in] workingDirectory a string specifying the directory where latex is executed
+	* @param [in] killswitch a atomic_bool triggering cancelation of the execution, when set.
+	* @param [in,out] run the CompilerRun, that gets every pass added
+    * @return false if the execution got canceled by the killswitch, true otherwise
+    * @throw LatexExecutionError if latex exited with an error
+    *
+    * Most documents need one pass. Latex is run again only if needsRerun detects that
+    * references, page numbers or the table of contents are not right yet, at most
+    * maxLatexPasses times as set in Configuration.
     */
-	int waitForProcess(const pid_t& childPid, const atomic_bool& killswitch) const;
+	bool compile(const vector<string>& arguments, const filesystem::path& workingDirectory, const atomic_bool& killswitch, CompilerRun& run) const;
 
 public:
 	/** @brief Constructor that creates a Certificate
@@ -103,6 +266,45 @@ public:
     */
 	Certificate(const string& name, const string& content);
 
+	/** @brief Constructor that creates a Certificate compiled with a format
+    * @param [in] name is a string containing the name of the certificate without ending
+    * @param [in] content is a string containing the content of the certificate
+    * @param [in] format is a string containing the name of the format file latex is started with
+    * @return A pointer to the created Certificate
+    *
+    * This method creates a Certificate with the given filename and content.
+    * The format has to be generated with generateFormat before generating the pdf,
+    * the content must not repeat the part of the preamble, that is contained in the format.
+    */
+	Certificate(const string& name, const string& content, const string& format);
+
+	/** @brief Sets the time by which the compiler processes of this Certificate have to finish
+    * @param [in] deadline the time after which compiler processes get terminated
+    *
+    * Compiler processes are terminated at the deadline, even if their timeout
+    * set in Configuration is not exceeded yet.
+    */
+	void setDeadline(chrono::steady_clock::time_point deadline);
+
+	/** @brief Sets the Trace, that records the stages of generating the pdf
+    * @param [in] trace the Trace of the batch, or nullptr to not trace this Certificate
+    *
+    * The Trace has to outlive the generation of the pdf.
+    */
+	void setTrace(Trace* trace);
+
+	/** @brief Sets the name of the template, this Certificate was generated from
+    * @param [in] templateName the name of the template
+    *
+    * The resource usage of the compiler is aggregated per template in the Trace.
+    */
+	void setTemplateName(const string& templateName);
+
+	/** @brief Returns the name of the template, this Certificate was generated from
+    * @return A string containing the name of the template, empty if it is not known
+    */
+	const string& getTemplateName() const;
+
 	/** @brief Returns the name of the Certificate
     * @return A string that containing the name of the certificate
     */
@@ -113,25 +315,71 @@ public:
     */
 	const string getContent() const;
 
+	/** @brief Returns the name of the format of the Certificate
+    * @return A string that containing the name of the format, empty if the default format is used
+    */
+	const string getFormat() const;
+
+	/** @brief Generates the key of the pdf in the PdfCache
+	* @param [in] resourcesHash a string containing the hash of the resources used by the certificate
+    * @return A string containing the key
+    *
+    * The key is the hash of the content, the resources, the arguments of the compiler
+    * and the maximum number of latex passes.
+    */
+	string generateCacheKey(const string& resourcesHash) const;
+
+	/** @brief Copies a file without reading it into memory
+    * @param [in] from the path of the file to be copied
+    * @param [in] to the path of the copy, an existing file gets truncated
+    * @throw FileAccessError if the file can not be copied
+    * 
+    * If the filesystem supports it, the copy is a reflink sharing the data
+    * of the file. Otherwise the data is copied by the kernel with
+    * copy_file_range or sendfile.
+    */
+	static void copyFile(const filesystem::path& from, const filesystem::path& to);
+
 	/** @brief Generates a pdf from the certificate
     * @param [in] workingDirectory a string specifying the directory to be used for temporary files
     * @param [in] outputDirectory a string specifying the directory where the pdf should be put
     * @param [in] killswitch a atomic_bool triggering cancelation of the generation, when set.
+    * @param [in] resourcesHash a string containing the hash of the resources in the working directory
     * @return A string containing the location of the PDF file.
     * Generates a pdf of the certificate into the given outputDirectory
     * 
     * The workingDirectory is used to store temporary files needed 
-    * during the generation of the certificate. The temporary files
-    * can be removed after this method finished.
+    * during the generation of the certificate. Latex runs in a private
+    * subdirectory created with createJobDirectory, which is removed
+    * after the pdf was generated, the generation failed or was canceled.
     * 
     * This will produce a pdf file in outputDirectory. The filename will be
     * the certificate name with the extension .pdf. If the certificate
     * name already has an extension it will be replaced with .pdf.
     * 
+    * If the PdfCache is enabled and contains the pdf, latex is not executed.
+    * Otherwise the generated pdf is added to the cache.
+    * 
+    * If killswitch is set by another thread, it returns as soon as possible
+    * with an empty string.
+    */
+	filesystem::path generatePDF(const filesystem::path& workingDirectory, const filesystem::path& outputDirectory, const atomic_bool& killswitch, const string& resourcesHash = "") const;
+
+	/** @brief Generates a latex format file from the certificate
+    * @param [in] workingDirectory a string specifying the directory where the format file should be put
+    * @param [in] killswitch a atomic_bool triggering cancelation of the generation, when set.
+    * @return A string containing the location of the format file.
+    * @throw LatexExecutionError if latex failed to dump the format
+    * 
+    * Runs latex in ini mode on the content of this certificate, which has
+    * to be a preamble followed by \dump. The format file will be named after
+    * the certificate with the extension .fmt. If the format file already
+    * exists in workingDirectory it is not generated again.
+    * 
     * If killswitch is set by another thread, it returns as soon as possible
     * with an empty string.
     */
-	filesystem::path generatePDF(const filesystem::path& workingDirectory, const filesystem::path& outputDirectory, const atomic_bool& killswitch) const;
+	filesystem::path generateFormat(const filesystem::path& workingDirectory, const atomic_bool& killswitch) const;
 };
 
 #endif
@@ -0,0 +1,191 @@
+#include "CgroupManager.hpp"
+
+CgroupManager* CgroupManager::singleton = nullptr;
+
+CgroupManager::CgroupManager(const filesystem::path& root)
+	: root(root)
+	, createdGroups(0)
+{
+	if (!isCgroup2(root)) {
+		stringstream message;
+		message << root.string() << " is not a cgroup v2 directory";
+		throw ConfigurationError(message.str());
+	}
+	//Controllers, that are not available to the root cgroup, are not used
+	for (const char* controller : { "memory", "cpu", "pids" }) {
+		if (!writeValue(root / "cgroup.subtree_control", string("+") + controller)) {
+			spdlog::warn("The {} cgroup controller is not available in {}", controller, root.string());
+		}
+	}
+}
+
+CgroupManager* CgroupManager::get()
+{
+	return singleton;
+}
+
+void CgroupManager::setup(const filesystem::path& root)
+{
+	if (singleton == nullptr) {
+		singleton = new CgroupManager(root);
+	} else {
+		throw ConfigurationError("Cgroup already specified");
+	}
+}
+
+bool CgroupManager::isCgroup2(const filesystem::path& directory)
+{
+	struct statfs filesystemInfo;
+	if (statfs(directory.c_str(), &filesystemInfo) != 0) {
+		return false;
+	}
+	return filesystemInfo.f_type == CGROUP2_SUPER_MAGIC;
+}
+
+bool CgroupManager::writeValue(const filesystem::path& file, const string& value)
+{
+	ofstream output(file);
+	if (!output) {
+		return false;
+	}
+	output << value;
+	output.flush();
+	return output.good();
+}
+
+filesystem::path CgroupManager::createGroup(const filesystem::path& parent, const string& prefix)
+{
+	filesystem::path group(parent);
+	group.append(prefix + "-" + to_string(createdGroups++));
+	error_code error;
+	filesystem::create_directory(group, error);
+	if (error) {
+		spdlog::warn("Failed to create cgroup {}: {}", group.string(), error.message());
+		return "";
+	}
+	return group;
+}
+
+void CgroupManager::removeGroup(const filesystem::path& group)
+{
+	//Processes, that the job left behind, are killed, so the group can be removed
+	int error = 0;
+	for (int attempt = 0; attempt < 100; attempt++) {
+		if (rmdir(group.c_str()) == 0 || errno == ENOENT) {
+			return;
+		}
+		error = errno;
+		if (error != EBUSY) {
+			break;
+		}
+		writeValue(group / "cgroup.kill", "1");
+		//Cgroups of containers, that docker did not remove yet
+		error_code ignoreErrors;
+		for (const filesystem::directory_entry& entry : filesystem::directory_iterator(group, ignoreErrors)) {
+			if (entry.is_directory(ignoreErrors)) {
+				removeGroup(entry.path());
+			}
+		}
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	spdlog::warn("Failed to remove cgroup {}: {}", group.string(), strerror(error));
+}
+
+filesystem::path CgroupManager::createBatchGroup(const filesystem::path& workingDirectory, unsigned int weight)
+{
+	filesystem::path group = createGroup(root, "batch");
+	if (group.empty()) {
+		return group;
+	}
+	writeValue(group / "cpu.weight", to_string(weight));
+	//The job groups get the controllers of the batch group
+	for (const char* controller : { "memory", "cpu", "pids" }) {
+		writeValue(group / "cgroup.subtree_control", string("+") + controller);
+	}
+	unique_lock<mutex> lock(groupsMutex);
+	batchGroups[workingDirectory.lexically_normal()] = group;
+	return group;
+}
+
+void CgroupManager::removeBatchGroup(const filesystem::path& workingDirectory)
+{
+	unique_lock<mutex> lock(groupsMutex);
+	auto batchGroup = batchGroups.find(workingDirectory.lexically_normal());
+	if (batchGroup == batchGroups.end()) {
+		return;
+	}
+	filesystem::path group = batchGroup->second;
+	batchGroups.erase(batchGroup);
+	lock.unlock();
+	removeGroup(group);
+}
+
+filesystem::path CgroupManager::getBatchGroup(const filesystem::path& workingDirectory)
+{
+	//Find the batch, whose working directory contains the job
+	filesystem::path jobDirectory = workingDirectory.lexically_normal();
+	unique_lock<mutex> lock(groupsMutex);
+	for (const auto& [batchDirectory, batchGroup] : batchGroups) {
+		filesystem::path relativeDirectory = jobDirectory.lexically_relative(batchDirectory);
+		if (!relativeDirectory.empty() && *relativeDirectory.begin() != "..") {
+			return batchGroup;
+		}
+	}
+	return root;
+}
+
+filesystem::path CgroupManager::createJobGroup(const filesystem::path& workingDirectory, bool container)
+{
+	filesystem::path group = createGroup(getBatchGroup(workingDirectory), "job");
+	if (group.empty()) {
+		return group;
+	}
+	writeValue(group / "memory.max", to_string(CONFIG.maxMemoryPerWorker));
+	writeValue(group / "cpu.max", CGROUP_JOB_CPU_MAX);
+	writeValue(group / "pids.max", to_string(CGROUP_JOB_PIDS_MAX));
+	//The container gets its own cgroup below the job group
+	if (container) {
+		for (const char* controller : { "memory", "cpu", "pids" }) {
+			writeValue(group / "cgroup.subtree_control", string("+") + controller);
+		}
+	}
+	return group;
+}
+
+string CgroupManager::generateDockerArgument(const filesystem::path& group)
+{
+	//Docker expects the path relative to the root of the hierarchy
+	filesystem::path hierarchyRoot = filesystem::absolute(group).lexically_normal();
+	while (hierarchyRoot.has_relative_path() && isCgroup2(hierarchyRoot.parent_path())) {
+		hierarchyRoot = hierarchyRoot.parent_path();
+	}
+	filesystem::path parent("/");
+	parent /= filesystem::absolute(group).lexically_normal().lexically_relative(hierarchyRoot);
+	return "--cgroup-parent=" + parent.lexically_normal().string();
+}
+
+CgroupManager::Usage CgroupManager::readUsage(const filesystem::path& group)
+{
+	Usage usage { 0, chrono::microseconds(0) };
+	ifstream peakMemory(group / "memory.peak");
+	if (peakMemory) {
+		peakMemory >> usage.peakMemory;
+	}
+	ifstream cpuStatistics(group / "cpu.stat");
+	string key;
+	unsigned long long value;
+	while (cpuStatistics >> key >> value) {
+		if (key == "usage_usec") {
+			usage.cpuTime = chrono::microseconds(value);
+			break;
+		}
+	}
+	return usage;
+}
+
+CgroupManager::Usage CgroupManager::removeJobGroup(const filesystem::path& group)
+{
+	Usage usage = readUsage(group);
+	removeGroup(group);
+	return usage;
+}
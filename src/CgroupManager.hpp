@@ -0,0 +1,170 @@
+#ifndef CGROUP_MANAGER_HPP
+#define CGROUP_MANAGER_HPP
+
+#include "Configuration.hpp"
+#include "Exceptions.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <linux/magic.h>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/vfs.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+
+#define DEFAULT_CGROUP_WEIGHT 100
+#define CGROUP_JOB_CPU_MAX "100000 100000"
+#define CGROUP_JOB_PIDS_MAX 64
+
+using namespace std;
+
+/**
+ * @class CgroupManager
+ *
+ * @brief Places compiler processes into cgroup v2 groups
+ *
+ * Every batch gets a cgroup below the root cgroup, every compiler job gets
+ * a cgroup below the cgroup of its batch:
+ *
+ *     root/batch-<n>/job-<n>
+ *
+ * The cpu.weight of the batch groups shares the cpu fairly between batches
+ * under contention. The job groups limit memory.max to the maximum memory per
+ * worker, cpu.max to one cpu and pids.max to CGROUP_JOB_PIDS_MAX processes.
+ * After a job finished, its peak memory and cpu time are read from the group.
+ *
+ * Jobs are assigned to the batch, whose working directory contains the working
+ * directory of the job. The compiler process is started in the job group, so the
+ * processes it forks are in it as well. Docker containers are started with the
+ * job or batch group as their cgroup parent instead, the docker client itself
+ * stays outside of the groups. This requires the cgroupfs cgroup driver of docker
+ * and a cgroup hierarchy, that looks the same for docker and this process.
+ *
+ * The root cgroup has to be delegated to this process, and this process must
+ * not be a member of it, because cgroups with controllers enabled for their
+ * children may not contain processes. Unavailable controllers are skipped.
+ *
+ * The CgroupManager is disabled, until setup is called.
+ */
+class CgroupManager {
+public:
+	struct Usage {
+		unsigned long long peakMemory;
+		chrono::microseconds cpuTime;
+	};
+
+private:
+	static CgroupManager* singleton;
+
+	filesystem::path root;
+	mutex groupsMutex;
+	//The cgroups of the batches by their working directories
+	map<filesystem::path, filesystem::path> batchGroups;
+	atomic<unsigned long long> createdGroups;
+
+	/** @brief Constructor that creates a CgroupManager
+    * @param [in] root a cgroup v2 directory, that is delegated to this process
+    * @return A pointer to the created CgroupManager
+    * @throw ConfigurationError if root is not a cgroup v2 directory
+    *
+    * Enables the memory, cpu and pids controllers for the children of root.
+    */
+	CgroupManager(const filesystem::path& root);
+
+	/** @brief Writes a value to a cgroup interface file
+    * @param [in] file the interface file
+    * @param [in] value the value to be written
+    * @return Boolean that indicates whether the value was written
+    */
+	static bool writeValue(const filesystem::path& file, const string& value);
+
+	/** @brief Creates a cgroup
+    * @param [in] parent the parent cgroup
+    * @param [in] prefix the prefix of the name of the cgroup
+    * @return The path of the created cgroup, empty if it could not be created
+    */
+	filesystem::path createGroup(const filesystem::path& parent, const string& prefix);
+
+	/** @brief Removes a cgroup, processes left in it are killed
+    * @param [in] group the cgroup to be removed
+    *
+    * Cgroups below it, like the ones of docker containers, are removed as well.
+    */
+	static void removeGroup(const filesystem::path& group);
+
+public:
+	/** @brief Returns a pointer to the CgroupManager singleton object
+    * @return A pointer to the CgroupManager singleton object, nullptr if it is disabled
+    */
+	static CgroupManager* get();
+
+	/** @brief Enables the CgroupManager
+    * @param [in] root a cgroup v2 directory, that is delegated to this process
+    * @throw ConfigurationError if the CgroupManager is already enabled or root is not a cgroup v2 directory
+    */
+	static void setup(const filesystem::path& root);
+
+	/** @brief Checks whether a directory is in a cgroup v2 hierarchy
+    * @param [in] directory the path of an existing directory
+    * @return Boolean that indicates whether the directory is a cgroup v2 directory
+    */
+	static bool isCgroup2(const filesystem::path& directory);
+
+	/** @brief Creates the cgroup of a batch
+    * @param [in] workingDirectory the working directory of the batch
+    * @param [in] weight the cpu.weight of the batch, between 1 and 10000
+    * @return The path of the created cgroup, empty if it could not be created
+    */
+	filesystem::path createBatchGroup(const filesystem::path& workingDirectory, unsigned int weight = DEFAULT_CGROUP_WEIGHT);
+
+	/** @brief Removes the cgroup of a batch
+    * @param [in] workingDirectory the working directory of the batch
+    */
+	void removeBatchGroup(const filesystem::path& workingDirectory);
+
+	/** @brief Returns the cgroup of the batch of a job
+    * @param [in] workingDirectory the directory where the job is executed
+    * @return The cgroup of the batch, whose working directory contains workingDirectory, or the root cgroup if there is none
+    */
+	filesystem::path getBatchGroup(const filesystem::path& workingDirectory);
+
+	/** @brief Creates the cgroup of a job
+    * @param [in] workingDirectory the directory where the job is executed
+    * @param [in] container a bool specifying if the job runs in a docker container below the cgroup
+    * @return The path of the created cgroup, empty if it could not be created
+    *
+    * The cgroup is created below the cgroup of the batch, whose working directory
+    * contains workingDirectory, or below the root cgroup if there is none.
+    * If container is set, the controllers are enabled for the cgroup of the container.
+    */
+	filesystem::path createJobGroup(const filesystem::path& workingDirectory, bool container = false);
+
+	/** @brief Generates the docker argument, that starts a container below a cgroup
+    * @param [in] group the cgroup
+    * @return The --cgroup-parent argument with the path of group in its cgroup hierarchy
+    */
+	static string generateDockerArgument(const filesystem::path& group);
+
+	/** @brief Reads the resource usage of a cgroup
+    * @param [in] group the cgroup
+    * @return The peak memory and cpu time of the processes in the cgroup, 0 if they are not available
+    */
+	static Usage readUsage(const filesystem::path& group);
+
+	/** @brief Removes the cgroup of a job, after its process exited
+    * @param [in] group the cgroup of the job
+    * @return The resource usage of the job
+    */
+	Usage removeJobGroup(const filesystem::path& group);
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "CombinedCertificate.hpp"
+
+CombinedCertificate::CombinedCertificate(const string& name, const string& content, const string& format, const vector<Certificate>& parts)
+	: Certificate(name, content, format)
+	, parts(parts)
+{
+}
+
+const vector<Certificate>& CombinedCertificate::getParts() const
+{
+	return parts;
+}
+
+vector<pair<unsigned int, unsigned int>> CombinedCertificate::readPageRanges(const filesystem::path& workingDirectory) const
+{
+	filesystem::path pagesFile(workingDirectory);
+	pagesFile.append(name);
+	pagesFile.replace_extension(".pages");
+	ifstream input(pagesFile, ios::in);
+	if (!input) {
+		stringstream message;
+		message << "Latex did not record page ranges in " << pagesFile;
+		throw LatexExecutionError(message.str());
+	}
+
+	//The file contains the number of shipped pages before every part and at the end
+	vector<unsigned int> shippedPages;
+	unsigned int pages;
+	while (input >> pages) {
+		shippedPages.push_back(pages);
+	}
+	input.close();
+	if (shippedPages.size() != parts.size() + 1) {
+		stringstream message;
+		message << "Latex recorded " << shippedPages.size() << " page marks for " << parts.size() << " certificates in " << name;
+		throw LatexExecutionError(message.str());
+	}
+
+	vector<pair<unsigned int, unsigned int>> pageRanges;
+	for (size_t i = 0; i < parts.size(); i++) {
+		if (shippedPages[i + 1] <= shippedPages[i]) {
+			stringstream message;
+			message << "Certificate " << parts[i].getName() << " has no pages in " << name;
+			throw LatexExecutionError(message.str());
+		}
+		pageRanges.emplace_back(shippedPages[i] + 1, shippedPages[i + 1]);
+	}
+	return pageRanges;
+}
+
+vector<string> CombinedCertificate::generateSplitArguments(const vector<pair<unsigned int, unsigned int>>& pageRanges) const
+{
+	vector<string> arguments;
+	arguments.push_back("sh");
+	arguments.push_back("-c");
+	arguments.push_back("input=$1; shift; while [ $# -gt 1 ]; do qpdf --empty --pages \"$input\" \"$1\" -- \"$2\" || exit 1; shift 2; done");
+	arguments.push_back("sh");
+	filesystem::path inputFile(name);
+	inputFile.replace_extension(".pdf");
+	arguments.push_back(inputFile.string());
+	for (size_t i = 0; i < parts.size(); i++) {
+		arguments.push_back(to_string(pageRanges[i].first) + "-" + to_string(pageRanges[i].second));
+		filesystem::path outputFile(parts[i].getName());
+		outputFile.replace_extension(".pdf");
+		arguments.push_back(outputFile.string());
+	}
+	return arguments;
+}
+
+vector<filesystem::path> CombinedCertificate::generatePDFs(const filesystem::path& workingDirectory, const filesystem::path& outputDirectory, const atomic_bool& killswitch, const string& resourcesHash) const
+{
+	vector<filesystem::path> finalPdfs;
+	vector<string> generatedNames = { name };
+	for (const Certificate& part : parts) {
+		generatedNames.push_back(part.getName());
+	}
+	Trace::Span span(trace, Trace::GENERATE_PDF, name);
+	filesystem::path jobDirectory;
+	JobDirectoryGuard jobDirectoryGuard(jobDirectory, trace, name);
+	{
+		Trace::Span createSpan(trace, Trace::CREATE_JOB_DIRECTORY, name);
+		jobDirectory = createJobDirectory(workingDirectory, generatedNames);
+	}
+	{
+		Trace::Span writeSpan(trace, Trace::WRITE_TO_WORKING_DIRECTORY, name);
+		writeToWorkingDirectory(jobDirectory);
+	}
+	vector<string> arguments = generateCompilerArguments();
+
+	if (killswitch) return finalPdfs;
+
+	CompilerRun run;
+	if (!compile(arguments, jobDirectory, killswitch, run)) return finalPdfs;
+
+	//Split the compiled pdf into the pdfs of the parts
+	vector<pair<unsigned int, unsigned int>> pageRanges = readPageRanges(jobDirectory);
+	vector<string> splitArguments = generateSplitArguments(pageRanges);
+	CompilerRun splitRun;
+	if (!runInSandbox(splitArguments, jobDirectory, killswitch, splitRun)) return finalPdfs;
+
+	//Move the pdfs of the parts to the output directory
+	PdfCache* cache = PdfCache::get();
+	for (const Certificate& part : parts) {
+		filesystem::path partPdf(jobDirectory);
+		partPdf.append(part.getName());
+		partPdf.replace_extension(".pdf");
+		{
+			Trace::Span moveSpan(trace, Trace::MOVE_RESULT_TO_OUTPUT_DIRECTORY, name);
+			finalPdfs.push_back(moveFile(partPdf, outputDirectory));
+		}
+		if (cache != nullptr) {
+			Trace::Span storeSpan(trace, Trace::CACHE_STORE, name);
+			cache->store(part.generateCacheKey(resourcesHash), finalPdfs.back());
+		}
+	}
+	return finalPdfs;
+}
@@ -0,0 +1,85 @@
+#ifndef COMBINED_CERTIFICATE_HPP
+#define COMBINED_CERTIFICATE_HPP
+
+#include "Certificate.hpp"
+#include "Exceptions.hpp"
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class CombinedCertificate
+ *
+ * @brief A document containing the certificates of multiple students
+ *
+ * A CombinedCertificate contains the bodies of multiple certificates of the
+ * same template in one document. It is compiled with a single latex run and
+ * then split into one pdf per certificate.
+ *
+ * While compiling, the document writes the number of pages shipped out
+ * before every certificate into the file NAME.pages. Those page ranges are
+ * used to split the pdf with qpdf. The resulting pdfs have the names of the
+ * certificates, the CombinedCertificate was created from.
+ */
+class CombinedCertificate : public Certificate {
+
+private:
+	vector<Certificate> parts;
+
+	/** @brief Reads the page ranges recorded during compilation
+    * @param [in] workingDirectory a string specifying the directory where latex was executed
+    * @return A vector containing the first and last page of every part.
+    * @throw LatexExecutionError if the recorded page ranges do not match the parts
+    */
+	vector<pair<unsigned int, unsigned int>> readPageRanges(const filesystem::path& workingDirectory) const;
+
+	/** @brief Generates the command to split the compiled pdf
+    * @param [in] pageRanges a vector containing the first and last page of every part
+    * @return A vector of strings containing arguments.
+    *
+    * The pdf is split by a single shell running qpdf once for every part,
+    * the command has to be run in the working directory with runInSandbox.
+    * The file names are passed as arguments to the shell, so they are never interpreted.
+    */
+	vector<string> generateSplitArguments(const vector<pair<unsigned int, unsigned int>>& pageRanges) const;
+
+public:
+	/** @brief Constructor that creates a CombinedCertificate
+    * @param [in] name is a string containing the name of the combined document without ending
+    * @param [in] content is a string containing the content of the combined document
+    * @param [in] format is a string containing the name of the format file latex is started with, empty for the default format
+    * @param [in] parts is a vector of the Certificates contained in the combined document
+    * @return A pointer to the created CombinedCertificate
+    */
+	CombinedCertificate(const string& name, const string& content, const string& format, const vector<Certificate>& parts);
+
+	/** @brief Returns the Certificates contained in this document
+    * @return A vector of the contained Certificates
+    */
+	const vector<Certificate>& getParts() const;
+
+	/** @brief Generates a pdf for every contained certificate
+    * @param [in] workingDirectory a string specifying the directory to be used for temporary files
+    * @param [in] outputDirectory a string specifying the directory where the pdfs should be put
+    * @param [in] killswitch a atomic_bool triggering cancelation of the generation, when set.
+    * @param [in] resourcesHash a string containing the hash of the resources in the working directory
+    * @return A vector containing the locations of the PDF files.
+    * @throw LatexExecutionError if compiling or splitting failed
+    *
+    * Compiles the combined document once in a private subdirectory of workingDirectory
+    * and splits the result into one pdf per contained certificate.
+    * The pdfs are named like the contained certificates.
+    * If the PdfCache is enabled, the pdfs are added to it, as if the contained
+    * certificates were compiled separately.
+    *
+    * If killswitch is set by another thread, it returns as soon as possible
+    * with an empty vector.
+    */
+	vector<filesystem::path> generatePDFs(const filesystem::path& workingDirectory, const filesystem::path& outputDirectory, const atomic_bool& killswitch, const string& resourcesHash = "") const;
+};
+
+#endif
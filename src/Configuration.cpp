@@ -2,7 +2,7 @@
 
 Configuration* Configuration::singleton = nullptr;
 
-Configuration::Configuration(bool docker, bool useThreads, unsigned int maxWorkersPerBatch, unsigned long long int maxMemoryPerWorker, unsigned int maxCpuTimePerWorker, unsigned int workerTimeout, unsigned int batchTimeout, unsigned int maxWorkers)
+Configuration::Configuration(bool docker, bool useThreads, unsigned int maxWorkersPerBatch, unsigned long long int maxMemoryPerWorker, unsigned int maxCpuTimePerWorker, unsigned int workerTimeout, unsigned int batchTimeout, unsigned int maxWorkers, bool precompilePreamble, unsigned int maxLatexPasses)
 	: docker(docker)
 	, useThreads(useThreads)
 	, maxWorkersPerBatch(maxWorkersPerBatch)
@@ -11,6 +11,8 @@ Configuration::Configuration(bool docker, bool useThreads, unsigned int maxWorke
 	, workerTimeout(workerTimeout)
 	, batchTimeout(batchTimeout)
 	, maxWorkers(maxWorkers)
+	, precompilePreamble(precompilePreamble)
+	, maxLatexPasses(maxLatexPasses)
 {
 }
 
@@ -26,10 +28,10 @@ const Configuration* Configuration::get()
 	return singleton;
 }
 
-void Configuration::setup(bool docker, bool useThreads, unsigned int maxWorkersPerBatch, unsigned long long int maxMemoryPerWorker, unsigned int maxCpuTimePerWorker, unsigned int workerTimeout, unsigned int batchTimeout, unsigned int maxWorkers)
+void Configuration::setup(bool docker, bool useThreads, unsigned int maxWorkersPerBatch, unsigned long long int maxMemoryPerWorker, unsigned int maxCpuTimePerWorker, unsigned int workerTimeout, unsigned int batchTimeout, unsigned int maxWorkers, bool precompilePreamble, unsigned int maxLatexPasses)
 {
 	if (singleton == nullptr) {
-		singleton = new Configuration(docker, useThreads, maxWorkersPerBatch, maxMemoryPerWorker, maxCpuTimePerWorker, workerTimeout, batchTimeout, maxWorkers);
+		singleton = new Configuration(docker, useThreads, maxWorkersPerBatch, maxMemoryPerWorker, maxCpuTimePerWorker, workerTimeout, batchTimeout, maxWorkers, precompilePreamble, maxLatexPasses);
 	} else {
 		throw ConfigurationError("Configuration already specified");
 	}
@@ -38,7 +40,7 @@ void Configuration::setup(bool docker, bool useThreads, unsigned int maxWorkersP
 void Configuration::setup()
 {
 	if (singleton == nullptr) {
-		singleton = new Configuration(DEFAULT_DOCKER, DEFAULT_USE_THREAD, DEFAULT_MAX_BATCH_WORKERS, DEFAULT_MAX_MEMORY, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS);
+		singleton = new Configuration(DEFAULT_DOCKER, DEFAULT_USE_THREAD, DEFAULT_MAX_BATCH_WORKERS, DEFAULT_MAX_MEMORY, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS, DEFAULT_PRECOMPILE_PREAMBLE, DEFAULT_MAX_LATEX_PASSES);
 	} else {
 		throw ConfigurationError("Configuration already specified");
 	}
@@ -11,6 +11,8 @@
 #define DEFAULT_WORKER_TIMEOUT 30
 #define DEFAULT_TIMEOUT 300
 #define DEFAULT_MAX_WORKERS 8
+#define DEFAULT_PRECOMPILE_PREAMBLE true
+#define DEFAULT_MAX_LATEX_PASSES 3
 
 #define MTOS_HELPER(m) #m
 #define MTOS(m) MTOS_HELPER(m)
@@ -37,8 +39,10 @@ private:
     * @param [in] maxMemoryPerWorker a int specifying the maximum memory in bytes of each latex compiler process
     * @param [in] maxCpuTimePerWorker a int specifying the maximum cpu time in seconds of each latex compiler process
     * @param [in] workerTimeout a int specifying the maximum time a latex compiler process is allowed to run, before it gets terminated
-    * @param [in] batchTimeout a int specifying the maximum time the batch is allowed to run, before it gets terminated
+    * @param [in] batchTimeout a int specifying the maximum time the batch is allowed to run, before it gets terminated, 0 for no limit
     * @param [in] maxWorkers a int specifying the maximum number of parallel latex compiler processes running
+    * @param [in] precompilePreamble a bool specifying if the static preamble of templates is precompiled into a format file
+    * @param [in] maxLatexPasses a int specifying how often latex is run at most for a document, if it requests a rerun
     * @return A pointer to the created Certificate
     *
     * This method creates a configuration with the given parameters
@@ -46,7 +50,7 @@ private:
     * Its private, to prevent other classes to create a Configuration
     * object other than the one singleton points to.
     */
-	Configuration(bool docker, bool useThreads, unsigned int maxWorkersPerBatch, unsigned  long long int maxMemoryPerWorker, unsigned int maxCpuTimePerWorker, unsigned int workerTimeout, unsigned int batchTimeout, unsigned int maxWorkers);
+	Configuration(bool docker, bool useThreads, unsigned int maxWorkersPerBatch, unsigned  long long int maxMemoryPerWorker, unsigned int maxCpuTimePerWorker, unsigned int workerTimeout, unsigned int batchTimeout, unsigned int maxWorkers, bool precompilePreamble, unsigned int maxLatexPasses);
 	
 	/** @brief Destructor of Configuration
     *
@@ -72,14 +76,16 @@ public:
     * @param [in] maxMemoryPerWorker a int specifying the maximum memory in bytes of each latex compiler process
     * @param [in] maxCpuTimePerWorker a int specifying the maximum cpu time in seconds of each latex compiler process
     * @param [in] workerTimeout a int specifying the maximum time a latex compiler process is allowed to run, before it gets terminated
-    * @param [in] batchTimeout a int specifying the maximum time the batch is allowed to run, before it gets terminated
+    * @param [in] batchTimeout a int specifying the maximum time the batch is allowed to run, before it gets terminated, 0 for no limit
     * @param [in] maxWorkers a int specifying the maximum number of parallel latex compiler processes running
+    * @param [in] precompilePreamble a bool specifying if the static preamble of templates is precompiled into a format file
+    * @param [in] maxLatexPasses a int specifying how often latex is run at most for a document, if it requests a rerun
     * @throw ConfigurationError if the singleton is already set
     * Generates a Configuration with the given values and sets the singleton to it.
     * 
     * Throws a ConfigurationError if the singleton is already set.
     */
-	static void setup(bool docker, bool useThreads, unsigned int maxWorkersPerBatch, unsigned  long long int maxMemoryPerWorker, unsigned int maxCpuTimePerWorker, unsigned int workerTimeout, unsigned int batchTimeout, unsigned int maxWorkers);
+	static void setup(bool docker, bool useThreads, unsigned int maxWorkersPerBatch, unsigned  long long int maxMemoryPerWorker, unsigned int maxCpuTimePerWorker, unsigned int workerTimeout, unsigned int batchTimeout, unsigned int maxWorkers, bool precompilePreamble = DEFAULT_PRECOMPILE_PREAMBLE, unsigned int maxLatexPasses = DEFAULT_MAX_LATEX_PASSES);
 	/** @brief Generates a Configuration and sets the singleton
 	* @throw ConfigurationError if the singleton is already set
     * Generates a Configuration with the default values and sets the singleton to it.
@@ -106,6 +112,11 @@ public:
 	const unsigned int batchTimeout;
 	//The maximum number of parallel latex compiler processes running
 	const unsigned int maxWorkers;
+	//Specifies if the static part of the template preambles is precompiled into a format file once per batch
+	const bool precompilePreamble;
+
+	//The maximum number of times latex is run for a document, it is only run again if it requests a rerun
+	const unsigned int maxLatexPasses;
 };
 
 #endif
@@ -0,0 +1,219 @@
+#include "DockerPool.hpp"
+
+DockerPool* DockerPool::singleton = nullptr;
+
+DockerPool::DockerPool(const filesystem::path& mountDirectory, unsigned int size, unsigned int jobsPerContainer)
+	: size(size)
+	, jobsPerContainer(jobsPerContainer)
+	, running(0)
+	, startedContainers(0)
+{
+	error_code error;
+	this->mountDirectory = filesystem::canonical(mountDirectory, error);
+	if (error) {
+		stringstream message;
+		message << "Failed to access container mount directory " << mountDirectory.string() << ": " << error.message();
+		throw FileAccessError(message.str());
+	}
+}
+
+DockerPool* DockerPool::get()
+{
+	return singleton;
+}
+
+void DockerPool::setup(const filesystem::path& mountDirectory, unsigned int size, unsigned int jobsPerContainer)
+{
+	if (singleton == nullptr) {
+		singleton = new DockerPool(mountDirectory, size, jobsPerContainer);
+	} else {
+		throw ConfigurationError("Docker pool already specified");
+	}
+}
+
+vector<string> DockerPool::generateRunArguments(const string& name, const filesystem::path& batchDirectory, const filesystem::path& cgroup) const
+{
+	vector<string> arguments;
+	arguments.push_back("docker");
+	arguments.push_back("run");
+	arguments.push_back("-i");
+	arguments.push_back("--rm");
+	arguments.push_back("--name=" + name);
+	arguments.push_back("-v");
+	arguments.push_back(batchDirectory.string() + ":/src/");
+	arguments.push_back("-w=/src/");
+	arguments.push_back("--network=none");
+	arguments.push_back("--security-opt=no-new-privileges");
+	arguments.push_back("--ipc=none");
+	arguments.push_back("--memory=" + to_string(CONFIG.maxMemoryPerWorker));
+	arguments.push_back("--user=" + to_string(getuid()));
+	arguments.push_back("--cap-drop=ALL");
+	if (!cgroup.empty()) {
+		arguments.push_back(CgroupManager::generateDockerArgument(cgroup));
+	}
+	//Latex may only open files in its working directory, even though the mount contains the whole batch
+	arguments.push_back("--env=openin_any=p");
+	arguments.push_back("--env=openout_any=p");
+	arguments.push_back(DOCKER_IMAGE);
+	arguments.push_back("sh");
+	arguments.push_back("-c");
+	arguments.push_back("echo ready; exec cat >/dev/null");
+	return arguments;
+}
+
+bool DockerPool::startContainer(const filesystem::path& batchDirectory, const filesystem::path& cgroup, Container& container)
+{
+	{
+		unique_lock<mutex> lock(poolMutex);
+		container.name = "certificate-generator-" + to_string(getpid()) + "-" + to_string(startedContainers++);
+	}
+	container.jobs = 0;
+	container.batchDirectory = batchDirectory;
+
+	int input[2];
+	int output[2];
+	if (pipe2(input, O_CLOEXEC) != 0) {
+		return false;
+	}
+	if (pipe2(output, O_CLOEXEC) != 0) {
+		close(input[0]);
+		close(input[1]);
+		return false;
+	}
+
+	ProcessLauncher launcher(generateRunArguments(container.name, batchDirectory, cgroup), batchDirectory);
+	launcher.setInput(input[0]);
+	launcher.setOutput(output[1]);
+	pid_t client;
+	try {
+		client = launcher.launch();
+	} catch (const GeneratorError& error) {
+		spdlog::warn("Failed to start container {}: {}", container.name, error.what());
+		client = -1;
+	}
+	close(input[0]);
+	close(output[1]);
+	if (client == -1) {
+		close(input[1]);
+		close(output[0]);
+		return false;
+	}
+
+	//Wait until the container is ready, this includes pulling the image
+	char ready;
+	ssize_t readBytes;
+	do {
+		readBytes = read(output[0], &ready, 1);
+	} while (readBytes < 0 && errno == EINTR);
+	close(output[0]);
+	if (readBytes != 1) {
+		spdlog::warn("Failed to start container {}", container.name);
+		close(input[1]);
+		waitpid(client, nullptr, 0);
+		return false;
+	}
+
+	container.client = client;
+	container.input = input[1];
+	spdlog::trace("Started container {}", container.name);
+	return true;
+}
+
+void DockerPool::stopContainer(const Container& container)
+{
+	close(container.input);
+	if (container.client > 0) {
+		pid_t client = container.client;
+		thread([client]() { waitpid(client, nullptr, 0); }).detach();
+	}
+	spdlog::trace("Stopped container {} after {} jobs", container.name, container.jobs);
+}
+
+filesystem::path DockerPool::getBatchDirectory(const filesystem::path& workingDirectory) const
+{
+	error_code error;
+	filesystem::path relativeDirectory = filesystem::weakly_canonical(workingDirectory, error).lexically_relative(mountDirectory);
+	if (error || relativeDirectory.empty() || *relativeDirectory.begin() == ".." || *relativeDirectory.begin() == ".") {
+		return "";
+	}
+	return mountDirectory / *relativeDirectory.begin();
+}
+
+bool DockerPool::acquire(const filesystem::path& workingDirectory, Container& container)
+{
+	filesystem::path batchDirectory = getBatchDirectory(workingDirectory);
+	if (batchDirectory.empty()) {
+		return false;
+	}
+
+	unique_lock<mutex> lock(poolMutex);
+	for (auto idleContainer = idle.begin(); idleContainer != idle.end(); idleContainer++) {
+		if (idleContainer->batchDirectory == batchDirectory) {
+			container = *idleContainer;
+			idle.erase(idleContainer);
+			return true;
+		}
+	}
+	if (running >= size) {
+		if (idle.empty()) {
+			return false;
+		}
+		//The idle containers belong to other batches, the one idle for the longest time is replaced
+		stopContainer(idle.front());
+		idle.pop_front();
+	} else {
+		running++;
+	}
+	lock.unlock();
+	//The container is started below the cgroup of the batch
+	CgroupManager* cgroups = CgroupManager::get();
+	filesystem::path cgroup = cgroups != nullptr ? cgroups->getBatchGroup(workingDirectory) : "";
+	if (startContainer(batchDirectory, cgroup, container)) {
+		return true;
+	}
+	lock.lock();
+	running--;
+	return false;
+}
+
+void DockerPool::releaseBatch(const filesystem::path& workingDirectory)
+{
+	filesystem::path batchDirectory = getBatchDirectory(workingDirectory);
+	unique_lock<mutex> lock(poolMutex);
+	for (auto idleContainer = idle.begin(); idleContainer != idle.end();) {
+		if (idleContainer->batchDirectory == batchDirectory) {
+			stopContainer(*idleContainer);
+			idleContainer = idle.erase(idleContainer);
+			running--;
+		} else {
+			idleContainer++;
+		}
+	}
+}
+
+void DockerPool::release(Container container, bool failed)
+{
+	container.jobs++;
+	if (!failed && container.jobs < jobsPerContainer) {
+		unique_lock<mutex> lock(poolMutex);
+		idle.push_back(container);
+		return;
+	}
+	//Processes of a failed job may still be running, so the container is stopped
+	stopContainer(container);
+	unique_lock<mutex> lock(poolMutex);
+	running--;
+}
+
+vector<string> DockerPool::generateExecArguments(const Container& container, const filesystem::path& workingDirectory, const vector<string>& command) const
+{
+	filesystem::path containerDirectory("/src/");
+	containerDirectory /= filesystem::canonical(workingDirectory).lexically_relative(container.batchDirectory);
+	vector<string> arguments;
+	arguments.push_back("docker");
+	arguments.push_back("exec");
+	arguments.push_back("-w=" + containerDirectory.lexically_normal().string());
+	arguments.push_back(container.name);
+	arguments.insert(arguments.end(), command.begin(), command.end());
+	return arguments;
+}
@@ -0,0 +1,175 @@
+#ifndef DOCKER_POOL_HPP
+#define DOCKER_POOL_HPP
+
+#include "CgroupManager.hpp"
+#include "Configuration.hpp"
+#include "Exceptions.hpp"
+#include "ProcessLauncher.hpp"
+#include <cerrno>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <wait.h>
+
+#include "spdlog/spdlog.h"
+
+#define DOCKER_IMAGE "madmanfred/alpine-xetex"
+#define DEFAULT_WARM_CONTAINERS true
+#define DEFAULT_CONTAINER_JOBS 100
+
+using namespace std;
+
+/**
+ * @class DockerPool
+ *
+ * @brief A pool of running sandbox containers, that execute compiler jobs
+ *
+ * Starting a docker container for every compiler process takes longer than
+ * compiling a certificate. The DockerPool starts long lived containers with
+ * the same restrictions instead, and executes the jobs in them with docker exec.
+ *
+ * Every container is bound to one batch and only mounts the directory of that
+ * batch, which is the directory directly below the mount directory containing
+ * the working directory. So a job can never see the files of other batches.
+ * The containers are started, when a batch needs them, and reused for its
+ * following jobs. If the pool is full, an idle container of another batch is
+ * replaced. Containers can not be started in advance, because the directory
+ * of the batch is mounted when the container starts, so the startup time is
+ * only saved for the jobs of a batch after its first ones.
+ *
+ * Each container executes only one job at a time. It gets stopped after it
+ * executed jobsPerContainer jobs or after a job failed, because a killed
+ * docker exec leaves its processes running inside the container.
+ *
+ * If cgroups are enabled, the containers are started below the cgroup of
+ * their batch.
+ *
+ * A container runs as long as the pipe to its docker client is open,
+ * so all containers stop when the process exits, even if it crashes.
+ *
+ * The pool is disabled, until setup is called.
+ */
+class DockerPool {
+public:
+	struct Container {
+		string name;
+		pid_t client;
+		int input;
+		unsigned int jobs;
+		//The directory of the batch, that is mounted into the container
+		filesystem::path batchDirectory;
+	};
+
+private:
+	static DockerPool* singleton;
+
+	filesystem::path mountDirectory;
+	unsigned int size;
+	unsigned int jobsPerContainer;
+	mutex poolMutex;
+	deque<Container> idle;
+	//The number of running or starting containers, including containers that are executing jobs
+	unsigned int running;
+	unsigned int startedContainers;
+
+	/** @brief Constructor that creates a DockerPool
+    * @param [in] mountDirectory the directory containing the directories of the batches
+    * @param [in] size the maximum number of running containers
+    * @param [in] jobsPerContainer the number of jobs after which a container gets replaced
+    * @return A pointer to the created DockerPool
+    * @throw FileAccessError if the mount directory does not exist
+    */
+	DockerPool(const filesystem::path& mountDirectory, unsigned int size, unsigned int jobsPerContainer);
+
+	/** @brief Generates the arguments for execvp to start a container of the pool
+	* @param [in] name a string containing the name of the container
+	* @param [in] batchDirectory the directory of the batch, that gets mounted into the container
+	* @param [in] cgroup the cgroup, that the container is started below, empty for the default cgroup of docker
+    * @return A vector of strings containing arguments.
+    *
+    * The container is restricted like the containers of single compiler processes.
+    * It prints a line, when it is ready, and exits when its standard input is closed.
+    */
+	vector<string> generateRunArguments(const string& name, const filesystem::path& batchDirectory, const filesystem::path& cgroup = "") const;
+
+	/** @brief Starts a container for a batch and waits until it is ready
+	* @param [in] batchDirectory the directory of the batch, that gets mounted into the container
+	* @param [in] cgroup the cgroup, that the container is started below, empty for the default cgroup of docker
+	* @param [out] container the started container
+    * @return Boolean that indicates whether the container was started
+    */
+	bool startContainer(const filesystem::path& batchDirectory, const filesystem::path& cgroup, Container& container);
+
+	/** @brief Returns the directory of the batch, a working directory belongs to
+	* @param [in] workingDirectory the directory where a job is executed
+    * @return The directory directly below the mount directory containing workingDirectory, empty if it is not below the mount directory
+    */
+	filesystem::path getBatchDirectory(const filesystem::path& workingDirectory) const;
+
+	/** @brief Stops a container
+	* @param [in] container the container to be stopped
+    *
+    * Closing the input of the container stops it, the docker client is
+    * reaped in the background.
+    */
+	static void stopContainer(const Container& container);
+
+public:
+	/** @brief Returns a pointer to the pool singleton object
+    * @return A pointer to the pool singleton object, nullptr if the pool is disabled
+    */
+	static DockerPool* get();
+
+	/** @brief Enables the pool
+    * @param [in] mountDirectory the directory containing the directories of the batches, all working directories have to be below it
+    * @param [in] size the maximum number of running containers
+    * @param [in] jobsPerContainer the number of jobs after which a container gets replaced
+    * @throw ConfigurationError if the pool is already enabled
+    * @throw FileAccessError if the mount directory does not exist
+    */
+	static void setup(const filesystem::path& mountDirectory, unsigned int size = CONFIG.maxWorkers, unsigned int jobsPerContainer = DEFAULT_CONTAINER_JOBS);
+
+	/** @brief Takes an idle container from the pool
+	* @param [in] workingDirectory the directory where the job will be executed
+	* @param [out] container the container that executes the job
+    * @return Boolean that indicates whether a container is available
+    *
+    * Only containers of the batch of the working directory are used. If none of
+    * them is idle, a new one is started. If the pool is full, an idle container
+    * of another batch is stopped for it.
+    * No container is available for working directories outside the mount directory.
+    * The container has to be given back with release.
+    */
+	bool acquire(const filesystem::path& workingDirectory, Container& container);
+
+	/** @brief Stops the idle containers of a finished batch
+	* @param [in] workingDirectory a directory of the batch
+    */
+	void releaseBatch(const filesystem::path& workingDirectory);
+
+	/** @brief Gives a container back to the pool
+	* @param [in] container the container, that executed a job
+	* @param [in] failed a bool specifying if the job failed or was killed
+    *
+    * The container gets stopped, if the job failed or the container
+    * executed jobsPerContainer jobs.
+    */
+	void release(Container container, bool failed);
+
+	/** @brief Generates the arguments for execvp to execute a command in a container
+	* @param [in] container the container, that executes the command
+	* @param [in] workingDirectory the directory where the command is executed
+	* @param [in] command a vector of strings containing the command and its arguments
+    * @return A vector of strings containing arguments.
+    */
+	vector<string> generateExecArguments(const Container& container, const filesystem::path& workingDirectory, const vector<string>& command) const;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef EXCEPTIONS_HPP
 #define EXCEPTIONS_HPP
 
+#include <chrono>
 #include <stdexcept>
 #include <string>
 
@@ -29,9 +30,40 @@ class ForkFailedError : public GeneratorError {
 	using GeneratorError::GeneratorError;
 };
 
+//What is known about the compiler runs of a certificate
+struct CompilerRun {
+	std::string certificate;
+	//The exit code of the last run, or the negated signal that terminated it
+	int exitCode = 0;
+	unsigned int passes = 0;
+	std::chrono::microseconds wallTime { 0 };
+	std::chrono::microseconds cpuTime { 0 };
+	long long peakMemory = 0;
+	//Whether cpuTime and peakMemory were measured, they are unknown for compilers in docker containers
+	bool measured = true;
+	//The end of the log of the last run, only read if it failed
+	std::string logTail;
+};
+
 //When latex execution failed
 class LatexExecutionError : public GeneratorError {
+private:
+	CompilerRun run;
+
+public:
 	using GeneratorError::GeneratorError;
+
+	LatexExecutionError(const std::string& message, const CompilerRun& run)
+		: GeneratorError(message)
+		, run(run)
+	{
+	}
+
+	//The compiler runs of the failed certificate, empty if the compiler was not run
+	const CompilerRun& getRun() const
+	{
+		return run;
+	}
 };
 
 //When the xelatex command is not found
@@ -44,4 +76,9 @@ class ConfigurationError : public GeneratorError {
 	using GeneratorError::GeneratorError;
 };
 
+//Thrown if a batch did not finish before its timeout
+class BatchTimeoutError : public GeneratorError {
+	using GeneratorError::GeneratorError;
+};
+
 #endif
@@ -0,0 +1,87 @@
+#include "MemoryDirectory.hpp"
+
+MemoryDirectory* MemoryDirectory::singleton = nullptr;
+
+MemoryDirectory::MemoryDirectory(const filesystem::path& directory, unsigned long long admissionLimit)
+	: directory(directory)
+	, admissionLimit(admissionLimit)
+{
+	error_code error;
+	filesystem::create_directories(directory, error);
+	if (error) {
+		stringstream message;
+		message << "Failed to create memory directory " << directory.string() << ": " << error.message();
+		throw FileAccessError(message.str());
+	}
+	if (!isMemoryBacked(directory)) {
+		spdlog::warn("Memory directory {} is not on a tmpfs, its files are written to disk", directory.string());
+	}
+}
+
+MemoryDirectory* MemoryDirectory::get()
+{
+	return singleton;
+}
+
+void MemoryDirectory::setup(const filesystem::path& directory, unsigned long long admissionLimit)
+{
+	if (singleton == nullptr) {
+		singleton = new MemoryDirectory(directory, admissionLimit);
+	} else {
+		throw ConfigurationError("Memory directory already specified");
+	}
+}
+
+bool MemoryDirectory::isMemoryBacked(const filesystem::path& directory)
+{
+	struct statfs filesystemInfo;
+	if (statfs(directory.c_str(), &filesystemInfo) != 0) {
+		return false;
+	}
+	return filesystemInfo.f_type == TMPFS_MAGIC || filesystemInfo.f_type == RAMFS_MAGIC;
+}
+
+const filesystem::path& MemoryDirectory::getPath() const
+{
+	return directory;
+}
+
+filesystem::path MemoryDirectory::createDirectory(const string& name)
+{
+	//Batches may be admitted concurrently, the limit is only a threshold
+	unsigned long long usage = getUsage();
+	if (usage >= admissionLimit) {
+		spdlog::debug("Memory directory has reached the admission limit with {} of {} bytes, not creating {}", usage, admissionLimit, name);
+		return "";
+	}
+	filesystem::path batchDirectory(directory);
+	batchDirectory.append(name);
+	error_code error;
+	filesystem::create_directories(batchDirectory, error);
+	if (error) {
+		stringstream message;
+		message << "Failed to create directory " << batchDirectory.string() << " in memory directory: " << error.message();
+		throw FileAccessError(message.str());
+	}
+	return batchDirectory;
+}
+
+unsigned long long MemoryDirectory::getUsage() const
+{
+	//Batches add and remove files concurrently, so files that vanish are skipped
+	unsigned long long usage = 0;
+	set<pair<dev_t, ino_t>> countedFiles;
+	error_code error;
+	filesystem::recursive_directory_iterator file(directory, filesystem::directory_options::skip_permission_denied, error);
+	while (!error && file != filesystem::recursive_directory_iterator()) {
+		struct stat fileInfo;
+		if (lstat(file->path().c_str(), &fileInfo) == 0 && S_ISREG(fileInfo.st_mode)) {
+			//Hard links share their inode
+			if (fileInfo.st_nlink == 1 || countedFiles.insert({ fileInfo.st_dev, fileInfo.st_ino }).second) {
+				usage += fileInfo.st_size;
+			}
+		}
+		file.increment(error);
+	}
+	return usage;
+}
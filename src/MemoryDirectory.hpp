@@ -0,0 +1,97 @@
+#ifndef MEMORY_DIRECTORY_HPP
+#define MEMORY_DIRECTORY_HPP
+
+#include "Exceptions.hpp"
+#include <filesystem>
+#include <linux/magic.h>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <system_error>
+
+#include "spdlog/spdlog.h"
+
+#define DEFAULT_MEMORY_DIRECTORY_ADMISSION_LIMIT 1000000000
+
+using namespace std;
+
+/**
+ * @class MemoryDirectory
+ *
+ * @brief A directory on a tmpfs, that holds the working directories of batches
+ *
+ * Latex writes the tex, aux, log and pdf files of every certificate to its working
+ * directory. If the working and output directories of a batch are in the MemoryDirectory,
+ * none of these files are written to a disk and the pdfs are moved to the output
+ * directory by renaming them.
+ *
+ * The directory has to be on a tmpfs, like /dev/shm. The admission limit is not a
+ * limit of the size of the directory: it is only checked when a new batch directory
+ * is created, by adding up the files in the MemoryDirectory. If they use less than
+ * the admission limit, the batch is admitted and may grow beyond the limit while
+ * it runs, otherwise the batch has to use a directory on disk. The tmpfs itself
+ * has to be sized for the admitted batches.
+ *
+ * The MemoryDirectory is disabled, until setup is called.
+ */
+class MemoryDirectory {
+private:
+	static MemoryDirectory* singleton;
+
+	filesystem::path directory;
+	unsigned long long admissionLimit;
+
+	/** @brief Constructor that creates a MemoryDirectory
+    * @param [in] directory a directory on a tmpfs
+    * @param [in] admissionLimit the size of all files in the directory in bytes, from which on no new batches are admitted
+    * @return A pointer to the created MemoryDirectory
+    * @throw FileAccessError if the directory can not be created
+    *
+    * Logs a warning, if the directory is not on a tmpfs.
+    */
+	MemoryDirectory(const filesystem::path& directory, unsigned long long admissionLimit);
+
+public:
+	/** @brief Returns a pointer to the MemoryDirectory singleton object
+    * @return A pointer to the MemoryDirectory singleton object, nullptr if it is disabled
+    */
+	static MemoryDirectory* get();
+
+	/** @brief Enables the MemoryDirectory
+    * @param [in] directory a directory on a tmpfs
+    * @param [in] admissionLimit the size of all files in the directory in bytes, from which on no new batches are admitted
+    * @throw ConfigurationError if the MemoryDirectory is already enabled
+    * @throw FileAccessError if the directory can not be created
+    */
+	static void setup(const filesystem::path& directory, unsigned long long admissionLimit = DEFAULT_MEMORY_DIRECTORY_ADMISSION_LIMIT);
+
+	/** @brief Checks whether a directory is on a tmpfs
+    * @param [in] directory the path of an existing directory
+    * @return Boolean that indicates whether the files in the directory are stored in memory
+    */
+	static bool isMemoryBacked(const filesystem::path& directory);
+
+	/** @brief Returns the path of the MemoryDirectory
+    * @return The path of the MemoryDirectory
+    */
+	const filesystem::path& getPath() const;
+
+	/** @brief Creates a directory for a batch
+    * @param [in] name the name of the new directory
+    * @return The path of the created directory, empty if the admission limit is reached
+    * @throw FileAccessError if the directory can not be created
+    */
+	filesystem::path createDirectory(const string& name);
+
+	/** @brief Returns the size of all files in the MemoryDirectory
+    * @return The size in bytes
+    *
+    * Files with several hard links, like the resources linked into every job
+    * directory, are stored once by the tmpfs, so they are only counted once.
+    */
+	unsigned long long getUsage() const;
+};
+
+#endif
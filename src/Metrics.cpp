@@ -0,0 +1,210 @@
+#include "Metrics.hpp"
+
+const vector<double> Metrics::durationBuckets = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300 };
+const vector<double> Metrics::memoryBuckets = { 16e6, 32e6, 64e6, 128e6, 256e6, 512e6, 1e9, 2e9, 4e9, 8e9 };
+
+Metrics::Counter::Counter()
+	: value(0)
+{
+}
+
+void Metrics::Counter::increment(unsigned long long amount)
+{
+	value.fetch_add(amount, memory_order_relaxed);
+}
+
+unsigned long long Metrics::Counter::getValue() const
+{
+	return value.load(memory_order_relaxed);
+}
+
+Metrics::Gauge::Gauge()
+	: value(0)
+{
+}
+
+void Metrics::Gauge::add(long long amount)
+{
+	value.fetch_add(amount, memory_order_relaxed);
+}
+
+void Metrics::Gauge::set(long long value)
+{
+	this->value.store(value, memory_order_relaxed);
+}
+
+long long Metrics::Gauge::getValue() const
+{
+	return value.load(memory_order_relaxed);
+}
+
+Metrics::Histogram::Histogram(const vector<double>& bounds)
+	: bounds(bounds)
+	, buckets(new atomic<unsigned long long>[bounds.size() + 1])
+	, count(0)
+	, sum(0)
+{
+	for (size_t i = 0; i <= bounds.size(); i++) {
+		buckets[i].store(0, memory_order_relaxed);
+	}
+}
+
+void Metrics::Histogram::observe(double value)
+{
+	size_t bucket = 0;
+	while (bucket < bounds.size() && value > bounds[bucket]) {
+		bucket++;
+	}
+	buckets[bucket].fetch_add(1, memory_order_relaxed);
+	count.fetch_add(1, memory_order_relaxed);
+	double currentSum = sum.load(memory_order_relaxed);
+	while (!sum.compare_exchange_weak(currentSum, currentSum + value, memory_order_relaxed)) {
+	}
+}
+
+const vector<double>& Metrics::Histogram::getBounds() const
+{
+	return bounds;
+}
+
+unsigned long long Metrics::Histogram::getCumulativeCount(size_t bucket) const
+{
+	unsigned long long cumulativeCount = 0;
+	for (size_t i = 0; i <= bucket && i <= bounds.size(); i++) {
+		cumulativeCount += buckets[i].load(memory_order_relaxed);
+	}
+	return cumulativeCount;
+}
+
+unsigned long long Metrics::Histogram::getCount() const
+{
+	return count.load(memory_order_relaxed);
+}
+
+double Metrics::Histogram::getSum() const
+{
+	return sum.load(memory_order_relaxed);
+}
+
+Metrics::ScopedTimer::ScopedTimer(Histogram& histogram, Counter* errors)
+	: histogram(histogram)
+	, errors(errors)
+	, start(chrono::steady_clock::now())
+	, exceptions(uncaught_exceptions())
+{
+}
+
+Metrics::ScopedTimer::~ScopedTimer()
+{
+	histogram.observe(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	if (errors != nullptr && uncaught_exceptions() > exceptions) {
+		errors->increment();
+	}
+}
+
+Metrics& Metrics::get()
+{
+	static Metrics metrics;
+	return metrics;
+}
+
+Metrics::Family& Metrics::getFamily(const string& name, const string& type, const string& help)
+{
+	Family& family = families[name];
+	if (family.type.empty()) {
+		family.type = type;
+		family.help = help;
+	} else if (family.type != type) {
+		stringstream message;
+		message << "Metric " << name << " is already registered as " << family.type;
+		throw ConfigurationError(message.str());
+	}
+	return family;
+}
+
+Metrics::Counter& Metrics::counter(const string& name, const string& help, const string& labels)
+{
+	unique_lock<mutex> lock(metricsMutex);
+	unique_ptr<Counter>& counter = getFamily(name, "counter", help).counters[labels];
+	if (!counter) {
+		counter = make_unique<Counter>();
+	}
+	return *counter;
+}
+
+Metrics::Gauge& Metrics::gauge(const string& name, const string& help, const string& labels)
+{
+	unique_lock<mutex> lock(metricsMutex);
+	unique_ptr<Gauge>& gauge = getFamily(name, "gauge", help).gauges[labels];
+	if (!gauge) {
+		gauge = make_unique<Gauge>();
+	}
+	return *gauge;
+}
+
+Metrics::Histogram& Metrics::histogram(const string& name, const string& help, const string& labels, const vector<double>& bounds)
+{
+	unique_lock<mutex> lock(metricsMutex);
+	unique_ptr<Histogram>& histogram = getFamily(name, "histogram", help).histograms[labels];
+	if (!histogram) {
+		histogram = make_unique<Histogram>(bounds);
+	}
+	return *histogram;
+}
+
+void Metrics::callback(const string& name, const string& type, const string& help, function<double()> value, const string& labels)
+{
+	unique_lock<mutex> lock(metricsMutex);
+	getFamily(name, type, help).callbacks[labels] = move(value);
+}
+
+string Metrics::formatValue(double value)
+{
+	if (value == numeric_limits<double>::infinity()) {
+		return "+Inf";
+	}
+	stringstream formatted;
+	formatted.precision(15);
+	formatted << value;
+	return formatted.str();
+}
+
+string Metrics::formatLabels(const string& labels, const string& extraLabel)
+{
+	if (labels.empty() && extraLabel.empty()) {
+		return "";
+	}
+	if (labels.empty() || extraLabel.empty()) {
+		return "{" + labels + extraLabel + "}";
+	}
+	return "{" + labels + "," + extraLabel + "}";
+}
+
+string Metrics::render()
+{
+	unique_lock<mutex> lock(metricsMutex);
+	stringstream output;
+	for (const auto& [name, family] : families) {
+		output << "# HELP " << name << " " << family.help << "\n";
+		output << "# TYPE " << name << " " << family.type << "\n";
+		for (const auto& [labels, counter] : family.counters) {
+			output << name << formatLabels(labels) << " " << counter->getValue() << "\n";
+		}
+		for (const auto& [labels, gauge] : family.gauges) {
+			output << name << formatLabels(labels) << " " << gauge->getValue() << "\n";
+		}
+		for (const auto& [labels, histogram] : family.histograms) {
+			const vector<double>& bounds = histogram->getBounds();
+			for (size_t i = 0; i <= bounds.size(); i++) {
+				double bound = i < bounds.size() ? bounds[i] : numeric_limits<double>::infinity();
+				output << name << "_bucket" << formatLabels(labels, "le=\"" + formatValue(bound) + "\"") << " " << histogram->getCumulativeCount(i) << "\n";
+			}
+			output << name << "_sum" << formatLabels(labels) << " " << formatValue(histogram->getSum()) << "\n";
+			output << name << "_count" << formatLabels(labels) << " " << histogram->getCount() << "\n";
+		}
+		for (const auto& [labels, callback] : family.callbacks) {
+			output << name << formatLabels(labels) << " " << formatValue(callback()) << "\n";
+		}
+	}
+	return output.str();
+}
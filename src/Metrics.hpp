@@ -0,0 +1,241 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include "Exceptions.hpp"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class Metrics
+ *
+ * @brief A registry of counters, gauges and histograms
+ *
+ * Metrics are registered once by name and labels and updated with atomic
+ * operations only, so instrumenting a hot path costs a few atomic increments.
+ * Hot paths should keep the reference returned on registration, for example
+ * in a function local static variable, instead of looking the metric up again.
+ *
+ * Values, that are already counted elsewhere, like the hits of the PdfCache,
+ * are registered as callbacks and read when the metrics are rendered.
+ *
+ * render returns all metrics in the Prometheus text exposition format.
+ * Labels are passed preformatted, like method="fetchResults".
+ */
+class Metrics {
+public:
+	class Counter {
+	private:
+		atomic<unsigned long long> value;
+
+	public:
+		Counter();
+
+		/** @brief Increases the counter
+        * @param [in] amount the amount added to the counter
+        */
+		void increment(unsigned long long amount = 1);
+
+		/** @brief Returns the value of the counter
+        * @return The sum of all increments
+        */
+		unsigned long long getValue() const;
+	};
+
+	class Gauge {
+	private:
+		atomic<long long> value;
+
+	public:
+		Gauge();
+
+		/** @brief Changes the gauge
+        * @param [in] amount the amount added to the gauge, may be negative
+        */
+		void add(long long amount);
+
+		/** @brief Sets the gauge
+        * @param [in] value the new value of the gauge
+        */
+		void set(long long value);
+
+		/** @brief Returns the value of the gauge
+        * @return The current value of the gauge
+        */
+		long long getValue() const;
+	};
+
+	class Histogram {
+	private:
+		const vector<double> bounds;
+		//The number of observations per bucket, the last one counts the values above all bounds
+		unique_ptr<atomic<unsigned long long>[]> buckets;
+		atomic<unsigned long long> count;
+		atomic<double> sum;
+
+	public:
+		/** @brief Constructor that creates a Histogram
+        * @param [in] bounds the ascending upper bounds of the buckets
+        * @return A pointer to the created Histogram
+        */
+		Histogram(const vector<double>& bounds);
+
+		/** @brief Records a value
+        * @param [in] value the observed value
+        */
+		void observe(double value);
+
+		/** @brief Returns the upper bounds of the buckets
+        * @return The upper bounds, without the implicit +Inf bucket
+        */
+		const vector<double>& getBounds() const;
+
+		/** @brief Returns the cumulative number of observations of a bucket
+        * @param [in] bucket the index of the bucket, getBounds().size() for the +Inf bucket
+        * @return The number of observations, that are less than or equal to the bound of the bucket
+        */
+		unsigned long long getCumulativeCount(size_t bucket) const;
+
+		/** @brief Returns the number of observations
+        * @return The number of observations
+        */
+		unsigned long long getCount() const;
+
+		/** @brief Returns the sum of the observations
+        * @return The sum of all observed values
+        */
+		double getSum() const;
+	};
+
+	/**
+	 * @brief Measures the lifetime of a scope in seconds
+	 *
+	 * The duration is observed by the histogram, when the timer is destroyed.
+	 * If the scope is left by an exception, the error counter is increased.
+	 */
+	class ScopedTimer {
+	private:
+		Histogram& histogram;
+		Counter* errors;
+		chrono::steady_clock::time_point start;
+		int exceptions;
+
+	public:
+		/** @brief Constructor that starts a ScopedTimer
+        * @param [in] histogram the histogram getting the duration
+        * @param [in] errors the counter increased if the scope is left by an exception, or nullptr
+        * @return A pointer to the created ScopedTimer
+        */
+		ScopedTimer(Histogram& histogram, Counter* errors = nullptr);
+
+		/** @brief Destructor that observes the duration
+        */
+		~ScopedTimer();
+	};
+
+	//The default buckets for durations in seconds
+	static const vector<double> durationBuckets;
+
+	//Buckets for the memory of processes in bytes
+	static const vector<double> memoryBuckets;
+
+private:
+	struct Family {
+		string type;
+		string help;
+		map<string, unique_ptr<Counter>> counters;
+		map<string, unique_ptr<Gauge>> gauges;
+		map<string, unique_ptr<Histogram>> histograms;
+		map<string, function<double()>> callbacks;
+	};
+
+	mutex metricsMutex;
+	map<string, Family> families;
+
+	/** @brief Returns the family of a metric, creating it if needed
+    * @param [in] name the name of the metric
+    * @param [in] type the Prometheus type of the metric
+    * @param [in] help the description of the metric
+    * @return A reference to the family
+    * @throw ConfigurationError if the name was registered with another type
+    *
+    * metricsMutex must be held by the caller.
+    */
+	Family& getFamily(const string& name, const string& type, const string& help);
+
+	/** @brief Formats a number for the text exposition format
+    * @param [in] value the number
+    * @return The number as string, +Inf for infinity
+    */
+	static string formatValue(double value);
+
+	/** @brief Combines labels
+    * @param [in] labels preformatted labels, may be empty
+    * @param [in] extraLabel a further preformatted label
+    * @return The labels in braces, empty if there are none
+    */
+	static string formatLabels(const string& labels, const string& extraLabel = "");
+
+public:
+	/** @brief Returns the process wide Metrics
+    * @return A reference to the process wide Metrics
+    */
+	static Metrics& get();
+
+	/** @brief Returns a counter, that is registered on the first call
+    * @param [in] name the name of the counter, should end with _total
+    * @param [in] help the description of the counter
+    * @param [in] labels preformatted labels, that distinguish counters with the same name
+    * @return A reference to the counter, that stays valid as long as the Metrics
+    * @throw ConfigurationError if the name was registered with another type
+    */
+	Counter& counter(const string& name, const string& help, const string& labels = "");
+
+	/** @brief Returns a gauge, that is registered on the first call
+    * @param [in] name the name of the gauge
+    * @param [in] help the description of the gauge
+    * @param [in] labels preformatted labels, that distinguish gauges with the same name
+    * @return A reference to the gauge, that stays valid as long as the Metrics
+    * @throw ConfigurationError if the name was registered with another type
+    */
+	Gauge& gauge(const string& name, const string& help, const string& labels = "");
+
+	/** @brief Returns a histogram, that is registered on the first call
+    * @param [in] name the name of the histogram
+    * @param [in] help the description of the histogram
+    * @param [in] labels preformatted labels, that distinguish histograms with the same name
+    * @param [in] bounds the upper bounds of the buckets, only used on the first call
+    * @return A reference to the histogram, that stays valid as long as the Metrics
+    * @throw ConfigurationError if the name was registered with another type
+    */
+	Histogram& histogram(const string& name, const string& help, const string& labels = "", const vector<double>& bounds = durationBuckets);
+
+	/** @brief Registers a metric, whose value is read when the metrics are rendered
+    * @param [in] name the name of the metric
+    * @param [in] type counter or gauge
+    * @param [in] help the description of the metric
+    * @param [in] value a function returning the current value
+    * @param [in] labels preformatted labels, that distinguish metrics with the same name
+    * @throw ConfigurationError if the name was registered with another type
+    *
+    * A callback, that is registered again, replaces the previous one.
+    */
+	void callback(const string& name, const string& type, const string& help, function<double()> value, const string& labels = "");
+
+	/** @brief Renders all metrics
+    * @return The metrics in the Prometheus text exposition format
+    */
+	string render();
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "MetricsEndpoint.hpp"
+
+MetricsEndpoint::MetricsEndpoint(Metrics& metrics, unsigned short port, const string& address)
+	: metrics(metrics)
+	, port(port)
+{
+	listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listenFd < 0) {
+		throw ConfigurationError(string("Failed to create metrics socket: ") + strerror(errno));
+	}
+	int reuse = 1;
+	setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	sockaddr_in socketAddress {};
+	socketAddress.sin_family = AF_INET;
+	socketAddress.sin_port = htons(port);
+	if (inet_pton(AF_INET, address.c_str(), &socketAddress.sin_addr) != 1
+		|| ::bind(listenFd, (sockaddr*)&socketAddress, sizeof(socketAddress)) != 0
+		|| listen(listenFd, 16) != 0) {
+		stringstream message;
+		message << "Failed to listen for metrics requests on " << address << ":" << port << ": " << strerror(errno);
+		close(listenFd);
+		throw ConfigurationError(message.str());
+	}
+	socklen_t addressLength = sizeof(socketAddress);
+	getsockname(listenFd, (sockaddr*)&socketAddress, &addressLength);
+	this->port = ntohs(socketAddress.sin_port);
+	serverThread = thread(&MetricsEndpoint::run, this);
+}
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+	//Shutting the socket down wakes up the thread waiting in accept
+	shutdown(listenFd, SHUT_RDWR);
+	serverThread.join();
+	close(listenFd);
+}
+
+unsigned short MetricsEndpoint::getPort() const
+{
+	return port;
+}
+
+void MetricsEndpoint::run()
+{
+	while (true) {
+		int connectionFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+		if (connectionFd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			return;
+		}
+		serve(connectionFd);
+		close(connectionFd);
+	}
+}
+
+void MetricsEndpoint::serve(int connectionFd)
+{
+	//A client, that does not send its request, must not block the endpoint
+	timeval timeout { METRICS_REQUEST_TIMEOUT_MS / 1000, (METRICS_REQUEST_TIMEOUT_MS % 1000) * 1000 };
+	setsockopt(connectionFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(connectionFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	//Only the request line is needed, the headers are read and ignored
+	string request;
+	char buffer[1024];
+	while (request.find("\r\n\r\n") == string::npos && request.size() < METRICS_MAX_REQUEST_SIZE) {
+		ssize_t received = recv(connectionFd, buffer, sizeof(buffer), 0);
+		if (received <= 0) {
+			break;
+		}
+		request.append(buffer, received);
+	}
+
+	string status = "200 OK";
+	string body;
+	if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET /metrics?", 0) == 0) {
+		body = metrics.render();
+	} else {
+		status = "404 Not Found";
+		body = "Metrics are served at /metrics\n";
+	}
+	stringstream response;
+	response << "HTTP/1.1 " << status << "\r\n"
+			 << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+			 << "Content-Length: " << body.size() << "\r\n"
+			 << "Connection: close\r\n\r\n"
+			 << body;
+	string responseData = response.str();
+	size_t sent = 0;
+	while (sent < responseData.size()) {
+		ssize_t written = send(connectionFd, responseData.data() + sent, responseData.size() - sent, MSG_NOSIGNAL);
+		if (written <= 0) {
+			spdlog::debug("Failed to send metrics: {}", strerror(errno));
+			return;
+		}
+		sent += written;
+	}
+}
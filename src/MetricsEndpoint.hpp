@@ -0,0 +1,70 @@
+#ifndef METRICS_ENDPOINT_HPP
+#define METRICS_ENDPOINT_HPP
+
+#include "Exceptions.hpp"
+#include "Metrics.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+
+#define METRICS_REQUEST_TIMEOUT_MS 1000
+#define METRICS_MAX_REQUEST_SIZE 8192
+
+using namespace std;
+
+/**
+ * @class MetricsEndpoint
+ *
+ * @brief A small HTTP server, that serves the rendered Metrics
+ *
+ * GET requests for /metrics are answered with Metrics::render in the
+ * Prometheus text exposition format, every other request gets a 404.
+ * The requests are served one at a time by a single thread, the endpoint
+ * is meant to be scraped by a local monitoring agent, not by clients.
+ */
+class MetricsEndpoint {
+private:
+	Metrics& metrics;
+	int listenFd;
+	unsigned short port;
+	thread serverThread;
+
+	/** @brief Accepts and answers connections, until the socket gets shut down
+    */
+	void run();
+
+	/** @brief Answers a single request
+    * @param [in] connectionFd the socket of the connection
+    */
+	void serve(int connectionFd);
+
+public:
+	/** @brief Constructor that starts a MetricsEndpoint
+    * @param [in] metrics the Metrics, that are served
+    * @param [in] port the port on which the endpoint listens, 0 for any free port
+    * @param [in] address the IPv4 address on which the endpoint listens
+    * @return A pointer to the created MetricsEndpoint
+    * @throw ConfigurationError if the socket can not be bound
+    */
+	MetricsEndpoint(Metrics& metrics, unsigned short port, const string& address = "127.0.0.1");
+
+	/** @brief Destructor that stops the endpoint
+    */
+	~MetricsEndpoint();
+
+	/** @brief Returns the port on which the endpoint listens
+    * @return The port of the endpoint
+    */
+	unsigned short getPort() const;
+};
+
+#endif
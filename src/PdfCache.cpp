@@ -0,0 +1,194 @@
+#include "PdfCache.hpp"
+
+PdfCache* PdfCache::singleton = nullptr;
+
+PdfCache::PdfCache(const filesystem::path& directory, unsigned long long maxSize)
+	: directory(directory)
+	, maxSize(maxSize)
+	, currentSize(0)
+	, hits(0)
+	, misses(0)
+{
+	//Load the pdfs of earlier runs, ordered by their last usage
+	vector<pair<filesystem::file_time_type, filesystem::directory_entry>> cachedFiles;
+	try {
+		filesystem::create_directories(directory);
+		for (const filesystem::directory_entry& file : filesystem::directory_iterator(directory)) {
+			if (file.is_regular_file() && file.path().extension() == ".pdf") {
+				cachedFiles.emplace_back(file.last_write_time(), file);
+			}
+		}
+	} catch (const filesystem::filesystem_error& error) {
+		stringstream message;
+		message << "Failed to read pdf cache directory " << directory.string() << ": " << error.what();
+		throw FileAccessError(message.str());
+	}
+	sort(cachedFiles.begin(), cachedFiles.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+	for (const auto& cachedFile : cachedFiles) {
+		string key = cachedFile.second.path().stem().string();
+		recentlyUsed.push_back(key);
+		unsigned long long size = cachedFile.second.file_size();
+		entries[key] = Entry { prev(recentlyUsed.end()), size, 0 };
+		currentSize += size;
+	}
+	evict();
+	spdlog::debug("Loaded {} cached pdfs with {} bytes from {}", entries.size(), currentSize, directory.string());
+}
+
+PdfCache* PdfCache::get()
+{
+	return singleton;
+}
+
+void PdfCache::setup(const filesystem::path& directory, unsigned long long maxSize)
+{
+	if (singleton == nullptr) {
+		singleton = new PdfCache(directory, maxSize);
+	} else {
+		throw ConfigurationError("Pdf cache already specified");
+	}
+}
+
+filesystem::path PdfCache::getPath(const string& key) const
+{
+	filesystem::path path(directory);
+	path.append(key + ".pdf");
+	return path;
+}
+
+void PdfCache::evict()
+{
+	auto usage = recentlyUsed.end();
+	while (currentSize > maxSize && usage != recentlyUsed.begin()) {
+		usage--;
+		auto entry = entries.find(*usage);
+		//The pdf is being retrieved
+		if (entry->second.pins > 0) {
+			continue;
+		}
+		string key = *usage;
+		currentSize -= entry->second.size;
+		entries.erase(entry);
+		usage = recentlyUsed.erase(usage);
+		error_code ignoreErrors;
+		filesystem::remove(getPath(key), ignoreErrors);
+		spdlog::trace("Evicted {} from pdf cache", key);
+	}
+}
+
+bool PdfCache::linkOrCopy(const filesystem::path& from, const filesystem::path& to)
+{
+	error_code error;
+	filesystem::remove(to, error);
+	filesystem::create_hard_link(from, to, error);
+	if (error) {
+		//Linking fails, if the files are on different filesystems
+		error.clear();
+		filesystem::copy_file(from, to, filesystem::copy_options::overwrite_existing, error);
+	}
+	return !error;
+}
+
+bool PdfCache::contains(const string& key)
+{
+	unique_lock<mutex> lock(cacheMutex);
+	return entries.count(key) != 0;
+}
+
+bool PdfCache::retrieve(const string& key, const filesystem::path& destination)
+{
+	unique_lock<mutex> lock(cacheMutex);
+	auto entry = entries.find(key);
+	if (entry == entries.end()) {
+		misses++;
+		return false;
+	}
+	//Mark as most recently used and keep it, until it is linked
+	recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, entry->second.usage);
+	entry->second.pins++;
+	lock.unlock();
+
+	//Link to a temporary name first, so the destination is never incomplete
+	stringstream temporaryName;
+	temporaryName << destination.filename().string() << ".tmp" << this_thread::get_id();
+	filesystem::path temporaryPath(destination);
+	temporaryPath.replace_filename(temporaryName.str());
+	error_code error;
+	bool retrieved = linkOrCopy(getPath(key), temporaryPath);
+	if (retrieved) {
+		filesystem::rename(temporaryPath, destination, error);
+		retrieved = !error;
+	}
+	if (retrieved) {
+		filesystem::last_write_time(getPath(key), filesystem::file_time_type::clock::now(), error);
+	} else {
+		filesystem::remove(temporaryPath, error);
+	}
+
+	lock.lock();
+	entries[key].pins--;
+	evict();
+	if (!retrieved) {
+		misses++;
+		return false;
+	}
+	hits++;
+	return true;
+}
+
+void PdfCache::store(const string& key, const filesystem::path& pdf)
+{
+	error_code error;
+	unsigned long long size = filesystem::file_size(pdf, error);
+	if (error) {
+		spdlog::warn("Failed to add {} to pdf cache: {}", pdf.string(), error.message());
+		return;
+	}
+
+	//Add under a temporary name first, so no incomplete pdf is ever retrieved
+	stringstream temporaryName;
+	temporaryName << key << ".tmp" << this_thread::get_id();
+	filesystem::path temporaryPath(directory);
+	temporaryPath.append(temporaryName.str());
+	if (!linkOrCopy(pdf, temporaryPath)) {
+		spdlog::warn("Failed to add {} to pdf cache", pdf.string());
+		filesystem::remove(temporaryPath, error);
+		return;
+	}
+
+	unique_lock<mutex> lock(cacheMutex);
+	filesystem::rename(temporaryPath, getPath(key), error);
+	if (error) {
+		spdlog::warn("Failed to add {} to pdf cache: {}", pdf.string(), error.message());
+		filesystem::remove(temporaryPath, error);
+		return;
+	}
+	//Retrievals of the replaced pdf still pin the key
+	unsigned int pins = 0;
+	auto entry = entries.find(key);
+	if (entry != entries.end()) {
+		currentSize -= entry->second.size;
+		recentlyUsed.erase(entry->second.usage);
+		pins = entry->second.pins;
+	}
+	recentlyUsed.push_front(key);
+	entries[key] = Entry { recentlyUsed.begin(), size, pins };
+	currentSize += size;
+	evict();
+}
+
+unsigned long long PdfCache::getHits() const
+{
+	return hits;
+}
+
+unsigned long long PdfCache::getMisses() const
+{
+	return misses;
+}
+
+unsigned long long PdfCache::getSize()
+{
+	unique_lock<mutex> lock(cacheMutex);
+	return currentSize;
+}
@@ -0,0 +1,147 @@
+#ifndef PDF_CACHE_HPP
+#define PDF_CACHE_HPP
+
+#include "Exceptions.hpp"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#define DEFAULT_CACHE_SIZE 1000000000
+
+using namespace std;
+
+/**
+ * @class PdfCache
+ *
+ * @brief A content addressed on disk cache for compiled pdfs
+ *
+ * The PdfCache stores compiled pdfs in a directory under the name KEY.pdf.
+ * The key is generated by the Certificate from everything that influences
+ * the compiled pdf, so a cached pdf can be used instead of running latex.
+ *
+ * If the size of all cached pdfs exceeds the size limit, the least recently
+ * used pdfs are removed. The order of usage is kept in the modification time
+ * of the files, so it survives restarts. Pdfs are only pinned while the lock
+ * is held, the files are linked or copied without it. Pinned pdfs are not
+ * removed.
+ *
+ * The cache is disabled, until setup is called.
+ */
+class PdfCache {
+private:
+	struct Entry {
+		list<string>::iterator usage;
+		unsigned long long size;
+		//The number of retrievals, that are reading the pdf
+		unsigned int pins;
+	};
+
+	static PdfCache* singleton;
+
+	filesystem::path directory;
+	unsigned long long maxSize;
+	unsigned long long currentSize;
+	mutex cacheMutex;
+	//Keys ordered from most recently to least recently used
+	list<string> recentlyUsed;
+	unordered_map<string, Entry> entries;
+	atomic<unsigned long long> hits;
+	atomic<unsigned long long> misses;
+
+	/** @brief Constructor that creates a PdfCache
+    * @param [in] directory the directory containing the cached pdfs
+    * @param [in] maxSize the maximum size of all cached pdfs in bytes
+    * @return A pointer to the created PdfCache
+    * @throw FileAccessError if the directory can not be created or read
+    *
+    * Pdfs that are already in the directory are added to the cache.
+    */
+	PdfCache(const filesystem::path& directory, unsigned long long maxSize);
+
+	/** @brief Returns the path of a cached pdf
+    * @param [in] key the key of the pdf
+    * @return The path of the pdf in the cache directory
+    */
+	filesystem::path getPath(const string& key) const;
+
+	/** @brief Removes least recently used pdfs, until the cache is small enough
+    *
+    * Pinned pdfs are skipped. The cacheMutex has to be locked by the caller.
+    */
+	void evict();
+
+	/** @brief Links or copies a file
+    * @param [in] from the existing file
+    * @param [in] to the new file, that gets replaced, if it exists
+    * @return Boolean that indicates whether the file was linked or copied
+    */
+	static bool linkOrCopy(const filesystem::path& from, const filesystem::path& to);
+
+public:
+	/** @brief Returns a pointer to the cache singleton object
+    * @return A pointer to the cache singleton object, nullptr if the cache is disabled
+    */
+	static PdfCache* get();
+
+	/** @brief Enables the cache
+    * @param [in] directory the directory containing the cached pdfs
+    * @param [in] maxSize the maximum size of all cached pdfs in bytes
+    * @throw ConfigurationError if the cache is already enabled
+    * @throw FileAccessError if the directory can not be created or read
+    */
+	static void setup(const filesystem::path& directory, unsigned long long maxSize = DEFAULT_CACHE_SIZE);
+
+	/** @brief Checks whether a pdf is cached
+    * @param [in] key the key of the pdf
+    * @return Boolean that indicates whether the pdf is cached
+    *
+    * Does not count as hit or miss and does not change the order of usage.
+    */
+	bool contains(const string& key);
+
+	/** @brief Puts a cached pdf at the given location
+    * @param [in] key the key of the pdf
+    * @param [in] destination the path where the pdf should be put
+    * @return Boolean that indicates whether the pdf was cached
+    *
+    * The pdf is hardlinked to the destination if possible, otherwise it is copied.
+    * It is linked or copied to a temporary file next to the destination first,
+    * which then replaces the destination.
+    */
+	bool retrieve(const string& key, const filesystem::path& destination);
+
+	/** @brief Adds a pdf to the cache
+    * @param [in] key the key of the pdf
+    * @param [in] pdf the path of the pdf, that gets added
+    *
+    * Errors while adding the pdf are logged and ignored, as the pdf was generated anyway.
+    */
+	void store(const string& key, const filesystem::path& pdf);
+
+	/** @brief Returns the number of retrieved pdfs, that were cached
+    * @return The number of cache hits
+    */
+	unsigned long long getHits() const;
+
+	/** @brief Returns the number of retrieved pdfs, that were not cached
+    * @return The number of cache misses
+    */
+	unsigned long long getMisses() const;
+
+	/** @brief Returns the size of all cached pdfs
+    * @return The size in bytes
+    */
+	unsigned long long getSize();
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include "ProcessLauncher.hpp"
+
+extern char** environ;
+
+atomic<unsigned long long> ProcessLauncher::launches(0);
+atomic<unsigned long long> ProcessLauncher::launchNanoseconds(0);
+
+ProcessLauncher::ProcessLauncher(const vector<string>& arguments, const filesystem::path& workingDirectory)
+	: arguments(arguments)
+	, workingDirectory(workingDirectory)
+	, cpuTimeLimit(RLIM_INFINITY)
+	, memoryLimit(RLIM_INFINITY)
+	, niceness(0)
+	, input(-1)
+	, output(-1)
+{
+	for (string& argument : this->arguments) {
+		argv.push_back(const_cast<char*>(argument.c_str()));
+	}
+	argv.push_back(nullptr);
+	for (char** variable = environ; *variable != nullptr; variable++) {
+		envp.push_back(*variable);
+	}
+	envp.push_back(nullptr);
+}
+
+void ProcessLauncher::setCpuTimeLimit(rlim_t seconds)
+{
+	cpuTimeLimit = seconds;
+}
+
+void ProcessLauncher::setMemoryLimit(rlim_t bytes)
+{
+	memoryLimit = bytes;
+}
+
+void ProcessLauncher::setNiceness(int increment)
+{
+	niceness = increment;
+}
+
+void ProcessLauncher::setCgroup(const filesystem::path& group)
+{
+	cgroup = group;
+}
+
+void ProcessLauncher::setInput(int descriptor)
+{
+	input = descriptor;
+}
+
+void ProcessLauncher::setOutput(int descriptor)
+{
+	output = descriptor;
+}
+
+int ProcessLauncher::spawn(pid_t& pid) const
+{
+	posix_spawn_file_actions_t fileActions;
+	posix_spawn_file_actions_init(&fileActions);
+	if (input >= 0) {
+		posix_spawn_file_actions_adddup2(&fileActions, input, STDIN_FILENO);
+	}
+	if (output >= 0) {
+		posix_spawn_file_actions_adddup2(&fileActions, output, STDOUT_FILENO);
+	} else {
+		posix_spawn_file_actions_addopen(&fileActions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+	}
+	posix_spawn_file_actions_addchdir_np(&fileActions, workingDirectory.c_str());
+	int error = posix_spawnp(&pid, argv[0], &fileActions, nullptr, argv.data(), envp.data());
+	posix_spawn_file_actions_destroy(&fileActions);
+	return error;
+}
+
+void ProcessLauncher::executeChild(int errorPipe, int priority) const
+{
+	if (input >= 0) {
+		dup2(input, STDIN_FILENO);
+	}
+	if (output >= 0) {
+		dup2(output, STDOUT_FILENO);
+	} else {
+		int discard = open("/dev/null", O_WRONLY);
+		if (discard >= 0) {
+			dup2(discard, STDOUT_FILENO);
+			close(discard);
+		}
+	}
+	if (cpuTimeLimit != RLIM_INFINITY) {
+		rlimit limit { cpuTimeLimit, cpuTimeLimit + 1 };
+		setrlimit(RLIMIT_CPU, &limit);
+	}
+	if (memoryLimit != RLIM_INFINITY) {
+		rlimit limit { memoryLimit, memoryLimit };
+		setrlimit(RLIMIT_AS, &limit);
+	}
+	if (niceness != 0) {
+		setpriority(PRIO_PROCESS, 0, priority);
+	}
+	if (chdir(workingDirectory.c_str()) == 0) {
+		execvpe(argv[0], argv.data(), envp.data());
+	}
+	int error = errno;
+	ssize_t ignored = write(errorPipe, &error, sizeof(error));
+	(void)ignored;
+	_exit(127);
+}
+
+int ProcessLauncher::spawnWithLimits(pid_t& pid) const
+{
+	int cgroupDirectory = -1;
+	if (!cgroup.empty()) {
+		cgroupDirectory = open(cgroup.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (cgroupDirectory < 0) {
+			return errno;
+		}
+	}
+	//A successful exec closes the pipe, otherwise the child writes its error to it
+	int errorPipe[2];
+	if (pipe2(errorPipe, O_CLOEXEC) != 0) {
+		int error = errno;
+		if (cgroupDirectory >= 0) {
+			close(cgroupDirectory);
+		}
+		return error;
+	}
+	//The niceness is relative to this process
+	int priority = niceness != 0 ? getpriority(PRIO_PROCESS, 0) + niceness : 0;
+
+	clone_args cloneArguments = {};
+	cloneArguments.flags = cgroupDirectory >= 0 ? CLONE_INTO_CGROUP : 0;
+	cloneArguments.exit_signal = SIGCHLD;
+	cloneArguments.cgroup = cgroupDirectory >= 0 ? cgroupDirectory : 0;
+	long result = syscall(SYS_clone3, &cloneArguments, sizeof(cloneArguments));
+	bool moveIntoCgroup = false;
+	if (result < 0 && (errno == ENOSYS || errno == E2BIG)) {
+		if (cgroupDirectory >= 0) {
+			static once_flag warning;
+			call_once(warning, []() { spdlog::warn("The kernel does not support CLONE_INTO_CGROUP, processes may fork before they are moved into their cgroup"); });
+			moveIntoCgroup = true;
+		}
+		result = fork();
+	}
+	if (result == 0) {
+		//The child is a copy of a multithreaded process, so it may only call async-signal-safe functions
+		executeChild(errorPipe[1], priority);
+	}
+	int error = result < 0 ? errno : 0;
+	if (cgroupDirectory >= 0) {
+		close(cgroupDirectory);
+	}
+	close(errorPipe[1]);
+	if (result > 0) {
+		pid = result;
+		if (moveIntoCgroup) {
+			ofstream processes(cgroup / "cgroup.procs");
+			processes << pid;
+			processes.flush();
+			if (!processes.good()) {
+				spdlog::warn("Failed to move {} into cgroup {}", arguments[0], cgroup.string());
+			}
+		}
+		int childError;
+		ssize_t bytes;
+		do {
+			bytes = read(errorPipe[0], &childError, sizeof(childError));
+		} while (bytes < 0 && errno == EINTR);
+		if (bytes == sizeof(childError)) {
+			waitpid(pid, nullptr, 0);
+			error = childError;
+		}
+	}
+	close(errorPipe[0]);
+	return error;
+}
+
+pid_t ProcessLauncher::launch() const
+{
+	if (arguments.empty()) {
+		throw LatexMissingError("Error while starting a process, no program specified");
+	}
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	pid_t pid;
+	bool limited = cpuTimeLimit != RLIM_INFINITY || memoryLimit != RLIM_INFINITY || niceness != 0 || !cgroup.empty();
+	int error = limited ? spawnWithLimits(pid) : spawn(pid);
+	if (error != 0) {
+		stringstream message;
+		message << "Error while starting " << arguments[0] << " in " << workingDirectory.string() << ": " << strerror(error);
+		if (error == ENOENT || error == EACCES || error == ENOEXEC || error == ENOTDIR) {
+			message << ", probably texlive is not installed or not in path";
+			throw LatexMissingError(message.str());
+		}
+		throw ForkFailedError(message.str());
+	}
+
+	launches++;
+	launchNanoseconds += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+	spdlog::trace("Launched {} with pid {}", arguments[0], pid);
+	return pid;
+}
+
+unsigned long long ProcessLauncher::getLaunches()
+{
+	return launches;
+}
+
+chrono::nanoseconds ProcessLauncher::getLaunchTime()
+{
+	return chrono::nanoseconds(launchNanoseconds);
+}
@@ -0,0 +1,150 @@
+#ifndef PROCESS_LAUNCHER_HPP
+#define PROCESS_LAUNCHER_HPP
+
+#include "Exceptions.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <linux/sched.h>
+#include <mutex>
+#include <signal.h>
+#include <spawn.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+using namespace std;
+
+/**
+ * @class ProcessLauncher
+ *
+ * @brief Starts compiler processes with posix_spawn
+ *
+ * The arguments and the environment of the process are converted, when the
+ * ProcessLauncher is created, so launching only spawns the process. The
+ * working directory and the redirection of stdout to /dev/null or to the
+ * given output are set by spawn file actions, nothing is executed in the
+ * child before exec.
+ * If the program can not be executed, posix_spawn reports the error to the
+ * parent, which throws an exception.
+ *
+ * If resource limits, niceness or a cgroup are set, the process is created
+ * with clone3 instead, because posix_spawn can not apply them. The child
+ * applies the limits and niceness with setrlimit and setpriority before it
+ * executes the program, so the program never runs without them. With a cgroup
+ * the process is created in the cgroup with CLONE_INTO_CGROUP, so neither it
+ * nor the processes it forks ever run outside of the cgroup. Besides that the
+ * child only opens /dev/null, changes the directory and executes the program,
+ * a failed exec is reported through a pipe.
+ *
+ * The number of launches and the time spent launching are counted process wide.
+ */
+class ProcessLauncher {
+private:
+	static atomic<unsigned long long> launches;
+	static atomic<unsigned long long> launchNanoseconds;
+
+	vector<string> arguments;
+	vector<char*> argv;
+	vector<char*> envp;
+	filesystem::path workingDirectory;
+	rlim_t cpuTimeLimit;
+	rlim_t memoryLimit;
+	int niceness;
+	filesystem::path cgroup;
+	int input;
+	int output;
+
+	/** @brief Starts the process with posix_spawn
+	* @param [out] pid the pid of the started process
+    * @return 0 if the process was started, the error number otherwise
+    */
+	int spawn(pid_t& pid) const;
+
+	/** @brief Starts the process with clone3, with its limits and in its cgroup
+	* @param [out] pid the pid of the started process
+    * @return 0 if the process was started, the error number otherwise
+    *
+    * Kernels without clone3 or CLONE_INTO_CGROUP fall back to fork, the process
+    * is then moved into the cgroup right after it was started.
+    */
+	int spawnWithLimits(pid_t& pid) const;
+
+	/** @brief Prepares the child and executes the program
+	* @param [in] errorPipe the pipe, that the error gets written to, if the program can not be executed
+	* @param [in] priority the priority of the process
+    *
+    * Runs in the child after clone3 or fork, so it only calls async-signal-safe functions.
+    */
+	[[noreturn]] void executeChild(int errorPipe, int priority) const;
+
+public:
+	/** @brief Constructor that creates a ProcessLauncher
+    * @param [in] arguments a vector of strings containing the program and its arguments
+    * @param [in] workingDirectory the directory where the program is executed
+    * @return A pointer to the created ProcessLauncher
+    *
+    * The program is searched in PATH, like execvp does. The process gets
+    * the environment of this process.
+    */
+	ProcessLauncher(const vector<string>& arguments, const filesystem::path& workingDirectory);
+
+	/** @brief Limits the cpu time of the process
+    * @param [in] seconds the cpu time after which the process gets SIGXCPU
+    */
+	void setCpuTimeLimit(rlim_t seconds);
+
+	/** @brief Limits the address space of the process
+    * @param [in] bytes the maximum size of the address space
+    */
+	void setMemoryLimit(rlim_t bytes);
+
+	/** @brief Increases the niceness of the process
+    * @param [in] increment the niceness added to the niceness of this process
+    */
+	void setNiceness(int increment);
+
+	/** @brief Starts the process in a cgroup
+    * @param [in] group a cgroup v2 directory
+    */
+	void setCgroup(const filesystem::path& group);
+
+	/** @brief Connects the standard input of the process to a file descriptor
+    * @param [in] descriptor the file descriptor, by default the process inherits the standard input
+    */
+	void setInput(int descriptor);
+
+	/** @brief Connects the standard output of the process to a file descriptor
+    * @param [in] descriptor the file descriptor, by default the output is discarded
+    */
+	void setOutput(int descriptor);
+
+	/** @brief Starts the process
+    * @return The pid of the started process, it has to be reaped by the caller
+    * @throw LatexMissingError if the program can not be executed
+    * @throw ForkFailedError if the process can not be created
+    */
+	pid_t launch() const;
+
+	/** @brief Returns the number of processes launched by all ProcessLaunchers
+    * @return The number of launched processes
+    */
+	static unsigned long long getLaunches();
+
+	/** @brief Returns the time spent in launch by all ProcessLaunchers
+    * @return The sum of the durations of all launches
+    */
+	static chrono::nanoseconds getLaunchTime();
+};
+
+#endif
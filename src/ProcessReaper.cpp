@@ -0,0 +1,220 @@
+#include "ProcessReaper.hpp"
+
+//Opens a pidfd for pid, returns -1 if pidfds are not supported
+static int openPidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return syscall(SYS_pidfd_open, pid, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+ProcessReaper::ProcessReaper()
+	: epollFd(epoll_create1(EPOLL_CLOEXEC))
+	, wakeupFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+	, stopping(false)
+{
+	if (epollFd < 0 || wakeupFd < 0) {
+		spdlog::warn("Failed to create epoll set for the process reaper, falling back to polling");
+		return;
+	}
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.fd = wakeupFd;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupFd, &event);
+	reaperThread = thread(&ProcessReaper::run, this);
+}
+
+ProcessReaper::~ProcessReaper()
+{
+	unique_lock<mutex> lock(reaperMutex);
+	stopping = true;
+	lock.unlock();
+	if (reaperThread.joinable()) {
+		wakeup();
+		reaperThread.join();
+	}
+	if (epollFd >= 0) {
+		close(epollFd);
+	}
+	if (wakeupFd >= 0) {
+		close(wakeupFd);
+	}
+}
+
+ProcessReaper& ProcessReaper::get()
+{
+	static ProcessReaper reaper;
+	return reaper;
+}
+
+int ProcessReaper::waitForExit(pid_t childPid, const atomic_bool& killswitch, chrono::milliseconds timeout, rusage* usage)
+{
+	if (!reaperThread.joinable()) {
+		return pollForExit(childPid, killswitch, timeout, usage);
+	}
+	int pidfd = openPidfd(childPid);
+	if (pidfd < 0) {
+		return pollForExit(childPid, killswitch, timeout, usage);
+	}
+
+	shared_ptr<WatchedProcess> process = make_shared<WatchedProcess>();
+	process->pid = childPid;
+	process->pidfd = pidfd;
+	process->killswitch = &killswitch;
+	process->terminateAt = chrono::steady_clock::now() + timeout;
+	process->terminateSent = false;
+	process->killSent = false;
+	process->usage = {};
+	future<int> exitStatus = process->exitStatus.get_future();
+
+	unique_lock<mutex> lock(reaperMutex);
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.fd = pidfd;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, pidfd, &event) != 0) {
+		lock.unlock();
+		close(pidfd);
+		return pollForExit(childPid, killswitch, timeout, usage);
+	}
+	processes[pidfd] = process;
+	lock.unlock();
+
+	//Let the reaper consider the deadline and killswitch of the new process
+	wakeup();
+	int status = exitStatus.get();
+	//The usage is set before the exit status, so it is complete here
+	if (usage != nullptr) {
+		*usage = process->usage;
+	}
+	return status;
+}
+
+void ProcessReaper::notifyKillswitch()
+{
+	if (reaperThread.joinable()) {
+		wakeup();
+	}
+}
+
+void ProcessReaper::wakeup()
+{
+	uint64_t one = 1;
+	if (write(wakeupFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+		spdlog::error("Failed to wake up the process reaper");
+	}
+}
+
+void ProcessReaper::run()
+{
+	epoll_event events[16];
+	unique_lock<mutex> lock(reaperMutex);
+	while (!stopping) {
+		int timeout = signalProcesses();
+		lock.unlock();
+		int count = epoll_wait(epollFd, events, 16, timeout);
+		lock.lock();
+		for (int i = 0; i < count; i++) {
+			if (events[i].data.fd == wakeupFd) {
+				uint64_t value;
+				while (read(wakeupFd, &value, sizeof(value)) > 0) {
+				}
+			} else {
+				reapProcess(events[i].data.fd);
+			}
+		}
+	}
+}
+
+int ProcessReaper::signalProcesses()
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	int nextDeadline = -1;
+	for (auto& entry : processes) {
+		WatchedProcess& process = *entry.second;
+		if (*process.killswitch && !process.killSent) {
+			kill(process.pid, SIGKILL);
+			process.killSent = true;
+		}
+		if (!process.terminateSent && process.terminateAt <= now) {
+			kill(process.pid, SIGTERM);
+			process.terminateSent = true;
+		}
+		if (process.terminateSent && !process.killSent && process.terminateAt + 2s <= now) {
+			kill(process.pid, SIGKILL);
+			process.killSent = true;
+		}
+
+		//Calculate when this process needs attention again
+		if (process.killSent) {
+			continue;
+		}
+		chrono::steady_clock::time_point deadline = process.terminateSent ? process.terminateAt + 2s : process.terminateAt;
+		int remaining = chrono::ceil<chrono::milliseconds>(deadline - now).count();
+		if (remaining < 0) {
+			remaining = 0;
+		}
+		if (nextDeadline < 0 || remaining < nextDeadline) {
+			nextDeadline = remaining;
+		}
+	}
+	return nextDeadline;
+}
+
+void ProcessReaper::reapProcess(int pidfd)
+{
+	auto entry = processes.find(pidfd);
+	if (entry == processes.end()) {
+		return;
+	}
+	shared_ptr<WatchedProcess> process = entry->second;
+	int status;
+	pid_t result = wait4(process->pid, &status, WNOHANG, &process->usage);
+	if (result == 0) {
+		//Not exited yet, keep watching
+		return;
+	}
+
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, pidfd, nullptr);
+	close(pidfd);
+	processes.erase(entry);
+	if (result < 0) {
+		process->exitStatus.set_exception(make_exception_ptr(LatexExecutionError("Error while waiting for latex")));
+	} else {
+		process->exitStatus.set_value(status);
+	}
+}
+
+int ProcessReaper::pollForExit(pid_t childPid, const atomic_bool& killswitch, chrono::milliseconds timeout, rusage* usage)
+{
+	int status;
+	int result = 0;
+	rusage childUsage = {};
+	chrono::steady_clock::time_point terminateAt = chrono::steady_clock::now() + timeout;
+	result = wait4(childPid, &status, WNOHANG, &childUsage);
+	while (result == 0) {
+		this_thread::sleep_for(10ms);
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		if (terminateAt + 2s < now) {
+			kill(childPid, SIGKILL);
+		} else if (terminateAt < now) {
+			kill(childPid, SIGTERM);
+		}
+		if (killswitch) {
+			kill(childPid, SIGKILL);
+		}
+		result = wait4(childPid, &status, WNOHANG, &childUsage);
+	}
+
+	//Error while waiting for child
+	if (result < 0) {
+		throw LatexExecutionError("Error while waiting for latex");
+	}
+
+	if (usage != nullptr) {
+		*usage = childUsage;
+	}
+	return status;
+}
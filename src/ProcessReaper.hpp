@@ -0,0 +1,143 @@
+#ifndef PROCESS_REAPER_HPP
+#define PROCESS_REAPER_HPP
+
+#include "Exceptions.hpp"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <wait.h>
+
+#include "spdlog/spdlog.h"
+
+using namespace std;
+
+/**
+ * @class ProcessReaper
+ *
+ * @brief Waits for child processes without polling
+ *
+ * The ProcessReaper owns a single thread, that waits for the exit of all
+ * watched child processes at once. Every child is watched through a pidfd
+ * in an epoll set, so a thread waiting in waitForExit is woken up as soon
+ * as its child exits.
+ *
+ * Timeouts are enforced by the timeout of epoll_wait, that is set to the
+ * next pending deadline. A killswitch is checked whenever notifyKillswitch
+ * gets called.
+ *
+ * If the kernel does not support pidfds, waitForExit falls back to
+ * polling the child every 10ms.
+ */
+class ProcessReaper {
+private:
+	struct WatchedProcess {
+		pid_t pid;
+		int pidfd;
+		const atomic_bool* killswitch;
+		chrono::steady_clock::time_point terminateAt;
+		bool terminateSent;
+		bool killSent;
+		rusage usage;
+		promise<int> exitStatus;
+	};
+
+	mutex reaperMutex;
+	map<int, shared_ptr<WatchedProcess>> processes;
+	int epollFd;
+	int wakeupFd;
+	bool stopping;
+	thread reaperThread;
+
+	/** @brief The main loop of the reaper thread
+    *
+    * Waits for watched processes to exit, reaps them and sends
+    * signals to processes, whose timeout expired or whose killswitch is set.
+    */
+	void run();
+
+	/** @brief Sends signals to processes with expired timeout or set killswitch
+    * @return The time until the next deadline in ms, or -1 if there is none
+    *
+    * A process whose timeout expired gets send SIGTERM. If it does not
+    * terminate within 2 seconds it gets send SIGKILL. A process whose
+    * killswitch is set gets send SIGKILL.
+    * reaperMutex must be held by the caller.
+    */
+	int signalProcesses();
+
+	/** @brief Reaps a process that exited
+    * @param [in] pidfd the pidfd of the process that exited
+    *
+    * Collects the exit status of the process and passes it to the waiting thread.
+    * reaperMutex must be held by the caller.
+    */
+	void reapProcess(int pidfd);
+
+	/** @brief Wakes up the reaper thread
+    *
+    * Interrupts epoll_wait, so the reaper reevaluates deadlines and killswitches.
+    */
+	void wakeup();
+
+	/** @brief Waits for the process by polling
+    * @param [in] childPid a pid_t of the process to be waited for
+    * @param [in] killswitch a atomic_bool triggering the sending of a kill signal to the child
+    * @param [in] timeout the time after which the process gets terminated
+    * @param [out] usage the resource usage of the process, if it is not nullptr
+    * @return A int containing the exit status of the process
+    *
+    * Fallback for kernels without pidfd support, checks the child every 10ms.
+    */
+	int pollForExit(pid_t childPid, const atomic_bool& killswitch, chrono::milliseconds timeout, rusage* usage);
+
+public:
+	/** @brief Constructor that creates a ProcessReaper
+    * @return A pointer to the created ProcessReaper
+    *
+    * Creates the epoll set and starts the reaper thread.
+    */
+	ProcessReaper();
+
+	/** @brief Destructor that stops the reaper thread
+    */
+	~ProcessReaper();
+
+	/** @brief Returns the process wide ProcessReaper
+    * @return A reference to the process wide ProcessReaper
+    */
+	static ProcessReaper& get();
+
+	/** @brief Waits for a child process to exit
+    * @param [in] childPid a pid_t of the process to be waited for
+    * @param [in] killswitch a atomic_bool triggering the sending of a kill signal to the child
+    * @param [in] timeout the time after which the process gets terminated
+    * @param [out] usage the resource usage of the process, as returned by wait4, if it is not nullptr
+    * @return A int containing the exit status of the process, as returned by waitpid
+    * @throw LatexExecutionError if waiting for the child failed
+    *
+    * Blocks until the process with childPid exited.
+    * If timeout is exceeded, the process gets send SIGTERM, if it does not
+    * terminate within 2 seconds it gets send SIGKILL. If killswitch is set
+    * and notifyKillswitch is called, the process gets send SIGKILL.
+    */
+	int waitForExit(pid_t childPid, const atomic_bool& killswitch, chrono::milliseconds timeout, rusage* usage = nullptr);
+
+	/** @brief Tells the reaper that a killswitch was set
+    *
+    * Must be called after setting a killswitch, that was passed to waitForExit,
+    * so the processes belonging to it are killed without delay.
+    */
+	void notifyKillswitch();
+};
+
+#endif
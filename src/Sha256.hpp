@@ -0,0 +1,76 @@
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include "Exceptions.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+/**
+ * @class Sha256
+ *
+ * @brief Calculates SHA-256 hashes
+ *
+ * Calculates SHA-256 hashes of strings and files.
+ * The hashes are stable across runs, so they can be used to name cached files.
+ * Data can be added in multiple steps with update.
+ */
+class Sha256 {
+
+private:
+	uint32_t state[8];
+	unsigned char buffer[64];
+	size_t bufferLength;
+	uint64_t totalLength;
+
+	/** @brief Processes one 64 byte block
+    * @param [in] block a pointer to 64 bytes of data
+    */
+	void transform(const unsigned char* block);
+
+public:
+	/** @brief Constructor that creates a Sha256
+    * @return A pointer to the created Sha256
+    *
+    * Creates a Sha256 with no data added yet.
+    */
+	Sha256();
+
+	/** @brief Adds data to the hash
+    * @param [in] data a pointer to the data
+    * @param [in] length the length of the data in bytes
+    */
+	void update(const void* data, size_t length);
+
+	/** @brief Adds a string to the hash
+    * @param [in] data the string to be added
+    */
+	void update(const string& data);
+
+	/** @brief Finishes the calculation and returns the hash
+    * @return A string containing the hash as 64 lowercase hex digits
+    *
+    * After calling this, no more data may be added.
+    */
+	string hexDigest();
+
+	/** @brief Returns the hash of a string
+    * @param [in] data the string to be hashed
+    * @return A string containing the hash as 64 lowercase hex digits
+    */
+	static string hash(const string& data);
+
+	/** @brief Returns the hash of the content of a file
+    * @param [in] file the path of the file to be hashed
+    * @return A string containing the hash as 64 lowercase hex digits
+    * @throw FileAccessError if the file can not be read
+    */
+	static string hashFile(const filesystem::path& file);
+};
+
+#endif
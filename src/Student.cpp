@@ -1,11 +1,28 @@
 #include "Student.hpp"
 
 Student::Student(json properties)
-	: properties(properties)
+	: properties(move(properties))
 {
 }
 
-json Student::getProperties() const
+const json& Student::getProperties() const
 {
 	return properties;
 }
+
+const string* Student::getStringProperty(const string& name) const
+{
+	return findStringProperty(properties, name);
+}
+
+const string* Student::findStringProperty(const json& properties, const string& name)
+{
+	if (!properties.is_object()) {
+		return nullptr;
+	}
+	auto property = properties.find(name);
+	if (property == properties.end() || !property->is_string()) {
+		return nullptr;
+	}
+	return &property->get_ref<const string&>();
+}
@@ -30,9 +30,24 @@ public:
 	Student(json properties);
 
 	/** @brief Returns the properties of this Student
-    * @return A json containing the properties of this Student
+    * @return A reference to the json containing the properties of this Student
     */
-	json getProperties() const;
+	const json& getProperties() const;
+
+	/** @brief Returns a property of this Student, if it is a string
+    * @param [in] name the name of the property
+    * @return A pointer to the value of the property, nullptr if there is no string property with that name
+    */
+	const string* getStringProperty(const string& name) const;
+
+	/** @brief Returns a property of a json object, if it is a string
+    * @param [in] properties a json, that should be an object
+    * @param [in] name the name of the property
+    * @return A pointer to the value of the property, nullptr if there is no string property with that name
+    *
+    * The value is not copied, the pointer is valid as long as properties is not changed.
+    */
+	static const string* findStringProperty(const json& properties, const string& name);
 };
 
 #endif
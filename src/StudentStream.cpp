@@ -0,0 +1,381 @@
+#include "StudentStream.hpp"
+
+/**
+ * SAX handler, that builds the configuration without the students array
+ * and passes each element of the students array to a callback.
+ *
+ * Only the configuration and the current student are kept in memory.
+ */
+class StudentStream::Parser : public nlohmann::json_sax<json> {
+private:
+	json* configuration;
+	const function<bool(const Student&)>* studentCallback;
+	json student;
+	//The open arrays and objects, nullptr for the ones that are skipped
+	vector<json*> containers;
+	//The value of the last key in the innermost object
+	json* objectValue;
+	//Whether the last key of the configuration was students
+	bool studentsKey;
+	bool inStudents;
+	//Whether the parser stopped at the students, because they are not needed
+	bool studentsReached;
+
+	//Adds a value to the innermost container, returns nullptr if it is skipped
+	json* addValue(json&& value)
+	{
+		if (containers.empty()) {
+			throw InvalidConfigurationError("The batch configuration has to be a json object");
+		}
+		if (containers.size() == 1 && studentsKey) {
+			if (!value.is_null()) {
+				throw InvalidConfigurationError("The students of the batch configuration have to be an array");
+			}
+			return nullptr;
+		}
+		if (inStudents && containers.size() == 2) {
+			throw InvalidConfigurationError("The students of the batch configuration have to be objects");
+		}
+		json* container = containers.back();
+		if (container == nullptr) {
+			return nullptr;
+		}
+		if (container->is_array()) {
+			container->push_back(move(value));
+			return &container->back();
+		}
+		*objectValue = move(value);
+		return objectValue;
+	}
+
+public:
+	Parser(json* configuration, const function<bool(const Student&)>* studentCallback)
+		: configuration(configuration)
+		, studentCallback(studentCallback)
+		, objectValue(nullptr)
+		, studentsKey(false)
+		, inStudents(false)
+		, studentsReached(false)
+	{
+	}
+
+	bool reachedStudents() const
+	{
+		return studentsReached;
+	}
+
+	bool null() override
+	{
+		addValue(nullptr);
+		return true;
+	}
+
+	bool boolean(bool value) override
+	{
+		addValue(value);
+		return true;
+	}
+
+	bool number_integer(number_integer_t value) override
+	{
+		addValue(value);
+		return true;
+	}
+
+	bool number_unsigned(number_unsigned_t value) override
+	{
+		addValue(value);
+		return true;
+	}
+
+	bool number_float(number_float_t value, const string_t&) override
+	{
+		addValue(value);
+		return true;
+	}
+
+	bool string(string_t& value) override
+	{
+		addValue(move(value));
+		return true;
+	}
+
+	bool start_object(size_t) override
+	{
+		if (containers.empty()) {
+			if (configuration != nullptr) {
+				*configuration = json::object();
+			}
+			containers.push_back(configuration);
+		} else if (inStudents && containers.size() == 2) {
+			//A new student
+			student = json::object();
+			containers.push_back(studentCallback != nullptr ? &student : nullptr);
+		} else {
+			containers.push_back(addValue(json::object()));
+		}
+		return true;
+	}
+
+	bool key(string_t& key) override
+	{
+		if (containers.size() == 1) {
+			studentsKey = key == "students";
+			if (studentsKey && studentCallback == nullptr) {
+				studentsReached = true;
+				return false;
+			}
+		}
+		json* container = containers.back();
+		if (container == nullptr || (containers.size() == 1 && studentsKey)) {
+			objectValue = nullptr;
+		} else {
+			objectValue = &(*container)[key];
+		}
+		return true;
+	}
+
+	bool end_object() override
+	{
+		containers.pop_back();
+		if (inStudents && containers.size() == 2 && studentCallback != nullptr) {
+			Student finishedStudent(move(student));
+			//Returning false stops the parser
+			return (*studentCallback)(finishedStudent);
+		}
+		return true;
+	}
+
+	bool start_array(size_t) override
+	{
+		if (containers.size() == 1 && studentsKey) {
+			inStudents = true;
+			containers.push_back(nullptr);
+		} else {
+			containers.push_back(addValue(json::array()));
+		}
+		return true;
+	}
+
+	bool end_array() override
+	{
+		containers.pop_back();
+		if (containers.size() == 1) {
+			inStudents = false;
+		}
+		return true;
+	}
+
+	bool parse_error(size_t, const std::string&, const nlohmann::detail::exception& error) override
+	{
+		stringstream message;
+		message << "Invalid json in batch configuration: " << error.what();
+		throw InvalidConfigurationError(message.str());
+	}
+};
+
+StudentStream::StudentStream()
+	: students(make_shared<vector<Student>>())
+{
+}
+
+StudentStream::StudentStream(vector<Student> students)
+	: students(make_shared<vector<Student>>(move(students)))
+{
+}
+
+StudentStream::StudentStream(json students)
+{
+	if (!students.is_null() && !students.is_array()) {
+		throw InvalidConfigurationError("The students of the batch configuration have to be an array");
+	}
+	vector<Student> loadedStudents;
+	if (students.is_array()) {
+		loadedStudents.reserve(students.size());
+		for (json& student : students) {
+			if (!student.is_object()) {
+				throw InvalidConfigurationError("The students of the batch configuration have to be objects");
+			}
+			loadedStudents.emplace_back(move(student));
+		}
+	}
+	this->students = make_shared<vector<Student>>(move(loadedStudents));
+}
+
+StudentStream StudentStream::fromFile(const filesystem::path& file)
+{
+	StudentStream stream;
+	stream.students = nullptr;
+	stream.openConfiguration = [file]() -> unique_ptr<istream> {
+		unique_ptr<ifstream> input = make_unique<ifstream>(file, ios::in);
+		if (!*input) {
+			stringstream message;
+			message << "Error reading batch configuration " << file.string();
+			throw FileAccessError(message.str());
+		}
+		return input;
+	};
+	return stream;
+}
+
+StudentStream StudentStream::fromString(const string& configuration)
+{
+	StudentStream stream;
+	stream.students = nullptr;
+	shared_ptr<const string> content = make_shared<const string>(configuration);
+	stream.openConfiguration = [content]() -> unique_ptr<istream> {
+		return make_unique<istringstream>(*content);
+	};
+	return stream;
+}
+
+/**
+ * Stream buffer, that reads one character before the rest of another stream buffer.
+ * It continues parsing an object after the students were skipped, as a new object.
+ */
+class StudentStream::PrefixedBuffer : public streambuf {
+private:
+	char current;
+	streambuf* rest;
+
+public:
+	PrefixedBuffer(char prefix, streambuf* rest)
+		: current(prefix)
+		, rest(rest)
+	{
+		setg(&current, &current, &current + 1);
+	}
+
+protected:
+	int_type underflow() override
+	{
+		int_type character = rest->sbumpc();
+		if (traits_type::eq_int_type(character, traits_type::eof())) {
+			return character;
+		}
+		current = traits_type::to_char_type(character);
+		setg(&current, &current, &current + 1);
+		return character;
+	}
+};
+
+void StudentStream::skipStudents(istream& input)
+{
+	input >> ws;
+	if (input.get() != ':') {
+		throw InvalidConfigurationError("Invalid json in batch configuration: expected ':' after \"students\"");
+	}
+	input >> ws;
+	if (input.peek() == 'n') {
+		char value[4] = {};
+		input.read(value, 4);
+		if (string(value, input.gcount()) != "null") {
+			throw InvalidConfigurationError("The students of the batch configuration have to be an array");
+		}
+		return;
+	}
+	if (input.peek() != '[') {
+		throw InvalidConfigurationError("The students of the batch configuration have to be an array");
+	}
+	//Only brackets outside of strings are counted, the values are not parsed
+	size_t depth = 0;
+	bool inString = false;
+	for (int character = input.get(); character != EOF; character = input.get()) {
+		if (inString) {
+			if (character == '\\') {
+				input.get();
+			} else if (character == '"') {
+				inString = false;
+			}
+		} else if (character == '"') {
+			inString = true;
+		} else if (character == '[' || character == '{') {
+			depth++;
+		} else if ((character == ']' || character == '}') && --depth == 0) {
+			return;
+		}
+	}
+	throw InvalidConfigurationError("Invalid json in batch configuration: the students array is not closed");
+}
+
+void StudentStream::parse(json* configuration, const function<bool(const Student&)>* studentCallback) const
+{
+	unique_ptr<istream> input = openConfiguration();
+
+	//Only the first json value is parsed, in json lines it is followed by the students
+	Parser parser(configuration, studentCallback);
+	bool finished = json::sax_parse(*input, &parser, json::input_format_t::json, false);
+	if (studentCallback == nullptr) {
+		if (!parser.reachedStudents()) {
+			return;
+		}
+		//The keys after the students are parsed as an object of their own
+		skipStudents(*input);
+		*input >> ws;
+		int next = input->get();
+		if (next == '}') {
+			return;
+		}
+		if (next != ',') {
+			throw InvalidConfigurationError("Invalid json in batch configuration: expected ',' or '}' after the students");
+		}
+		PrefixedBuffer remainingBuffer('{', input->rdbuf());
+		istream remainingInput(&remainingBuffer);
+		json remainingConfiguration;
+		Parser remainingParser(&remainingConfiguration, nullptr);
+		json::sax_parse(remainingInput, &remainingParser, json::input_format_t::json, false);
+		if (remainingParser.reachedStudents()) {
+			throw InvalidConfigurationError("The batch configuration contains the students twice");
+		}
+		configuration->update(remainingConfiguration);
+		return;
+	}
+	//The callback stopped the iteration
+	if (!finished) {
+		return;
+	}
+
+	string line;
+	while (getline(*input, line)) {
+		if (line.find_first_not_of(" \t\r") == string::npos) {
+			continue;
+		}
+		json properties;
+		try {
+			properties = json::parse(line);
+		} catch (const nlohmann::detail::parse_error& error) {
+			stringstream message;
+			message << "Invalid json in student of batch configuration: " << error.what();
+			throw InvalidConfigurationError(message.str());
+		}
+		if (!properties.is_object()) {
+			throw InvalidConfigurationError("The students of the batch configuration have to be objects");
+		}
+		Student student(move(properties));
+		if (!(*studentCallback)(student)) {
+			return;
+		}
+	}
+}
+
+json StudentStream::readConfiguration() const
+{
+	json configuration = json::object();
+	if (openConfiguration) {
+		parse(&configuration, nullptr);
+	}
+	return configuration;
+}
+
+void StudentStream::forEachStudent(const function<bool(const Student&)>& studentCallback) const
+{
+	if (!openConfiguration) {
+		for (const Student& student : *students) {
+			if (!studentCallback(student)) {
+				return;
+			}
+		}
+		return;
+	}
+	parse(nullptr, &studentCallback);
+}
@@ -0,0 +1,114 @@
+#ifndef STUDENT_STREAM_HPP
+#define STUDENT_STREAM_HPP
+
+#include "Exceptions.hpp"
+#include "Student.hpp"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+using namespace std;
+
+/**
+ * @class StudentStream
+ *
+ * @brief The students of a batch, that are read one at a time
+ *
+ * A batch configuration is either a json object with a students array,
+ * or json lines: The first line contains the configuration as a json object,
+ * every following line contains one student.
+ *
+ * The configuration is read without the students. The students are parsed
+ * with a SAX parser every time they are iterated, so only one student is in
+ * memory at a time, regardless of the size of the batch.
+ *
+ * A StudentStream can also contain students, that are already in memory.
+ * Copies of a StudentStream share their students.
+ */
+class StudentStream {
+private:
+	class Parser;
+	class PrefixedBuffer;
+
+	//Opens the batch configuration, empty if the students are in memory
+	function<unique_ptr<istream>()> openConfiguration;
+	shared_ptr<const vector<Student>> students;
+
+	/** @brief Skips the students array of a json batch configuration without parsing it
+    * @param [in,out] input the batch configuration, positioned after the students key
+    * @throw InvalidConfigurationError if the students are not an array or null
+    */
+	static void skipStudents(istream& input);
+
+	/** @brief Reads the batch configuration
+    * @param [out] configuration the configuration without the students, nullptr if it is not needed
+    * @param [in] studentCallback a function that is called for every student until it returns false, nullptr if the students are not needed
+    * @throw FileAccessError if the batch configuration can not be opened
+    * @throw InvalidConfigurationError if the batch configuration is invalid
+    *
+    * The first json value is parsed with a SAX parser straight from the input.
+    * If anything follows it, the input is json lines with a student in every
+    * following line. Without a callback, parsing stops at the students, they
+    * are skipped by only matching their brackets.
+    */
+	void parse(json* configuration, const function<bool(const Student&)>* studentCallback) const;
+
+public:
+	/** @brief Constructor that creates a StudentStream without students
+    * @return A pointer to the created StudentStream
+    */
+	StudentStream();
+
+	/** @brief Constructor that creates a StudentStream from students in memory
+    * @param [in] students is a vector of Student
+    * @return A pointer to the created StudentStream
+    */
+	StudentStream(vector<Student> students);
+
+	/** @brief Constructor that creates a StudentStream from a json array in memory
+    * @param [in] students is a json array containing the properties of the students, or null
+    * @return A pointer to the created StudentStream
+    * @throw InvalidConfigurationError if students is not an array of objects
+    */
+	StudentStream(json students);
+
+	/** @brief Creates a StudentStream that reads a batch configuration file
+    * @param [in] file the path of a json or json lines batch configuration
+    * @return The created StudentStream
+    *
+    * The file is read again every time the students are iterated.
+    */
+	static StudentStream fromFile(const filesystem::path& file);
+
+	/** @brief Creates a StudentStream that reads a batch configuration string
+    * @param [in] configuration a string containing a json or json lines batch configuration
+    * @return The created StudentStream
+    */
+	static StudentStream fromString(const string& configuration);
+
+	/** @brief Reads the batch configuration without the students
+    * @return A json object containing the configuration
+    * @throw FileAccessError if the batch configuration can not be opened
+    * @throw InvalidConfigurationError if the batch configuration is invalid
+    */
+	json readConfiguration() const;
+
+	/** @brief Calls a function for every student, until it returns false
+    * @param [in] studentCallback a function getting a Student, that is only valid during the call, returning whether the next student should be read
+    * @throw FileAccessError if the batch configuration can not be opened
+    * @throw InvalidConfigurationError if the batch configuration is invalid
+    *
+    * The remaining students are not parsed, once the function returned false.
+    * Exceptions thrown by the function stop the iteration and are passed on.
+    */
+	void forEachStudent(const function<bool(const Student&)>& studentCallback) const;
+};
+
+#endif
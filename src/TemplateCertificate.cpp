@@ -1,135 +1,335 @@
 #include "TemplateCertificate.hpp"
 
-TemplateCertificate::TemplateCertificate(const string& basename, const string& templateContent, json& globalProperties)
+TemplateCertificate::TemplateCertificate(const string& basename, const string& templateContent, const json& globalProperties)
+	: TemplateCertificate(basename, templateContent, make_shared<const json>(globalProperties))
+{
+}
+
+TemplateCertificate::TemplateCertificate(const string& basename, const string& templateContent, shared_ptr<const json> globalProperties)
 	: globalProperties(globalProperties)
 	, templateContent(templateContent)
+	, renderedSize(0)
 	, basename(basename)
 	, generatedCertificateCounter(0)
+	, generatedCombinedCertificateCounter(0)
+	, formatEnabled(false)
 {
+	removeDummyPackage(this->templateContent);
+	compiledTemplate = compileTemplate(0, this->templateContent.size());
+	formatPreamble = findStaticPreamble(this->templateContent);
+	if (!formatPreamble.empty()) {
+		formatName = "format_" + Sha256::hash(formatPreamble).substr(0, 16);
+	}
 }
 
-bool TemplateCertificate::checkStudent(const Student& student) const
+void TemplateCertificate::removeDummyPackage(string& content) const
 {
-	return true;
+	long unsigned int useDummyPackage = content.find("\\usepackage{certificate-generator}");
+	if (useDummyPackage != string::npos) {
+		content.replace(useDummyPackage, 34, "");
+	}
 }
 
-const Certificate TemplateCertificate::generateCertificate(const Student& student)
+string TemplateCertificate::findStaticPreamble(const string& content) const
 {
-	generatedCertificateCounter++;
-	string result = templateContent;
-
-	//replace use dummy package
-	long unsigned int useDummyPackage = result.find("\\usepackage{certificate-generator}");
-	if (useDummyPackage != string::npos) {
-		result.replace(useDummyPackage, 34, "");
+	size_t beginDocument = content.find("\\begin{document}");
+	if (beginDocument == string::npos) {
+		return "";
+	}
+	size_t end = min({ beginDocument, content.find("\\substitude"), content.find("\\optional") });
+	//Only use complete lines
+	size_t lineStart = content.rfind('\n', end);
+	if (lineStart == string::npos) {
+		return "";
+	}
+	string preamble = content.substr(0, lineStart + 1);
+	if (preamble.find("\\documentclass") == string::npos) {
+		return "";
 	}
+	return preamble;
+}
+
+bool TemplateCertificate::hasFormat() const
+{
+	return !formatPreamble.empty();
+}
+
+const Certificate TemplateCertificate::generateFormatCertificate() const
+{
+	Certificate formatCertificate(formatName, formatPreamble + "\\dump\n");
+	formatCertificate.setTemplateName(basename);
+	return formatCertificate;
+}
+
+void TemplateCertificate::enableFormat()
+{
+	formatEnabled = hasFormat();
+}
+
+bool TemplateCertificate::canCombine() const
+{
+	return hasFormat();
+}
 
-	//replace optional
-	for (tagPosition tp = findOptional(result, 0); tp.start != string::npos; tp = findOptional(result, tp.start + 1)) {
-		string optional = result.substr(tp.start, tp.stop - tp.start);
-		result.replace(tp.start, tp.stop - tp.start + 1, replaceOptional(optional, student));
+string TemplateCertificate::generateCombinedSetup() const
+{
+	//Macros that are changed by \maketitle or the preamble of a certificate
+	const vector<string> titleMacros = { "maketitle", "@maketitle", "title", "author", "date", "thanks", "and", "@title", "@author", "@date", "@thanks" };
+	stringstream setup;
+	setup << "\\makeatletter\n";
+	//Record the number of shipped pages before every certificate
+	setup << "\\newwrite\\cg@pages\n";
+	setup << "\\immediate\\openout\\cg@pages=\\jobname.pages\\relax\n";
+	setup << "\\ifdefined\\ReadonlyShipoutCounter\n";
+	setup << "\\def\\cg@shippedpages{\\the\\ReadonlyShipoutCounter}\n";
+	setup << "\\else\n";
+	setup << "\\RequirePackage{atbegshi}\n";
+	setup << "\\newcount\\cg@shipped\n";
+	setup << "\\AtBeginShipout{\\global\\advance\\cg@shipped\\@ne}\n";
+	setup << "\\def\\cg@shippedpages{\\the\\cg@shipped}\n";
+	setup << "\\fi\n";
+	//Save the title macros, because \maketitle disables itself
+	setup << "\\AtBeginDocument{%\n";
+	for (const string& macro : titleMacros) {
+		setup << "\\global\\let\\cg@save@" << macro << "\\" << macro << "\n";
+	}
+	setup << "}\n";
+	//Start every certificate on a new page with reset counters and title
+	setup << "\\def\\cgbegincertificate{%\n";
+	setup << "\\clearpage\n";
+	setup << "\\immediate\\write\\cg@pages{\\cg@shippedpages}%\n";
+	setup << "\\begingroup\\def\\@elt##1{\\global\\csname c@##1\\endcsname\\z@}\\cl@@ckpt\\endgroup\n";
+	setup << "\\global\\c@page\\@ne\n";
+	for (const string& macro : titleMacros) {
+		setup << "\\global\\let\\" << macro << "\\cg@save@" << macro << "\n";
 	}
+	setup << "}\n";
+	setup << "\\def\\cgendcertificates{%\n";
+	setup << "\\clearpage\n";
+	setup << "\\immediate\\write\\cg@pages{\\cg@shippedpages}%\n";
+	setup << "\\immediate\\closeout\\cg@pages\n";
+	setup << "}\n";
+	setup << "\\makeatother\n";
+	return setup.str();
+}
 
-	//replace tags
-	for (tagPosition tp = findSubstitude(result, 0); tp.start != string::npos; tp = findSubstitude(result, tp.start + 1)) {
-		string substitution = result.substr(tp.start, tp.stop - tp.start);
-		string substitutionNamespace = getSubstitudeNamespace(substitution);
-		string substitutionName = getSubstitudeName(substitution);
-		if (substitutionNamespace == "student") {
-			if (student.getProperties()[substitutionName].is_string()) {
-				result.replace(tp.start, tp.stop - tp.start + 1, student.getProperties()[substitutionName]);
-			} else {
-				stringstream errormessage;
-				errormessage << "No property " << substitutionName << " of type string in " << substitutionNamespace;
-				throw InvalidConfigurationError(errormessage.str());
-			}
-		} else if (substitutionNamespace == "global") {
-			if (globalProperties[substitutionName].is_string()) {
-				result.replace(tp.start, tp.stop - tp.start + 1, globalProperties[substitutionName]);
-			} else {
-				stringstream errormessage;
-				errormessage << "No property " << substitutionName << " of type string in " << substitutionNamespace;
-				throw InvalidConfigurationError(errormessage.str());
-			}
-		} else if (substitutionNamespace == "auto") {
-			if (student.getProperties()[substitutionName].is_string()) {
-				result.replace(tp.start, tp.stop - tp.start + 1, student.getProperties()[substitutionName]);
-			} else if (globalProperties[substitutionName].is_string()) {
-				result.replace(tp.start, tp.stop - tp.start + 1, globalProperties[substitutionName]);
-			} else {
-				stringstream errormessage;
-				errormessage << "No property " << substitutionName << " of type string in any valid namespace";
-				throw InvalidConfigurationError(errormessage.str());
-			}
+const CombinedCertificate TemplateCertificate::generateCombinedCertificate(const vector<Certificate>& parts)
+{
+	generatedCombinedCertificateCounter++;
+	stringstream content;
+	//The static preamble is contained in the format, so it is only needed without format
+	if (!formatEnabled) {
+		content << formatPreamble;
+	}
+	content << generateCombinedSetup();
+	content << "\\begin{document}\n";
+	for (const Certificate& part : parts) {
+		string partContent = part.getContent();
+		if (partContent.compare(0, formatPreamble.size(), formatPreamble) == 0) {
+			partContent.erase(0, formatPreamble.size());
+		}
+		size_t beginDocument = partContent.find("\\begin{document}");
+		size_t endDocument = partContent.rfind("\\end{document}");
+		if (beginDocument == string::npos || endDocument == string::npos || endDocument < beginDocument) {
+			stringstream errormessage;
+			errormessage << "Certificate " << part.getName() << " has no document body and can not be combined";
+			throw InvalidTemplateError(errormessage.str());
 		}
+		size_t bodyStart = beginDocument + 16;
+		content << "\\cgbegincertificate\n";
+		content << "\\begingroup\n";
+		content << partContent.substr(0, beginDocument);
+		content << partContent.substr(bodyStart, endDocument - bodyStart) << "\n";
+		content << "\\endgroup\n";
 	}
+	content << "\\cgendcertificates\n";
+	content << "\\end{document}\n";
+
+	stringstream name;
+	name << basename << "_combined_" << generatedCombinedCertificateCounter;
+	CombinedCertificate combinedCertificate(name.str(), content.str(), formatEnabled ? formatName : "", parts);
+	combinedCertificate.setTemplateName(basename);
+	return combinedCertificate;
+}
+
+bool TemplateCertificate::checkStudent(const Student& student) const
+{
+	return true;
+}
+
+const Certificate TemplateCertificate::generateCertificate(const Student& student)
+{
+	generatedCertificateCounter++;
+	const json& studentProperties = student.getProperties();
+
+	//The static preamble is contained in the format, so it is not needed again
+	size_t skip = formatEnabled ? formatPreamble.size() : 0;
+
+	string result;
+	result.reserve(renderedSize);
+	renderSegments(compiledTemplate, studentProperties, nullptr, skip, result);
+	renderedSize = max(renderedSize, result.size());
 
 	string filename = generateName(student);
-	return Certificate(filename, result);
+	Certificate certificate = formatEnabled ? Certificate(filename, result, formatName) : Certificate(filename, result);
+	certificate.setTemplateName(basename);
+	return certificate;
 }
 
 string TemplateCertificate::generateName(const Student& student) const
 {
 	stringstream name;
 	name << basename << "_" << generatedCertificateCounter;
-	if (student.getProperties()["surname"] != nullptr) {
-		name << "_" << student.getProperties()["surname"].get<string>();
+	const string* surname = student.getStringProperty("surname");
+	if (surname != nullptr) {
+		name << "_" << *surname;
 	}
-	if (student.getProperties()["name"] != nullptr) {
-		name << "_" << student.getProperties()["name"].get<string>();
+	const string* firstName = student.getStringProperty("name");
+	if (firstName != nullptr) {
+		name << "_" << *firstName;
 	}
 	return name.str();
 }
 
-//TODO tables not only in student
-string TemplateCertificate::replaceOptional(const string& optional, const Student& student) const
+vector<TemplateSegment> TemplateCertificate::compileTemplate(size_t start, size_t stop) const
 {
-	string result;
-	json name = student.getProperties()[getOptionalName(optional)];
-	string content = getOptionalContent(optional);
-	if (name.is_array()) {
-		for (json object : name) {
-			string line = content;
-			for (tagPosition tp = findSubstitude(line, 0); tp.start != string::npos; tp = findSubstitude(line, tp.start + 1)) {
-				string substitution = line.substr(tp.start, tp.stop - tp.start);
-				string substitutionNamespace = getSubstitudeNamespace(substitution);
-				string substitutionName = getSubstitudeName(substitution);
-				//TODO detect also "table" as a valid namespace and throw a error if appropriate
-				if (substitutionNamespace == "auto") {
-					if (object[substitutionName].is_string()) {
-						line.replace(tp.start, tp.stop - tp.start + 1, object[substitutionName]);
-					}
+	vector<TemplateSegment> segments;
+	size_t position = start;
+	while (position < stop) {
+		tagPosition optional = findOptional(templateContent, position);
+		tagPosition substitude = findSubstitude(templateContent, position);
+		size_t tagStart = min(optional.start, substitude.start);
+		if (tagStart >= stop) {
+			break;
+		}
+
+		//Text before the tag is copied unchanged
+		if (tagStart > position) {
+			segments.push_back(TemplateSegment { TemplateSegment::LITERAL, position, tagStart - position, "", "", {} });
+		}
+
+		if (tagStart == optional.start) {
+			if (optional.stop == string::npos || optional.stop > stop) {
+				stringstream errormessage;
+				errormessage << "Optional at position " << optional.start << " is not terminated";
+				throw InvalidTemplateError(errormessage.str());
+			}
+			string tag = templateContent.substr(optional.start, optional.stop - optional.start);
+			size_t bodyStart = templateContent.find("{", templateContent.find("}", optional.start)) + 1;
+			TemplateSegment segment { TemplateSegment::OPTIONAL, optional.start, optional.stop - optional.start, getOptionalName(tag), "student", {} };
+			segment.body = compileTemplate(bodyStart, optional.stop - 1);
+			segments.push_back(segment);
+			//The character after an optional is removed, so a line containing only the end of an optional leaves no empty line
+			position = optional.stop + 1;
+		} else {
+			if (substitude.stop == string::npos || substitude.stop >= stop) {
+				stringstream errormessage;
+				errormessage << "Substitution at position " << substitude.start << " is not terminated";
+				throw InvalidTemplateError(errormessage.str());
+			}
+			string tag = templateContent.substr(substitude.start, substitude.stop - substitude.start);
+			TemplateSegment segment { TemplateSegment::SUBSTITUTION, substitude.start, substitude.stop + 1 - substitude.start, getSubstitudeName(tag), getSubstitudeNamespace(tag), {} };
+			//Global properties are the same for every certificate, so they are only looked up once
+			const string* globalValue = Student::findStringProperty(*globalProperties, segment.name);
+			if (globalValue != nullptr) {
+				segment.hasGlobalValue = true;
+				segment.globalValue = *globalValue;
+			}
+			segments.push_back(segment);
+			position = substitude.stop + 1;
+		}
+	}
+	if (position < stop) {
+		segments.push_back(TemplateSegment { TemplateSegment::LITERAL, position, stop - position, "", "", {} });
+	}
+	return segments;
+}
+
+void TemplateCertificate::renderSegments(const vector<TemplateSegment>& segments, const json& studentProperties, const json* object, size_t skip, string& result) const
+{
+	for (const TemplateSegment& segment : segments) {
+		if (segment.type == TemplateSegment::LITERAL) {
+			//Skipped characters can only be at the start of the template
+			if (segment.start + segment.length <= skip) {
+				continue;
+			}
+			size_t start = max(segment.start, skip);
+			result.append(templateContent, start, segment.start + segment.length - start);
+		} else if (segment.type == TemplateSegment::OPTIONAL) {
+			auto array = studentProperties.find(segment.name);
+			if (array == studentProperties.end() || !array->is_array()) {
+				stringstream errormessage;
+				errormessage << "No array " << segment.name << " in student";
+				throw InvalidConfigurationError(errormessage.str());
+			}
+			for (const json& entry : *array) {
+				renderSegments(segment.body, studentProperties, &entry, 0, result);
+			}
+		} else {
+			const string* value = nullptr;
+			if (segment.tagNamespace == "student") {
+				value = Student::findStringProperty(studentProperties, segment.name);
+			} else if (segment.tagNamespace == "global") {
+				value = segment.hasGlobalValue ? &segment.globalValue : nullptr;
+			} else if (segment.tagNamespace == "auto") {
+				if (object != nullptr) {
+					value = Student::findStringProperty(*object, segment.name);
 				}
+				if (value == nullptr) {
+					value = Student::findStringProperty(studentProperties, segment.name);
+				}
+				if (value == nullptr && segment.hasGlobalValue) {
+					value = &segment.globalValue;
+				}
+			} else {
+				//Unknown namespaces are not replaced
+				result.append(templateContent, segment.start, segment.length);
+				continue;
+			}
+			if (value == nullptr) {
+				stringstream errormessage;
+				if (segment.tagNamespace == "auto") {
+					errormessage << "No property " << segment.name << " of type string in any valid namespace";
+				} else {
+					errormessage << "No property " << segment.name << " of type string in " << segment.tagNamespace;
+				}
+				throw InvalidConfigurationError(errormessage.str());
 			}
-			result.append(line);
+			result.append(*value);
 		}
-	} else {
-		stringstream errormessage;
-		errormessage << "No array " << getOptionalName(optional) << " in student";
-		throw InvalidConfigurationError(errormessage.str());
 	}
-	return result;
 }
 
-tagPosition TemplateCertificate::findOptional(const string& full, int start) const
+tagPosition TemplateCertificate::findOptional(const string& full, size_t start) const
 {
 	tagPosition tp;
 	tp.start = full.find("\\optional", start);
-	tp.stop = full.find("}", tp.start);
-
-	int open = full.find("{", tp.stop);
-	int close = open + 1;
-	while (open < close) {
-		open = full.find("{", open + 1);
-		close = full.find("}", close + 1);
+	tp.stop = string::npos;
+	if (tp.start == string::npos) {
+		return tp;
 	}
 
-	tp.stop = close + 1;
-
+	//Find the closing brace of the content
+	size_t open = full.find("{", full.find("}", tp.start));
+	if (open == string::npos) {
+		return tp;
+	}
+	int depth = 0;
+	for (size_t position = open; position < full.size(); position++) {
+		if (full[position] == '{') {
+			depth++;
+		} else if (full[position] == '}') {
+			depth--;
+			if (depth == 0) {
+				tp.stop = position + 1;
+				break;
+			}
+		}
+	}
 	return tp;
 }
 
-tagPosition TemplateCertificate::findSubstitude(const string& full, int start) const
+tagPosition TemplateCertificate::findSubstitude(const string& full, size_t start) const
 {
 	tagPosition tp;
 	tp.start = full.find("\\substitude", start);
@@ -137,12 +337,6 @@ tagPosition TemplateCertificate::findSubstitude(const string& full, int start) c
 	return tp;
 }
 
-string TemplateCertificate::getOptionalContent(const string& optional) const
-{
-	int start = optional.find("{", optional.find("{") + 1);
-	return optional.substr(start + 1, optional.length() - (start)-2);
-}
-
 string TemplateCertificate::getOptionalName(const string& optional) const
 {
 	tagPosition tp;
@@ -151,18 +345,6 @@ string TemplateCertificate::getOptionalName(const string& optional) const
 	return optional.substr(tp.start, tp.stop - tp.start);
 }
 
-string TemplateCertificate::getOptionalNamespace(const string& optional) const
-{
-	tagPosition tp;
-	tp.start = optional.find("[");
-	if (tp.start != string::npos) {
-		tp.stop = optional.find("]", tp.start);
-		return optional.substr(tp.start + 1, tp.stop - (tp.start + 1));
-	} else {
-		return "auto";
-	}
-}
-
 string TemplateCertificate::getSubstitudeName(const string& substitude) const
 {
 	tagPosition tp;
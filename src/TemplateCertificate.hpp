@@ -2,9 +2,13 @@
 #define TEMPLATE_CERTIFICATE_HPP
 
 #include "Certificate.hpp"
+#include "CombinedCertificate.hpp"
 #include "Exceptions.hpp"
+#include "Sha256.hpp"
 #include "Student.hpp"
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <sstream>
 #include <string>
@@ -22,8 +26,10 @@ using namespace std;
  * You can also check if it is possible to generate this template is compatible with a given student
  * 
  * Template file syntax:
- * <local name="NAME OF FIELD" />    will be replaced with field from student
+ * \substitude[NAMESPACE]{NAME}    will be replaced with the property NAME from the namespace
+ * \optional{NAME}{CONTENT}        CONTENT will be repeated for every entry of the array NAME of the student
  *
+ * The template is compiled once, when the TemplateCertificate is created.
  */
 
 struct tagPosition {
@@ -31,49 +37,121 @@ struct tagPosition {
 	size_t stop;
 };
 
+/**
+ * @brief A part of a compiled template
+ *
+ * A template is compiled into a sequence of segments once, so generating a
+ * certificate only has to append the segments in a single pass.
+ * Literal segments reference a span of the template content, substitutions
+ * contain the namespace and name of the property and optionals contain the
+ * compiled body, that is repeated for every entry of the array.
+ */
+struct TemplateSegment {
+	enum Type {
+		LITERAL,
+		SUBSTITUTION,
+		OPTIONAL
+	};
+	Type type;
+	//Span of the template content this segment was compiled from
+	size_t start;
+	size_t length;
+	//Name and namespace of substitutions and optionals
+	string name;
+	string tagNamespace;
+	//Compiled body of optionals
+	vector<TemplateSegment> body;
+	//The global property with the name of a substitution, resolved when compiling
+	bool hasGlobalValue = false;
+	string globalValue;
+};
+
 class TemplateCertificate {
 
 private:
 	json requiredProperties;
-	json globalProperties;
+	//Shared by all templates of a batch, it is never changed
+	shared_ptr<const json> globalProperties;
 	string templateContent;
+	vector<TemplateSegment> compiledTemplate;
+	size_t renderedSize;
 	string basename;
 	unsigned int generatedCertificateCounter;
+	unsigned int generatedCombinedCertificateCounter;
+	string formatPreamble;
+	string formatName;
+	bool formatEnabled;
+
+	/** @brief This method removes the dummy package from a template
+    * @param [in,out] content is the template content to be modified
+    *
+    * This method removes the first usage of the certificate-generator package
+    */
+	void removeDummyPackage(string& content) const;
+
+	/** @brief This method extracts the static part of the preamble
+    * @param [in] content is the template content without the dummy package
+    * @return The static part of the preamble, empty if there is none
+    *
+    * This method returns every line of the preamble before the first line
+    * containing a substitution or optional. Those lines are the same for
+    * every student, so they can be precompiled into a format.
+    */
+	string findStaticPreamble(const string& content) const;
 
-	/** @brief This method returns a string that replaces the given optional field
-    * @param [in] optional is a string representing the optional field
-    * @param [in] student is the student containing the data with which the field will be filled
-    * @return String that contains the replaced optional field
+	/** @brief This method generates the latex setup for combined certificates
+    * @return The latex code to be put at the end of the preamble of a combined certificate
     *
-    * This method returns you the string, which replaces the optional field 
+    * The setup records the number of shipped pages before every certificate in
+    * the file JOBNAME.pages. It defines \cgbegincertificate, which starts a new
+    * certificate on a new page and resets the counters and the title, and
+    * \cgendcertificates, which finishes the last certificate.
     */
-	string replaceOptional(const string& optional, const Student& student) const;
+	string generateCombinedSetup() const;
+
+	/** @brief This method compiles a part of the template
+    * @param [in] start is the position in the template content where the part starts
+    * @param [in] stop is the position in the template content where the part ends
+    * @return The compiled segments of the part
+    * @throw InvalidTemplateError if a substitution or optional is not terminated
+    *
+    * This method splits the part into literal segments, substitutions and optionals.
+    * The bodies of optionals are compiled recursively. Like in all versions before,
+    * the character following an optional is dropped.
+    */
+	vector<TemplateSegment> compileTemplate(size_t start, size_t stop) const;
+
+	/** @brief This method appends the compiled segments for a student
+    * @param [in] segments are the compiled segments to be rendered
+    * @param [in] studentProperties are the properties of the student
+    * @param [in] object is the current entry of the enclosing optional, nullptr outside of optionals
+    * @param [in] skip is the number of characters at the start of the template, that are not rendered
+    * @param [in,out] result is the string the rendered segments are appended to
+    * @throw InvalidConfigurationError if a property is missing
+    *
+    * Substitutions in the auto namespace inside of optionals are looked up in the
+    * entry of the optional first, then in the student and then in the global properties.
+    * Substitutions with an unknown namespace are not replaced.
+    */
+	void renderSegments(const vector<TemplateSegment>& segments, const json& studentProperties, const json* object, size_t skip, string& result) const;
 
 	/** @brief This method finds the next optional field in a given string
     * @param [in] full is the string that will be searched
-    * @param [in] start is a int, that specifies at which position the search starts
-    * @return tagPosition containing the beginning and end of the found optional. tagPosition.start is std::string::npos if no optional was found.
+    * @param [in] start is the position where the search starts
+    * @return tagPosition containing the beginning and the position after the end of the found optional. tagPosition.start is std::string::npos if no optional was found, tagPosition.stop is std::string::npos if it is not terminated.
     *
     * This method finds the next optional field in full after start.
     */
-	tagPosition findOptional(const string& full, int start) const;
+	tagPosition findOptional(const string& full, size_t start) const;
 
 	/** @brief This method finds the next substitution in a given string
     * @param [in] full is the string that will be searched
-    * @param [in] start is a int, that specifies at which position the search starts
-    * @return tagPosition containing the beginning and end of the found substitution. tagPosition.start is std::string::npos if no optional was found.
+    * @param [in] start is the position where the search starts
+    * @return tagPosition containing the beginning and end of the found substitution. tagPosition.start is std::string::npos if no substitution was found, tagPosition.stop is std::string::npos if it is not terminated.
     *
     * This method finds the next substitution in full after start.
     */
-	tagPosition findSubstitude(const string& full, int start) const;
-
-	/** @brief This method extracts the content from a optional field
-    * @param [in] optional a string containing the optional field
-    * @return the content of the optional field
-    *
-    * This method extracts the content from a optional field
-    */
-	string getOptionalContent(const string& optional) const;
+	tagPosition findSubstitude(const string& full, size_t start) const;
 
 	/** @brief This method extracts the name from a optional field
     * @param [in] optional a string containing the optional field
@@ -83,14 +161,6 @@ private:
     */
 	string getOptionalName(const string& optional) const;
 
-	/** @brief This method extracts the namespace from a optional field
-    * @param [in] optional a string containing the optional field
-    * @return the namespace of the optional field
-    *
-    * This method extracts the namespace from a optional field
-    */
-	string getOptionalNamespace(const string& optional) const;
-
 	/** @brief This method extracts the name from a substitution
     * @param [in] substitude a string containing the substitution
     * @return the name of the substitution
@@ -114,9 +184,19 @@ public:
     * @param [in] globalProperties is a json containing the global properties
     * @return A pointer to the created TemplateCertificate
     *
-    * description
+    * The global properties are copied, use the other constructor to share them between templates.
+    */
+	TemplateCertificate(const string& basename, const string& templateContent, const json& globalProperties);
+
+	/** @brief Constructor that creates a TemplateCertificate with shared global properties
+	* @param [in] basename is a string containing the basename for generated files
+    * @param [in] template is a string containing the template for generated certificate
+    * @param [in] globalProperties is a pointer to a json containing the global properties
+    * @return A pointer to the created TemplateCertificate
+    *
+    * The global properties are not copied, all templates of a batch reference the same json.
     */
-	TemplateCertificate(const string& basename, const string& templateContent, json& globalProperties);
+	TemplateCertificate(const string& basename, const string& templateContent, shared_ptr<const json> globalProperties);
 
 	/** @brief This method checks whether the Student is compatible with this template
     * @param [in] student is the Student to be checked 
@@ -141,6 +221,48 @@ public:
     * This method generates a Certificate based on this template and student
     */
 	const Certificate generateCertificate(const Student& student);
+
+	/** @brief This method checks whether this template has a preamble that can be precompiled
+    * @return Boolean that indicates whether there is a static preamble
+    */
+	bool hasFormat() const;
+
+	/** @brief This method generates a certificate for precompiling the static preamble
+    * @return The generated Certificate
+    *
+    * The generated Certificate contains the static part of the preamble followed by \dump.
+    * It is named after the hash of the static preamble, so templates with the same
+    * preamble share a format. Use Certificate::generateFormat to generate the format file.
+    */
+	const Certificate generateFormatCertificate() const;
+
+	/** @brief This method enables the usage of the precompiled preamble
+    *
+    * After calling this, generateCertificate produces Certificates without the static
+    * part of the preamble, that are compiled with the format. Call this only after the
+    * format was generated successfully.
+    */
+	void enableFormat();
+
+	/** @brief This method checks whether certificates of this template can be combined into one document
+    * @return Boolean that indicates whether the certificates can be combined
+    *
+    * Certificates can only be combined, if they share the static part of the preamble
+    * containing the documentclass.
+    */
+	bool canCombine() const;
+
+	/** @brief This method combines certificates of this template into one document
+    * @param [in] parts is a vector of Certificates generated by this template
+    * @return The generated CombinedCertificate
+    * @throw InvalidTemplateError if a certificate has no document body
+    *
+    * The combined document contains the static preamble once, followed by the
+    * remaining preamble and the body of every certificate in its own group.
+    * Every certificate starts on a new page with reset counters, so the pdf
+    * can be split into the pdfs of the single certificates after compiling.
+    */
+	const CombinedCertificate generateCombinedCertificate(const vector<Certificate>& parts);
 };
 
 #endif
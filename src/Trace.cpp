@@ -0,0 +1,198 @@
+#include "Trace.hpp"
+
+filesystem::path Trace::outputDirectory;
+
+Trace::Span::Span(Trace* trace, Stage stage, const string& name)
+	: trace(trace)
+	, stage(stage)
+	, name(name)
+{
+	if (trace != nullptr) {
+		start = chrono::steady_clock::now();
+	}
+}
+
+Trace::Span::~Span()
+{
+	if (trace != nullptr) {
+		trace->record(stage, start, chrono::steady_clock::now(), name);
+	}
+}
+
+void Trace::setOutputDirectory(const filesystem::path& directory)
+{
+	if (!directory.empty()) {
+		error_code error;
+		filesystem::create_directories(directory, error);
+		if (error) {
+			throw FileAccessError("Failed to create trace directory " + directory.string() + ": " + error.message());
+		}
+	}
+	outputDirectory = directory;
+}
+
+const filesystem::path& Trace::getOutputDirectory()
+{
+	return outputDirectory;
+}
+
+const char* Trace::getStageName(Stage stage)
+{
+	static const char* names[STAGE_COUNT] = { "queueWait", "generatePDF", "cacheLookup", "createJobDirectory", "writeToWorkingDirectory", "launch", "compile", "moveResultToOutputDirectory", "cleanWorkingDirectory", "cacheStore" };
+	return names[stage];
+}
+
+unsigned int Trace::getThreadNumber()
+{
+	static atomic<unsigned int> threads(0);
+	thread_local unsigned int thread = ++threads;
+	return thread;
+}
+
+Trace::Trace(const string& id)
+	: id(id)
+	, start(chrono::steady_clock::now())
+	, keepEvents(!outputDirectory.empty())
+{
+}
+
+void Trace::record(Stage stage, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end, const string& name)
+{
+	long long nanoseconds = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+	StageCounters& counters = stages[stage];
+	counters.count.fetch_add(1, memory_order_relaxed);
+	counters.totalNanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+	long long maxNanoseconds = counters.maxNanoseconds.load(memory_order_relaxed);
+	while (nanoseconds > maxNanoseconds && !counters.maxNanoseconds.compare_exchange_weak(maxNanoseconds, nanoseconds, memory_order_relaxed)) {
+	}
+	if (keepEvents) {
+		Event event { stage, getThreadNumber(), start - this->start, end - start, name };
+		unique_lock<mutex> lock(eventsMutex);
+		events.push_back(move(event));
+	}
+}
+
+Trace::StageStatistics Trace::getStatistics(Stage stage) const
+{
+	const StageCounters& counters = stages[stage];
+	return StageStatistics { counters.count.load(memory_order_relaxed), chrono::nanoseconds(counters.totalNanoseconds.load(memory_order_relaxed)), chrono::nanoseconds(counters.maxNanoseconds.load(memory_order_relaxed)) };
+}
+
+void Trace::recordCompilerRun(const string& templateName, const CompilerRun& run, bool failed)
+{
+	unique_lock<mutex> lock(compilersMutex);
+	CompilerStatistics& statistics = compilers.try_emplace(templateName, CompilerStatistics { 0, 0, chrono::microseconds(0), chrono::microseconds(0), 0, chrono::microseconds(0), 0 }).first->second;
+	statistics.runs++;
+	statistics.failures += failed ? 1 : 0;
+	statistics.totalWallTime += run.wallTime;
+	statistics.maxWallTime = max(statistics.maxWallTime, run.wallTime);
+	if (run.measured) {
+		statistics.measuredRuns++;
+		statistics.totalCpuTime += run.cpuTime;
+		statistics.peakMemory = max(statistics.peakMemory, run.peakMemory);
+	}
+}
+
+map<string, Trace::CompilerStatistics> Trace::getCompilerStatistics() const
+{
+	unique_lock<mutex> lock(compilersMutex);
+	return compilers;
+}
+
+string Trace::summary() const
+{
+	stringstream line;
+	line << "Batch " << id << " stages:";
+	bool empty = true;
+	for (int stage = 0; stage < STAGE_COUNT; stage++) {
+		StageStatistics statistics = getStatistics((Stage)stage);
+		if (statistics.count == 0) {
+			continue;
+		}
+		empty = false;
+		line << " " << getStageName((Stage)stage) << " " << statistics.count << "x "
+			 << chrono::duration_cast<chrono::milliseconds>(statistics.totalTime).count() << "ms (max "
+			 << chrono::duration_cast<chrono::milliseconds>(statistics.maxTime).count() << "ms)";
+	}
+	if (empty) {
+		line << " none";
+	}
+	return line.str();
+}
+
+string Trace::compilerSummary(size_t maxTemplates) const
+{
+	map<string, CompilerStatistics> statistics = getCompilerStatistics();
+	vector<pair<string, CompilerStatistics>> slowest(statistics.begin(), statistics.end());
+	sort(slowest.begin(), slowest.end(), [](const pair<string, CompilerStatistics>& a, const pair<string, CompilerStatistics>& b) {
+		return a.second.totalWallTime > b.second.totalWallTime;
+	});
+
+	stringstream line;
+	line << "Batch " << id << " compilers:";
+	if (slowest.empty()) {
+		line << " none";
+	}
+	for (size_t i = 0; i < slowest.size() && i < maxTemplates; i++) {
+		const CompilerStatistics& usage = slowest[i].second;
+		line << (i == 0 ? " " : ", ") << slowest[i].first << " " << usage.runs << "x "
+			 << chrono::duration_cast<chrono::milliseconds>(usage.totalWallTime).count() << "ms (max "
+			 << chrono::duration_cast<chrono::milliseconds>(usage.maxWallTime).count() << "ms)";
+		if (usage.measuredRuns > 0) {
+			line << " cpu " << chrono::duration_cast<chrono::milliseconds>(usage.totalCpuTime).count() << "ms peak "
+				 << usage.peakMemory / (1024 * 1024) << "MiB";
+		}
+		if (usage.failures > 0) {
+			line << " " << usage.failures << " failed";
+		}
+	}
+	if (slowest.size() > maxTemplates) {
+		line << ", " << slowest.size() - maxTemplates << " more";
+	}
+	return line.str();
+}
+
+void Trace::writeChromeTrace(const filesystem::path& file)
+{
+	json traceEvents = json::array();
+	pid_t pid = getpid();
+	unique_lock<mutex> lock(eventsMutex);
+	for (size_t i = 0; i < events.size(); i++) {
+		const Event& event = events[i];
+		double startMicroseconds = chrono::duration<double, micro>(event.start).count();
+		double durationMicroseconds = chrono::duration<double, micro>(event.duration).count();
+		json args = { { "batch", id }, { "certificate", event.name } };
+		if (event.stage == QUEUE_WAIT) {
+			json begin = { { "name", getStageName(event.stage) }, { "cat", "queue" }, { "ph", "b" }, { "id", i }, { "ts", startMicroseconds }, { "pid", pid }, { "tid", event.thread }, { "args", args } };
+			json end = { { "name", getStageName(event.stage) }, { "cat", "queue" }, { "ph", "e" }, { "id", i }, { "ts", startMicroseconds + durationMicroseconds }, { "pid", pid }, { "tid", event.thread } };
+			traceEvents.push_back(move(begin));
+			traceEvents.push_back(move(end));
+		} else {
+			traceEvents.push_back({ { "name", getStageName(event.stage) }, { "cat", "certificate" }, { "ph", "X" }, { "ts", startMicroseconds }, { "dur", durationMicroseconds }, { "pid", pid }, { "tid", event.thread }, { "args", args } });
+		}
+	}
+	lock.unlock();
+
+	ofstream output(file);
+	output << json { { "traceEvents", traceEvents }, { "displayTimeUnit", "ms" } }.dump();
+	output.close();
+	if (!output) {
+		throw FileAccessError("Failed to write trace " + file.string());
+	}
+}
+
+filesystem::path Trace::writeChromeTrace()
+{
+	if (outputDirectory.empty()) {
+		return "";
+	}
+	//The id may be a path or contain characters, that are not allowed in filenames
+	string filename = "trace-";
+	for (char character : id) {
+		filename += isalnum((unsigned char)character) || character == '-' ? character : '_';
+	}
+	filename += "-" + to_string(chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count()) + ".json";
+	filesystem::path file = outputDirectory / filename;
+	writeChromeTrace(file);
+	return file;
+}
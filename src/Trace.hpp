@@ -0,0 +1,216 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "Exceptions.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::json;
+using namespace std;
+
+/**
+ * @class Trace
+ *
+ * @brief Records how long the stages of generating the pdfs of a batch take
+ *
+ * A Trace is created for every execution of a Batch. The Certificates of the
+ * batch record their stages, like writing the tex file, starting the compiler
+ * or waiting for it, with a Span. The durations of every stage are summed up
+ * with atomic operations, so tracing is cheap enough to be always enabled.
+ *
+ * The resource usage of every compiler process is summed up per template, to
+ * find the templates, that are slow to compile or need a lot of memory.
+ *
+ * If an output directory is set with setOutputDirectory, every span is also
+ * kept as an event and the batch writes them as a Chrome trace, that can be
+ * opened in chrome://tracing or https://ui.perfetto.dev. The events of a batch
+ * are kept in memory until it is finished.
+ */
+class Trace {
+public:
+	enum Stage {
+		QUEUE_WAIT,
+		GENERATE_PDF,
+		CACHE_LOOKUP,
+		CREATE_JOB_DIRECTORY,
+		WRITE_TO_WORKING_DIRECTORY,
+		LAUNCH,
+		COMPILE,
+		MOVE_RESULT_TO_OUTPUT_DIRECTORY,
+		CLEAN_WORKING_DIRECTORY,
+		CACHE_STORE,
+		STAGE_COUNT
+	};
+
+	/**
+	 * @brief Records the lifetime of a scope as a stage of a Trace
+	 *
+	 * The span does nothing, if the trace is nullptr.
+	 */
+	class Span {
+	private:
+		Trace* trace;
+		Stage stage;
+		const string& name;
+		chrono::steady_clock::time_point start;
+
+	public:
+		/** @brief Constructor that starts a Span
+        * @param [in] trace the Trace getting the duration, or nullptr
+        * @param [in] stage the stage, that is measured
+        * @param [in] name the name of the certificate, it has to outlive the span
+        * @return A pointer to the created Span
+        */
+		Span(Trace* trace, Stage stage, const string& name);
+
+		/** @brief Destructor that records the duration
+        */
+		~Span();
+	};
+
+	struct StageStatistics {
+		unsigned long long count;
+		chrono::nanoseconds totalTime;
+		chrono::nanoseconds maxTime;
+	};
+
+	struct CompilerStatistics {
+		unsigned long long runs;
+		unsigned long long failures;
+		chrono::microseconds totalWallTime;
+		chrono::microseconds maxWallTime;
+		//The runs, whose cpu time and peak memory are known
+		unsigned long long measuredRuns;
+		chrono::microseconds totalCpuTime;
+		long long peakMemory;
+	};
+
+private:
+	struct Event {
+		Stage stage;
+		unsigned int thread;
+		chrono::nanoseconds start;
+		chrono::nanoseconds duration;
+		string name;
+	};
+
+	struct StageCounters {
+		atomic<unsigned long long> count { 0 };
+		atomic<long long> totalNanoseconds { 0 };
+		atomic<long long> maxNanoseconds { 0 };
+	};
+
+	static filesystem::path outputDirectory;
+
+	const string id;
+	const chrono::steady_clock::time_point start;
+	const bool keepEvents;
+	array<StageCounters, STAGE_COUNT> stages;
+	mutex eventsMutex;
+	vector<Event> events;
+	mutable mutex compilersMutex;
+	map<string, CompilerStatistics> compilers;
+
+	/** @brief Returns a small number identifying the calling thread in the Chrome trace
+    * @return The number of the thread
+    */
+	static unsigned int getThreadNumber();
+
+public:
+	/** @brief Sets the directory, where the Chrome traces of batches are written
+    * @param [in] directory the directory for the traces, empty to not write traces
+    * @throw FileAccessError if the directory can not be created
+    */
+	static void setOutputDirectory(const filesystem::path& directory);
+
+	/** @brief Returns the directory, where the Chrome traces of batches are written
+    * @return The directory for the traces, empty if no traces are written
+    */
+	static const filesystem::path& getOutputDirectory();
+
+	/** @brief Returns the name of a stage
+    * @param [in] stage the stage
+    * @return The name of the stage, like the method that it measures
+    */
+	static const char* getStageName(Stage stage);
+
+	/** @brief Constructor that starts a Trace
+    * @param [in] id the id of the traced batch, like the id of the connection
+    * @return A pointer to the created Trace
+    *
+    * The events are only kept, if an output directory is set.
+    */
+	Trace(const string& id);
+
+	/** @brief Records a stage
+    * @param [in] stage the stage
+    * @param [in] start the time at which the stage started
+    * @param [in] end the time at which the stage ended
+    * @param [in] name the name of the certificate
+    *
+    * Can be called from any thread.
+    */
+	void record(Stage stage, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end, const string& name);
+
+	/** @brief Returns the statistics of a stage
+    * @param [in] stage the stage
+    * @return The number of times the stage was recorded and its total and maximum duration
+    */
+	StageStatistics getStatistics(Stage stage) const;
+
+	/** @brief Records the resource usage of a compiler process
+    * @param [in] templateName the name of the template, the compiled certificate was generated from
+    * @param [in] run the resource usage of the process
+    * @param [in] failed a bool specifying if the process exited with an error
+    *
+    * Can be called from any thread.
+    */
+	void recordCompilerRun(const string& templateName, const CompilerRun& run, bool failed);
+
+	/** @brief Returns the resource usage of the compiler processes per template
+    * @return A map from the name of the template to the summed up usage of its processes
+    */
+	map<string, CompilerStatistics> getCompilerStatistics() const;
+
+	/** @brief Summarizes the recorded stages
+    * @return A line containing the number, the total and the maximum duration of every recorded stage
+    */
+	string summary() const;
+
+	/** @brief Summarizes the compiler processes of the templates, that took the most time
+    * @param [in] maxTemplates the maximum number of listed templates
+    * @return A line containing the runs, failures, wall and cpu time and peak memory of the templates
+    */
+	string compilerSummary(size_t maxTemplates = 5) const;
+
+	/** @brief Writes the recorded events as a Chrome trace
+    * @param [in] file the path of the json file
+    * @throw FileAccessError if the file can not be written
+    *
+    * Every stage is a complete event on the thread, that executed it. Waiting
+    * in the queue is no work of a thread, so it is written as an async event.
+    */
+	void writeChromeTrace(const filesystem::path& file);
+
+	/** @brief Writes the Chrome trace into the output directory, if it is set
+    * @return The path of the written trace, empty if no output directory is set
+    * @throw FileAccessError if the file can not be written
+    *
+    * The file is named after the id of the trace and the time it is written.
+    */
+	filesystem::path writeChromeTrace();
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "WorkerPool.hpp"
+
+JobQueue::JobQueue(WorkerPool& pool, unsigned int maxParallel, unsigned int maxQueued, unsigned int weight)
+	: pool(pool)
+	, maxParallel(maxParallel > 0 ? maxParallel : 1)
+	, maxQueued(maxQueued)
+	, weight(clamp(weight, 1u, (unsigned int)MAX_QUEUE_WEIGHT))
+	, running(0)
+	, active(false)
+	, pass(0)
+	, deadline(chrono::steady_clock::time_point::max())
+	, statistics { 0, 0, 0, 0, chrono::microseconds(0), chrono::microseconds(0) }
+{
+}
+
+JobQueue::~JobQueue()
+{
+	wait();
+}
+
+void JobQueue::submit(function<void()> job, bool wait)
+{
+	unique_lock<mutex> lock(pool.poolMutex);
+	if (wait && maxQueued > 0) {
+		jobTaken.wait(lock, [this]() { return jobs.size() < maxQueued; });
+	}
+	if (chrono::steady_clock::now() >= deadline) {
+		statistics.droppedJobs++;
+		pool.droppedJobs.increment();
+		return;
+	}
+	jobs.push_back({ move(job), chrono::steady_clock::now() });
+	statistics.peakQueuedJobs = max(statistics.peakQueuedJobs, jobs.size());
+	pool.queuedJobs.add(1);
+	if (!active) {
+		active = true;
+		pass = max(pass, pool.virtualTime);
+		pool.activeQueues.push_back(this);
+	}
+	lock.unlock();
+	pool.jobAvailable.notify_one();
+}
+
+void JobQueue::wait()
+{
+	unique_lock<mutex> lock(pool.poolMutex);
+	finished.wait(lock, [this]() { return jobs.empty() && running == 0; });
+}
+
+void JobQueue::setDeadline(chrono::steady_clock::time_point deadline)
+{
+	unique_lock<mutex> lock(pool.poolMutex);
+	this->deadline = deadline;
+}
+
+JobQueue::Statistics JobQueue::getStatistics() const
+{
+	unique_lock<mutex> lock(pool.poolMutex);
+	Statistics current = statistics;
+	current.queuedJobs = jobs.size();
+	return current;
+}
+
+WorkerPool::WorkerPool(unsigned int workers)
+	: virtualTime(0)
+	, stopping(false)
+	, queuedJobs(Metrics::get().gauge("certgen_queued_jobs", "Compiler jobs waiting for a worker"))
+	, waitSeconds(Metrics::get().histogram("certgen_queue_wait_seconds", "Time compiler jobs waited for a worker"))
+	, droppedJobs(Metrics::get().counter("certgen_dropped_jobs_total", "Compiler jobs dropped after the deadline of their batch"))
+{
+	if (workers == 0) {
+		workers = 1;
+	}
+	for (unsigned int i = 0; i < workers; i++) {
+		threads.emplace_back(&WorkerPool::work, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	unique_lock<mutex> lock(poolMutex);
+	stopping = true;
+	lock.unlock();
+	jobAvailable.notify_all();
+	for (thread& t : threads) {
+		t.join();
+	}
+}
+
+WorkerPool& WorkerPool::get()
+{
+	static WorkerPool pool(CONFIG.maxWorkers);
+	return pool;
+}
+
+shared_ptr<JobQueue> WorkerPool::createQueue(unsigned int maxParallel, unsigned int maxQueued, unsigned int weight)
+{
+	return make_shared<JobQueue>(*this, maxParallel, maxQueued, weight);
+}
+
+size_t WorkerPool::size() const
+{
+	return threads.size();
+}
+
+JobQueue* WorkerPool::selectQueue()
+{
+	JobQueue* selected = nullptr;
+	for (JobQueue* queue : activeQueues) {
+		if (!queue->jobs.empty() && queue->running < queue->maxParallel && (selected == nullptr || queue->pass < selected->pass)) {
+			selected = queue;
+		}
+	}
+	return selected;
+}
+
+void WorkerPool::work()
+{
+	unique_lock<mutex> lock(poolMutex);
+	while (true) {
+		JobQueue* queue = nullptr;
+		jobAvailable.wait(lock, [this, &queue]() {
+			queue = selectQueue();
+			return stopping || queue != nullptr;
+		});
+		if (stopping) {
+			return;
+		}
+
+		//The jobs of a queue, whose deadline passed, are dropped without occupying a thread
+		if (chrono::steady_clock::now() >= queue->deadline) {
+			queue->statistics.droppedJobs += queue->jobs.size();
+			queuedJobs.add(-(long long)queue->jobs.size());
+			droppedJobs.increment(queue->jobs.size());
+			queue->jobs.clear();
+			queue->active = false;
+			activeQueues.erase(find(activeQueues.begin(), activeQueues.end(), queue));
+			queue->jobTaken.notify_all();
+			if (queue->running == 0) {
+				queue->finished.notify_all();
+			}
+			continue;
+		}
+
+		JobQueue::QueuedJob queuedJob = move(queue->jobs.front());
+		queue->jobs.pop_front();
+		queue->running++;
+		virtualTime = queue->pass;
+		queue->pass += SCHEDULER_STRIDE / queue->weight;
+		chrono::microseconds waitTime = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - queuedJob.submitted);
+		queue->statistics.executedJobs++;
+		queue->statistics.totalWaitTime += waitTime;
+		queue->statistics.maxWaitTime = max(queue->statistics.maxWaitTime, waitTime);
+		queuedJobs.add(-1);
+		waitSeconds.observe(chrono::duration<double>(waitTime).count());
+		queue->jobTaken.notify_one();
+		//Remove the queue from the rotation, once it has no jobs left
+		if (queue->jobs.empty()) {
+			queue->active = false;
+			activeQueues.erase(find(activeQueues.begin(), activeQueues.end(), queue));
+		}
+		lock.unlock();
+
+		try {
+			queuedJob.job();
+		} catch (const exception& error) {
+			spdlog::error("Job in worker pool failed: {}", error.what());
+		} catch (...) {
+			spdlog::error("Job in worker pool failed with unknown error");
+		}
+
+		lock.lock();
+		queue->running--;
+		if (queue->jobs.empty() && queue->running == 0) {
+			queue->finished.notify_all();
+		}
+		//A slot of this queue got free, so one of its waiting jobs may be runnable now
+		jobAvailable.notify_one();
+	}
+}
@@ -0,0 +1,216 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include "Configuration.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#define DEFAULT_QUEUE_WEIGHT 10
+#define MAX_QUEUE_WEIGHT 100
+//The virtual time a queue advances per job is SCHEDULER_STRIDE / weight
+#define SCHEDULER_STRIDE 1000000
+
+using namespace std;
+
+class WorkerPool;
+
+/**
+ * @class JobQueue
+ *
+ * @brief A queue of jobs that get executed by a WorkerPool
+ *
+ * A JobQueue collects the jobs of one client, usually a Batch.
+ * The jobs are executed by the threads of the WorkerPool that
+ * created the queue. No more than maxParallel jobs of one queue
+ * are running at the same time.
+ *
+ * If maxQueued is set, submit blocks while maxQueued jobs are waiting,
+ * so a producer can not get far ahead of the threads executing its jobs.
+ *
+ * The weight of a queue sets its share of the threads of the pool, while
+ * other queues have jobs waiting. The number of waiting jobs and the time
+ * jobs wait for a thread are recorded in the Statistics of the queue.
+ *
+ * Once the deadline of a queue passed, its waiting jobs are dropped instead
+ * of being executed, and further submitted jobs are dropped right away.
+ */
+class JobQueue {
+	friend class WorkerPool;
+
+public:
+	struct Statistics {
+		size_t queuedJobs;
+		size_t peakQueuedJobs;
+		unsigned long long executedJobs;
+		unsigned long long droppedJobs;
+		chrono::microseconds totalWaitTime;
+		chrono::microseconds maxWaitTime;
+	};
+
+private:
+	struct QueuedJob {
+		function<void()> job;
+		chrono::steady_clock::time_point submitted;
+	};
+
+	WorkerPool& pool;
+	const unsigned int maxParallel;
+	const unsigned int maxQueued;
+	const unsigned int weight;
+	deque<QueuedJob> jobs;
+	unsigned int running;
+	bool active;
+	//The virtual time of this queue, the queue with the lowest one runs next
+	unsigned long long pass;
+	chrono::steady_clock::time_point deadline;
+	Statistics statistics;
+	condition_variable finished;
+	condition_variable jobTaken;
+
+public:
+	/** @brief Constructor that creates a JobQueue
+    * @param [in] pool is the WorkerPool executing the jobs of this queue
+    * @param [in] maxParallel a int specifying the maximum number of jobs of this queue running in parallel
+    * @param [in] maxQueued a int specifying the maximum number of waiting jobs, 0 for no limit
+    * @param [in] weight a int between 1 and MAX_QUEUE_WEIGHT specifying the share of the pool this queue gets
+    * @return A pointer to the created JobQueue
+    *
+    * Use WorkerPool::createQueue instead of calling this directly.
+    */
+	JobQueue(WorkerPool& pool, unsigned int maxParallel, unsigned int maxQueued = 0, unsigned int weight = DEFAULT_QUEUE_WEIGHT);
+
+	/** @brief Destructor that waits for the remaining jobs
+    *
+    * This method waits until all jobs of this queue are finished.
+    */
+	~JobQueue();
+
+	/** @brief Adds a job to this queue
+    * @param [in] job a function that will be executed by the WorkerPool
+    * @param [in] wait a bool specifying whether to wait, while the queue is full
+    *
+    * The job is executed by one of the threads of the WorkerPool.
+    * The job must not throw, exceptions escaping from it are logged and dropped.
+    * Jobs, that submit further jobs to their own queue, must not wait, because
+    * all threads could be blocked by a full queue.
+    */
+	void submit(function<void()> job, bool wait = true);
+
+	/** @brief Waits until every submitted job is finished
+    *
+    * Blocks until the queue is empty and no job of this queue is running.
+    */
+	void wait();
+
+	/** @brief Sets the time after which the jobs of this queue are dropped
+    * @param [in] deadline the time after which waiting jobs are not executed anymore
+    *
+    * Jobs, that are already running at the deadline, are not interrupted.
+    */
+	void setDeadline(chrono::steady_clock::time_point deadline);
+
+	/** @brief Returns the statistics of this queue
+    * @return The current and peak number of waiting jobs, the number of executed and dropped jobs and the wait times
+    */
+	Statistics getStatistics() const;
+};
+
+/**
+ * @class WorkerPool
+ *
+ * @brief A pool of threads that executes the jobs of all batches
+ *
+ * A WorkerPool owns a fixed number of threads. Jobs are submitted
+ * into JobQueues created by the pool. Free threads take the next job
+ * from the queues with stride scheduling: Every queue has a virtual time,
+ * that advances by SCHEDULER_STRIDE / weight per started job, and the
+ * queue with the lowest virtual time runs next. So queues with equal
+ * weights take turns, regardless of how many jobs the other queues contain,
+ * and a queue with twice the weight starts twice as many jobs.
+ * A queue, that becomes active, starts at the current virtual time of the
+ * pool, so queues can not save up turns while they are idle.
+ *
+ * The waiting jobs of all queues, their wait times and the dropped jobs are
+ * recorded in the process wide Metrics.
+ *
+ * The process wide pool returned by get() has Configuration::maxWorkers threads.
+ */
+class WorkerPool {
+	friend class JobQueue;
+
+private:
+	mutex poolMutex;
+	condition_variable jobAvailable;
+	vector<thread> threads;
+	vector<JobQueue*> activeQueues;
+	//The virtual time of the queue that started the last job
+	unsigned long long virtualTime;
+	bool stopping;
+	Metrics::Gauge& queuedJobs;
+	Metrics::Histogram& waitSeconds;
+	Metrics::Counter& droppedJobs;
+
+	/** @brief The main loop of the threads of the pool
+    *
+    * Takes jobs from the queues and executes them until the pool gets destroyed.
+    */
+	void work();
+
+	/** @brief Selects the queue that gets to run its next job
+    * @return A pointer to the selected JobQueue or nullptr if no queue has a runnable job
+    *
+    * Returns the queue with the lowest virtual time, that has jobs left and is
+    * below its limit of parallel jobs. Of queues with equal virtual times, the
+    * one that became active first is selected.
+    * poolMutex must be held by the caller.
+    */
+	JobQueue* selectQueue();
+
+public:
+	/** @brief Constructor that creates a WorkerPool
+    * @param [in] workers a int specifying the number of threads of the pool
+    * @return A pointer to the created WorkerPool
+    *
+    * This method creates a WorkerPool and starts its threads.
+    * At least one thread is started.
+    */
+	WorkerPool(unsigned int workers);
+
+	/** @brief Destructor that stops the threads of the pool
+    *
+    * Jobs that are still queued are not executed.
+    */
+	~WorkerPool();
+
+	/** @brief Returns the process wide WorkerPool
+    * @return A reference to the process wide WorkerPool
+    *
+    * The pool is created on the first call with Configuration::maxWorkers threads.
+    */
+	static WorkerPool& get();
+
+	/** @brief Creates a new JobQueue for this pool
+    * @param [in] maxParallel a int specifying the maximum number of jobs of the queue running in parallel
+    * @param [in] maxQueued a int specifying the maximum number of waiting jobs of the queue, 0 for no limit
+    * @param [in] weight a int between 1 and MAX_QUEUE_WEIGHT specifying the share of the pool the queue gets
+    * @return A shared_ptr to the created JobQueue
+    */
+	shared_ptr<JobQueue> createQueue(unsigned int maxParallel, unsigned int maxQueued = 0, unsigned int weight = DEFAULT_QUEUE_WEIGHT);
+
+	/** @brief Returns the number of threads of this pool
+    * @return The number of threads of this pool
+    */
+	size_t size() const;
+};
+
+#endif
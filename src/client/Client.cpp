@@ -19,6 +19,9 @@ using namespace apache::thrift::transport;
 using namespace ::CertificateGeneratorThrift;
 using namespace std;
 
+//The number of pdfs received at once, limits the memory needed for a response
+#define RESULTS_PER_FETCH 16
+
 int main(int argc, char** argv)
 {
 
@@ -124,7 +127,6 @@ int main(int argc, char** argv)
 	transport->open();
 
 	//Generate certificates
-	std::vector<File> response;
 	std::cout << "Adding resource files" << std::endl;
 	client.addResourceFiles(resourceFiles);
 	std::cout << "Adding template files" << std::endl;
@@ -134,24 +136,29 @@ int main(int argc, char** argv)
 	std::cout << "Checking batch" << std::endl;
 	client.checkJob();
 	std::cout << "Generating certificate" << std::endl;
-	client.generateCertificates(response);
+	string jobId;
+	client.startGeneration(jobId);
+
+	//Write files to disk, as soon as they are generated
+	GenerationResults results;
+	do {
+		client.fetchResults(results, jobId, RESULTS_PER_FETCH);
+		for (const File& file : results.files) {
+			string outputFile = outputDirectory;
+			outputFile.append("/").append(file.name);
+			std::cout << "Saving certificate to file " << outputFile << std::endl;
+			ofstream output(outputFile, ios::out | ios::binary);
+			if (!output) {
+				cerr << "Error opening output file" << endl;
+				exit(EXIT_FAILURE);
+			}
+			output << file.content;
+			output.close();
+		}
+	} while (!results.finished);
 
 	//Close thrift connection
 	transport->close();
-
-	//Write files to disk
-	for (File file : response) {
-		string outputFile = outputDirectory;
-		outputFile.append("/").append(file.name);
-		std::cout << "Saving certificate to file " << outputFile << std::endl;
-		ofstream output(outputFile, ios::out | ios::binary);
-		if (!output) {
-			cerr << "Error opening output file" << endl;
-			exit(EXIT_FAILURE);
-		}
-		output << file.content;
-		output.close();
-	}
 	cout << "All done" << endl;
 	return 0;
 }
@@ -1,8 +1,14 @@
 #include "Batch.hpp"
 #include "Certificate.hpp"
+#include "CgroupManager.hpp"
+#include "MemoryDirectory.hpp"
+#include "PdfCache.hpp"
 #include "Student.hpp"
+#include "StudentStream.hpp"
 #include "TemplateCertificate.hpp"
+#include "Trace.hpp"
 #include <cxxopts.hpp>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <nlohmann/json.hpp>
@@ -14,6 +20,29 @@ using namespace std;
 
 cxxopts::ParseResult parse(int argc, char* argv[]);
 
+/**
+ * Removes the directory of the batch in the memory directory, when main returns.
+ * The directory is on a tmpfs, so a leftover directory keeps using memory.
+ */
+class MemoryDirectoryGuard {
+private:
+	const filesystem::path& directory;
+
+public:
+	MemoryDirectoryGuard(const filesystem::path& directory)
+		: directory(directory)
+	{
+	}
+
+	~MemoryDirectoryGuard()
+	{
+		if (!directory.empty()) {
+			error_code ignoreErrors;
+			filesystem::remove_all(directory, ignoreErrors);
+		}
+	}
+};
+
 /**
  * Here the batch configuration is loaded and the batch is checked and executed.
  */
@@ -23,10 +52,14 @@ int main(int argc, char** argv)
 	//Parse options
 	string batchConfigurationFile;
 	string outputFile;
+	string cacheDirectory;
+	string memoryDirectory;
+	string cgroup;
+	string traceDirectory;
 	bool verbose = false;
 	try {
 		cxxopts::Options options(argv[0], "Certificate generator");
-		options.add_options()("c,configuration", "A configuration file", cxxopts::value<string>(), "FILE")("o,output", "Output PDF filename", cxxopts::value<string>()->default_value("certificate.pdf"))("v,verbose", "Enable output", cxxopts::value<bool>(verbose))("h, help", "Print help");
+		options.add_options()("c,configuration", "A configuration file", cxxopts::value<string>(), "FILE")("o,output", "Output PDF filename", cxxopts::value<string>()->default_value("certificate.pdf"))("v,verbose", "Enable output", cxxopts::value<bool>(verbose))("cache-directory", "Cache generated pdfs in this directory", cxxopts::value<string>(cacheDirectory), "DIR")("memory-directory", "Compile in this directory on a tmpfs, like /dev/shm, instead of the working directory", cxxopts::value<string>(memoryDirectory), "DIR")("cgroup", "Run compiler processes in cgroups below this delegated cgroup v2 directory, docker containers are started below them, which requires the cgroupfs cgroup driver", cxxopts::value<string>(cgroup), "DIR")("trace-directory", "Write a Chrome trace of the stages of the batch into this directory", cxxopts::value<string>(traceDirectory), "DIR")("h, help", "Print help");
 		auto result = options.parse(argc, argv);
 		if (result.count("help") || result.arguments().size() == 0) {
 			cout << options.help({ "" }) << std::endl;
@@ -56,38 +89,91 @@ int main(int argc, char** argv)
 	}
 	checkOutput.close();
 
-	//Load batch configuration
+	//Load batch configuration, the students are read while the batch is executed
 	std::cout << "Loading configuration file" << std::endl;
-	ifstream input;
-	input.open(batchConfigurationFile, ios::in);
-	if (!input) {
-		cerr << "Error reading batch config" << endl;
-		exit(EXIT_FAILURE);
-	}
+	StudentStream students = StudentStream::fromFile(batchConfigurationFile);
 	json batchConfiguration;
 	try {
-		batchConfiguration = json::parse(input);
-	} catch (const nlohmann::detail::parse_error& error) {
+		batchConfiguration = students.readConfiguration();
+	} catch (const FileAccessError& error) {
+		cerr << "Error reading batch config" << endl;
+		exit(EXIT_FAILURE);
+	} catch (const InvalidConfigurationError& error) {
 		cerr << "Invalid json in batch config: " << batchConfigurationFile << endl;
 		cerr << error.what() << endl;
 		exit(EXIT_FAILURE);
 	}
-	input.close();
 
-	//Create batch from configuration
-	Batch batch(batchConfiguration);
+	//Every return below removes the directory in the memory directory, so exit must not be called anymore
+	filesystem::path memoryWorkingDirectory;
+	MemoryDirectoryGuard memoryDirectoryGuard(memoryWorkingDirectory);
+	try {
+		//Enable pdf cache
+		if (cacheDirectory != "") {
+			PdfCache::setup(cacheDirectory);
+		}
 
-	//Check batch
-	cout << "Checking Batch" << endl;
-	if (batch.check()) {
-		cout << "Check succeeded" << endl;
-	} else {
-		cerr << "Check failed" << endl;
-		exit(EXIT_FAILURE);
+		//Limit the compiler processes or containers with cgroups
+		if (cgroup != "") {
+			CgroupManager::setup(cgroup);
+		}
+
+		//Write a trace of the batch
+		if (traceDirectory != "") {
+			Trace::setOutputDirectory(traceDirectory);
+		}
+
+		//Compile in memory, the templates and resources are still read from the working directory
+		if (memoryDirectory != "") {
+			MemoryDirectory::setup(memoryDirectory);
+			memoryWorkingDirectory = MemoryDirectory::get()->createDirectory("local-" + to_string(getpid()));
+			if (!memoryWorkingDirectory.empty()) {
+				filesystem::path workingDirectory = batchConfiguration["workingDirectory"].get<string>();
+				for (const char* files : { "templates", "resources" }) {
+					for (json& file : batchConfiguration[files]) {
+						filesystem::path filePath = file.get<string>();
+						if (filePath.is_relative()) {
+							file = filesystem::absolute(workingDirectory / filePath).string();
+						}
+					}
+				}
+				batchConfiguration["workingDirectory"] = memoryWorkingDirectory.string();
+			}
+		}
+	} catch (const GeneratorError& error) {
+		cerr << error.what() << endl;
+		return EXIT_FAILURE;
 	}
 
-	//Execute batch
-	cout << "Executing Batch" << endl;
-	batch.executeBatch();
+	try {
+		//Create batch from configuration
+		Batch batch(batchConfiguration, students);
+
+		//Check batch
+		cout << "Checking Batch" << endl;
+		if (batch.check()) {
+			cout << "Check succeeded" << endl;
+		} else {
+			cerr << "Check failed" << endl;
+			return EXIT_FAILURE;
+		}
+
+		//Execute batch
+		cout << "Executing Batch" << endl;
+		batch.executeBatch();
+	} catch (const LatexExecutionError& error) {
+		cerr << error.what() << endl;
+		if (!error.getRun().logTail.empty()) {
+			cerr << "End of the log of " << error.getRun().certificate << ":" << endl;
+			cerr << error.getRun().logTail << endl;
+		}
+		return EXIT_FAILURE;
+	} catch (const GeneratorError& error) {
+		cerr << error.what() << endl;
+		return EXIT_FAILURE;
+	}
+	if (PdfCache::get() != nullptr) {
+		cout << "Pdf cache hits: " << PdfCache::get()->getHits() << ", misses: " << PdfCache::get()->getMisses() << endl;
+	}
 	cout << "All done" << endl;
 }
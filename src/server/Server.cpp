@@ -3,6 +3,7 @@
 CertificateGeneratorHandler::CertificateGeneratorHandler(const string& id, const string& peerAddress)
 	: id(id)
 	, peerAddress(peerAddress)
+	, generationFinished(false)
 {
 	try {
 
@@ -12,9 +13,19 @@ CertificateGeneratorHandler::CertificateGeneratorHandler(const string& id, const
 		try {
 			filesystem::path outputDirectory = baseConfiguration["outputDirectory"].get<std::string>();
 			outputDirectory.append(id);
-			batchConfiguration["outputDirectory"] = outputDirectory.string();
 			filesystem::path workingDirectory = baseConfiguration["workingDirectory"].get<std::string>();
 			workingDirectory.append(id);
+			//Keep the files of the batch in memory, if there is enough space
+			if (MemoryDirectory::get() != nullptr) {
+				memoryDirectory = MemoryDirectory::get()->createDirectory(id);
+				if (!memoryDirectory.empty()) {
+					outputDirectory = memoryDirectory / "output";
+					workingDirectory = memoryDirectory / "working";
+				} else {
+					spdlog::info("{} memory directory is full, using working directory on disk (ID:{})", peerAddress, id);
+				}
+			}
+			batchConfiguration["outputDirectory"] = outputDirectory.string();
 			batchConfiguration["workingDirectory"] = workingDirectory.string();
 
 			//Create working directory, if it doesn't exist.
@@ -78,10 +89,22 @@ CertificateGeneratorHandler::CertificateGeneratorHandler(const string& id, const
 
 CertificateGeneratorHandler::~CertificateGeneratorHandler()
 {
+	//Stop a batch, whose results are not fetched anymore
+	if (generationThread.joinable()) {
+		batch->cancel();
+		generationThread.join();
+	}
+	//The containers of this batch are not needed anymore
+	if (DockerPool::get() != nullptr) {
+		DockerPool::get()->releaseBatch(batchConfiguration["workingDirectory"].get<std::string>());
+	}
 	if (!keepGeneratedFiles) {
 		try{
 			filesystem::remove_all(batchConfiguration["workingDirectory"].get<std::string>());
 			filesystem::remove_all(batchConfiguration["outputDirectory"].get<std::string>());
+			if (!memoryDirectory.empty()) {
+				filesystem::remove_all(memoryDirectory);
+			}
 		}catch(...){
 			spdlog::info("{} error removing files on destructor (ID:{})", peerAddress, id);
 		}
@@ -89,17 +112,43 @@ CertificateGeneratorHandler::~CertificateGeneratorHandler()
 	spdlog::info("{} disconnected (ID:{})", peerAddress, id);
 }
 
+Metrics::ScopedTimer CertificateGeneratorHandler::measureCall(const string& method) const
+{
+	string labels = "method=\"" + method + "\"";
+	Metrics::Histogram& callSeconds = Metrics::get().histogram("certgen_handler_seconds", "Duration of calls to the certificate generator service", labels);
+	Metrics::Counter& callErrors = Metrics::get().counter("certgen_handler_errors_total", "Calls to the certificate generator service, that failed", labels);
+	return Metrics::ScopedTimer(callSeconds, &callErrors);
+}
+
+void CertificateGeneratorHandler::countReceivedBytes(size_t bytes) const
+{
+	static Metrics::Counter& receivedBytes = Metrics::get().counter("certgen_received_bytes_total", "Bytes of configurations, templates and resources received from clients");
+	receivedBytes.increment(bytes);
+}
+
+void CertificateGeneratorHandler::logQueueStatistics(const JobQueue::Statistics& statistics) const
+{
+	if (statistics.executedJobs == 0) {
+		return;
+	}
+	long long averageWait = chrono::duration_cast<chrono::milliseconds>(statistics.totalWaitTime).count() / (long long)statistics.executedJobs;
+	spdlog::info("{} compiler jobs: {}, peak queue depth: {}, average wait: {}ms, max wait: {}ms (ID:{})", peerAddress, statistics.executedJobs, statistics.peakQueuedJobs, averageWait, chrono::duration_cast<chrono::milliseconds>(statistics.maxWaitTime).count(), id);
+}
+
 void CertificateGeneratorHandler::setConfigurationData(const std::string& configuration)
 {
 	spdlog::info("{} called setConfigurationData (ID:{})", peerAddress, id);
+	Metrics::ScopedTimer timer = measureCall("setConfigurationData");
+	countReceivedBytes(configuration.size());
 	try {
-		//Parse received new configuration
+		//Parse received new configuration, the students are only parsed when a batch is created
+		StudentStream newStudents = StudentStream::fromString(configuration);
 		json newConfiguration;
 		try {
-			newConfiguration = json::parse(configuration);
-		} catch (const nlohmann::detail::parse_error& error) {
+			newConfiguration = newStudents.readConfiguration();
+		} catch (const InvalidConfigurationError& error) {
 			stringstream message;
-			message << "Invalid json in received batch configuration: " << error.what();
+			message << "Invalid received batch configuration: " << error.what();
 			InvalidConfiguration terror;
 			terror.message = message.str();
 			throw terror;
@@ -134,6 +183,13 @@ void CertificateGeneratorHandler::setConfigurationData(const std::string& config
 			terror.message = message.str();
 			throw terror;
 		}
+		if (newConfiguration.contains("priority") && (!newConfiguration["priority"].is_number_unsigned() || newConfiguration["priority"] < 1 || newConfiguration["priority"] > MAX_BATCH_PRIORITY)) {
+			stringstream message;
+			message << "Invalid entry priority in received batch configuration, it has to be between 1 and " << MAX_BATCH_PRIORITY;
+			InvalidConfiguration terror;
+			terror.message = message.str();
+			throw terror;
+		}
 
 		//Add old configuration
 		try {
@@ -150,6 +206,7 @@ void CertificateGeneratorHandler::setConfigurationData(const std::string& config
 		//Replace old configuration with new configuration
 		//TODO thread safty
 		batchConfiguration = newConfiguration;
+		students = newStudents;
 	} catch (const GeneratorError& error) {
 		spdlog::warn("{} failed in setConfigurationData (ID:{}) GeneratorError: {}", peerAddress, id, error.what());
 		InternalServerError terror;
@@ -184,6 +241,8 @@ void CertificateGeneratorHandler::setConfigurationData(const std::string& config
 void CertificateGeneratorHandler::addResourceFile(const File& receivedResourceFile)
 {
 	spdlog::info("{} called addResourceFile (ID:{})", peerAddress, id);
+	Metrics::ScopedTimer timer = measureCall("addResourceFile");
+	countReceivedBytes(receivedResourceFile.content.size());
 	try {
 		//Sanitize filename
 		File resourceFile(receivedResourceFile);
@@ -252,6 +311,8 @@ void CertificateGeneratorHandler::addResourceFile(const File& receivedResourceFi
 void CertificateGeneratorHandler::addTemplateFile(const File& receivedTemplateFile)
 {
 	spdlog::info("{} called addTemplateFile (ID:{})", peerAddress, id);
+	Metrics::ScopedTimer timer = measureCall("addTemplateFile");
+	countReceivedBytes(receivedTemplateFile.content.size());
 	try {
 		File templateFile(receivedTemplateFile);
 		//Sanitize the filename
@@ -309,6 +370,7 @@ void CertificateGeneratorHandler::addTemplateFile(const File& receivedTemplateFi
 
 void CertificateGeneratorHandler::addResourceFiles(const std::vector<File>& resourceFiles)
 {
+	Metrics::ScopedTimer timer = measureCall("addResourceFiles");
 	for (File resourceFile : resourceFiles) {
 		addResourceFile(resourceFile);
 	}
@@ -316,6 +378,7 @@ void CertificateGeneratorHandler::addResourceFiles(const std::vector<File>& reso
 
 void CertificateGeneratorHandler::addTemplateFiles(const std::vector<File>& templateFiles)
 {
+	Metrics::ScopedTimer timer = measureCall("addTemplateFiles");
 	for (File templateFile : templateFiles) {
 		addTemplateFile(templateFile);
 	}
@@ -324,9 +387,10 @@ void CertificateGeneratorHandler::addTemplateFiles(const std::vector<File>& temp
 bool CertificateGeneratorHandler::checkJob()
 {
 	spdlog::info("{} called checkJob (ID:{})", peerAddress, id);
+	Metrics::ScopedTimer timer = measureCall("checkJob");
 	//Create batch
 	try {
-		Batch batch(batchConfiguration);
+		Batch batch(batchConfiguration, students);
 		//Check batch
 		if (batch.check()) {
 			spdlog::debug("{} Check succeeded (ID:{})", peerAddress, id);
@@ -383,9 +447,11 @@ bool CertificateGeneratorHandler::checkJob()
 void CertificateGeneratorHandler::generateCertificates(std::vector<File>& _return)
 {
 	spdlog::info("{} called generateCertificates (ID:{})", peerAddress, id);
+	Metrics::ScopedTimer timer = measureCall("generateCertificates");
 	try {
 		//Create batch
-		Batch batch(batchConfiguration);
+		Batch batch(batchConfiguration, students);
+		batch.setTraceId(id);
 
 		//Execute batch
 		spdlog::trace("{} executing batch (ID:{})", peerAddress, id);
@@ -397,29 +463,29 @@ void CertificateGeneratorHandler::generateCertificates(std::vector<File>& _retur
 			InvalidConfiguration terror;
 			terror.message = message.str();
 			throw terror;
+		} catch (const BatchTimeoutError& error) {
+			//The pdfs generated before the deadline are returned with the error
+			spdlog::warn("{} failed in generateCertificates (ID:{}) BatchTimeoutError: {}", peerAddress, id, error.what());
+			BatchTimeout terror;
+			terror.message = error.what();
+			terror.files = readOutputFiles(batch.getOutputFiles());
+			if (!keepGeneratedFiles) {
+				filesystem::remove_all(batchConfiguration["outputDirectory"].get<std::string>());
+			}
+			throw terror;
 		}
 		spdlog::trace("{} generation done (ID:{})", peerAddress, id);
+		logQueueStatistics(batch.getQueueStatistics());
+		if (PdfCache::get() != nullptr) {
+			spdlog::info("{} pdf cache hits: {}, misses: {}, size: {} bytes (ID:{})", peerAddress, PdfCache::get()->getHits(), PdfCache::get()->getMisses(), PdfCache::get()->getSize(), id);
+		}
+		if (!memoryDirectory.empty()) {
+			spdlog::debug("{} memory directory usage: {} bytes (ID:{})", peerAddress, MemoryDirectory::get()->getUsage(), id);
+		}
 
 		//Returning results
 		spdlog::trace("{} returning results (ID:{})", peerAddress, id);
-		vector<File> generatedFiles;
-		for (string outputFile : batch.getOutputFiles()) {
-			File file;
-			file.name = filesystem::path(outputFile).filename();
-			stringstream content;
-			ifstream pdfFile(outputFile, ios::in | ios::binary);
-			if (!pdfFile) {
-				InvalidConfiguration thriftError;
-				thriftError.message = "Failed to open output file";
-				throw thriftError;
-			}
-			//TODO pdfFile >> file.content;  ?
-			content << pdfFile.rdbuf();
-			pdfFile.close();
-			file.content = content.str();
-			generatedFiles.push_back(file);
-		}
-		_return = generatedFiles;
+		_return = readOutputFiles(batch.getOutputFiles());
 
 		//Removing files
 		spdlog::trace("{} Cleaning files (ID:{})", peerAddress, id);
@@ -440,6 +506,9 @@ void CertificateGeneratorHandler::generateCertificates(std::vector<File>& _retur
 		InvalidTemplate terror;
 		terror.message = message.str();
 		throw terror;
+	} catch (const LatexExecutionError& error) {
+		spdlog::warn("{} failed in generateCertificates (ID:{}) LatexExecutionError: {}", peerAddress, id, error.what());
+		throw createCompilationFailed(error);
 	} catch (const GeneratorError& error) {
 		spdlog::warn("{} failed in generateCertificates (ID:{}) GeneratorError: {}", peerAddress, id, error.what());
 		InternalServerError terror;
@@ -471,6 +540,282 @@ void CertificateGeneratorHandler::generateCertificates(std::vector<File>& _retur
 	}
 }
 
+void CertificateGeneratorHandler::startGeneration(std::string& _return)
+{
+	spdlog::info("{} called startGeneration (ID:{})", peerAddress, id);
+	Metrics::ScopedTimer timer = measureCall("startGeneration");
+	try {
+		if (batch) {
+			InvalidJob terror;
+			terror.message = "Generation was already started";
+			throw terror;
+		}
+
+		//Create batch, the pdfs are collected as soon as they are generated
+		batch = make_unique<Batch>(batchConfiguration, students);
+		batch->setTraceId(id);
+		batch->setOutputCallback([this](const string& outputFile) {
+			unique_lock<mutex> lock(resultsMutex);
+			pendingResults.push_back(outputFile);
+			resultsAvailable.notify_all();
+		});
+
+		//Execute batch in the background
+		spdlog::trace("{} executing batch (ID:{})", peerAddress, id);
+		generationThread = thread([this]() {
+			exception_ptr error;
+			try {
+				batch->executeBatch();
+			} catch (...) {
+				error = current_exception();
+			}
+			spdlog::trace("{} generation done (ID:{})", peerAddress, id);
+			logQueueStatistics(batch->getQueueStatistics());
+			if (PdfCache::get() != nullptr) {
+				spdlog::info("{} pdf cache hits: {}, misses: {}, size: {} bytes (ID:{})", peerAddress, PdfCache::get()->getHits(), PdfCache::get()->getMisses(), PdfCache::get()->getSize(), id);
+			}
+			if (!memoryDirectory.empty()) {
+				spdlog::debug("{} memory directory usage: {} bytes (ID:{})", peerAddress, MemoryDirectory::get()->getUsage(), id);
+			}
+			unique_lock<mutex> lock(resultsMutex);
+			generationError = error;
+			generationFinished = true;
+			resultsAvailable.notify_all();
+		});
+		_return = id;
+	} catch (const InvalidConfigurationError& error) {
+		spdlog::warn("{} failed in startGeneration (ID:{}) InvalidConfigurationError: {}", peerAddress, id, error.what());
+		spdlog::debug("Invalid configuration: {}", error.what());
+		InvalidConfiguration terror;
+		terror.message = error.what();
+		throw terror;
+	} catch (const InvalidTemplateError& error) {
+		spdlog::warn("{} failed in startGeneration (ID:{}) InvalidTemplateError: {}", peerAddress, id, error.what());
+		spdlog::debug("Invalid template: {}", error.what());
+		InvalidTemplate terror;
+		terror.message = error.what();
+		throw terror;
+	} catch (const GeneratorError& error) {
+		spdlog::warn("{} failed in startGeneration (ID:{}) GeneratorError: {}", peerAddress, id, error.what());
+		InternalServerError terror;
+		terror.message = "Internal server error, try again later.";
+		throw terror;
+	} catch (const TException& error) {
+		spdlog::warn("{} failed in startGeneration (ID:{}) ThriftException: {}", peerAddress, id, error.what());
+		throw;
+	} catch (const exception& error) {
+		if (dontCrash) {
+			spdlog::error("{} failed in startGeneration (ID:{}) Unhandled exception ignored, because of --dont-crash: {}", peerAddress, id, error.what());
+			InternalServerError terror;
+			terror.message = "Internal server error, try again later.";
+			throw terror;
+		} else {
+			spdlog::critical("{} failed in startGeneration (ID:{}) Unhandled exception: {}", peerAddress, id, error.what());
+			throw;
+		}
+	} catch (...) {
+		if (dontCrash) {
+			spdlog::error("{} failed in startGeneration (ID:{}) Unhandled error ignored, because of --dont-crash", peerAddress, id);
+			InternalServerError terror;
+			terror.message = "Internal server error, try again later.";
+			throw terror;
+		} else {
+			spdlog::critical("{} failed in startGeneration (ID:{}) Unhandled error", peerAddress, id);
+			throw;
+		}
+	}
+}
+
+void CertificateGeneratorHandler::fetchResults(GenerationResults& _return, const std::string& jobId, const int32_t maxFiles)
+{
+	spdlog::debug("{} called fetchResults (ID:{})", peerAddress, id);
+	Metrics::ScopedTimer timer = measureCall("fetchResults");
+	try {
+		takeResults(_return, jobId, maxFiles, true);
+	} catch (const InvalidConfigurationError& error) {
+		spdlog::warn("{} failed in fetchResults (ID:{}) InvalidConfigurationError: {}", peerAddress, id, error.what());
+		spdlog::debug("Invalid configuration: {}", error.what());
+		InvalidConfiguration terror;
+		terror.message = error.what();
+		throw terror;
+	} catch (const InvalidTemplateError& error) {
+		spdlog::warn("{} failed in fetchResults (ID:{}) InvalidTemplateError: {}", peerAddress, id, error.what());
+		spdlog::debug("Invalid template: {}", error.what());
+		InvalidTemplate terror;
+		terror.message = error.what();
+		throw terror;
+	} catch (const BatchTimeoutError& error) {
+		spdlog::warn("{} failed in fetchResults (ID:{}) BatchTimeoutError: {}", peerAddress, id, error.what());
+		BatchTimeout terror;
+		terror.message = error.what();
+		throw terror;
+	} catch (const LatexExecutionError& error) {
+		spdlog::warn("{} failed in fetchResults (ID:{}) LatexExecutionError: {}", peerAddress, id, error.what());
+		throw createCompilationFailed(error);
+	} catch (const GeneratorError& error) {
+		spdlog::warn("{} failed in fetchResults (ID:{}) GeneratorError: {}", peerAddress, id, error.what());
+		InternalServerError terror;
+		terror.message = "Internal server error, try again later.";
+		throw terror;
+	} catch (const TException& error) {
+		spdlog::warn("{} failed in fetchResults (ID:{}) ThriftException: {}", peerAddress, id, error.what());
+		throw;
+	} catch (const exception& error) {
+		if (dontCrash) {
+			spdlog::error("{} failed in fetchResults (ID:{}) Unhandled exception ignored, because of --dont-crash: {}", peerAddress, id, error.what());
+			InternalServerError terror;
+			terror.message = "Internal server error, try again later.";
+			throw terror;
+		} else {
+			spdlog::critical("{} failed in fetchResults (ID:{}) Unhandled exception: {}", peerAddress, id, error.what());
+			throw;
+		}
+	} catch (...) {
+		if (dontCrash) {
+			spdlog::error("{} failed in fetchResults (ID:{}) Unhandled error ignored, because of --dont-crash", peerAddress, id);
+			InternalServerError terror;
+			terror.message = "Internal server error, try again later.";
+			throw terror;
+		} else {
+			spdlog::critical("{} failed in fetchResults (ID:{}) Unhandled error", peerAddress, id);
+			throw;
+		}
+	}
+}
+
+void CertificateGeneratorHandler::pollResults(GenerationResults& _return, const std::string& jobId, const int32_t maxFiles)
+{
+	spdlog::debug("{} called pollResults (ID:{})", peerAddress, id);
+	Metrics::ScopedTimer timer = measureCall("pollResults");
+	try {
+		takeResults(_return, jobId, maxFiles, false);
+	} catch (const InvalidConfigurationError& error) {
+		spdlog::warn("{} failed in pollResults (ID:{}) InvalidConfigurationError: {}", peerAddress, id, error.what());
+		spdlog::debug("Invalid configuration: {}", error.what());
+		InvalidConfiguration terror;
+		terror.message = error.what();
+		throw terror;
+	} catch (const InvalidTemplateError& error) {
+		spdlog::warn("{} failed in pollResults (ID:{}) InvalidTemplateError: {}", peerAddress, id, error.what());
+		spdlog::debug("Invalid template: {}", error.what());
+		InvalidTemplate terror;
+		terror.message = error.what();
+		throw terror;
+	} catch (const BatchTimeoutError& error) {
+		spdlog::warn("{} failed in pollResults (ID:{}) BatchTimeoutError: {}", peerAddress, id, error.what());
+		BatchTimeout terror;
+		terror.message = error.what();
+		throw terror;
+	} catch (const LatexExecutionError& error) {
+		spdlog::warn("{} failed in pollResults (ID:{}) LatexExecutionError: {}", peerAddress, id, error.what());
+		throw createCompilationFailed(error);
+	} catch (const GeneratorError& error) {
+		spdlog::warn("{} failed in pollResults (ID:{}) GeneratorError: {}", peerAddress, id, error.what());
+		InternalServerError terror;
+		terror.message = "Internal server error, try again later.";
+		throw terror;
+	} catch (const TException& error) {
+		spdlog::warn("{} failed in pollResults (ID:{}) ThriftException: {}", peerAddress, id, error.what());
+		throw;
+	} catch (const exception& error) {
+		if (dontCrash) {
+			spdlog::error("{} failed in pollResults (ID:{}) Unhandled exception ignored, because of --dont-crash: {}", peerAddress, id, error.what());
+			InternalServerError terror;
+			terror.message = "Internal server error, try again later.";
+			throw terror;
+		} else {
+			spdlog::critical("{} failed in pollResults (ID:{}) Unhandled exception: {}", peerAddress, id, error.what());
+			throw;
+		}
+	} catch (...) {
+		if (dontCrash) {
+			spdlog::error("{} failed in pollResults (ID:{}) Unhandled error ignored, because of --dont-crash", peerAddress, id);
+			InternalServerError terror;
+			terror.message = "Internal server error, try again later.";
+			throw terror;
+		} else {
+			spdlog::critical("{} failed in pollResults (ID:{}) Unhandled error", peerAddress, id);
+			throw;
+		}
+	}
+}
+
+void CertificateGeneratorHandler::takeResults(GenerationResults& _return, const string& jobId, int32_t maxFiles, bool wait)
+{
+	if (!batch || jobId != id) {
+		InvalidJob terror;
+		terror.message = "No generation was started with this job id";
+		throw terror;
+	}
+
+	unique_lock<mutex> lock(resultsMutex);
+	if (wait) {
+		resultsAvailable.wait(lock, [this]() { return !pendingResults.empty() || generationFinished; });
+	}
+	size_t count = pendingResults.size();
+	if (maxFiles > 0) {
+		count = min(count, (size_t)maxFiles);
+	}
+	vector<string> outputFiles(pendingResults.begin(), pendingResults.begin() + count);
+	pendingResults.erase(pendingResults.begin(), pendingResults.begin() + count);
+	bool drained = generationFinished && pendingResults.empty();
+	exception_ptr error = generationError;
+	lock.unlock();
+
+	//The error of a failed batch is thrown after its generated pdfs were returned
+	if (drained && error && outputFiles.empty()) {
+		rethrow_exception(error);
+	}
+	_return.files = readOutputFiles(outputFiles);
+	_return.finished = drained && !error;
+	spdlog::trace("{} returning {} results (ID:{})", peerAddress, _return.files.size(), id);
+}
+
+vector<File> CertificateGeneratorHandler::readOutputFiles(const vector<string>& outputFiles) const
+{
+	static Metrics::Counter& sentBytes = Metrics::get().counter("certgen_sent_bytes_total", "Bytes of pdf files sent to clients");
+	vector<File> generatedFiles;
+	for (const string& outputFile : outputFiles) {
+		File file;
+		file.name = filesystem::path(outputFile).filename();
+		stringstream content;
+		ifstream pdfFile(outputFile, ios::in | ios::binary);
+		if (!pdfFile) {
+			InvalidConfiguration thriftError;
+			thriftError.message = "Failed to open output file";
+			throw thriftError;
+		}
+		content << pdfFile.rdbuf();
+		pdfFile.close();
+		file.content = content.str();
+		sentBytes.increment(file.content.size());
+		generatedFiles.push_back(file);
+		if (!keepGeneratedFiles) {
+			error_code ignoreErrors;
+			filesystem::remove(outputFile, ignoreErrors);
+		}
+	}
+	return generatedFiles;
+}
+
+CompilationFailed CertificateGeneratorHandler::createCompilationFailed(const LatexExecutionError& error)
+{
+	const CompilerRun& run = error.getRun();
+	CompilationFailed terror;
+	terror.message = error.what();
+	terror.certificate = run.certificate;
+	terror.exitCode = run.exitCode;
+	terror.passes = run.passes;
+	terror.wallTimeMs = chrono::duration_cast<chrono::milliseconds>(run.wallTime).count();
+	//The usage of compilers in docker containers is not measured
+	if (run.measured) {
+		terror.cpuTimeMs = chrono::duration_cast<chrono::milliseconds>(run.cpuTime).count();
+		terror.peakMemory = run.peakMemory;
+	}
+	terror.logTail = run.logTail;
+	return terror;
+}
+
 bool CertificateGeneratorHandler::sanitizeFilename(string& filename)
 {
 	bool validName = true;
@@ -555,6 +900,18 @@ int main(int argc, char** argv)
 	int workerTimeout;
 	int batchTimeout;
 	int maxWorkers;
+	bool precompilePreamble;
+	int maxLatexPasses;
+	bool warmContainers;
+	int containerJobs;
+	string memoryDirectory;
+	uint64_t memoryDirectoryAdmissionLimit;
+	string cgroup;
+	string cacheDirectory;
+	uint64_t cacheSize;
+	int metricsPort;
+	string metricsAddress;
+	string traceDirectory;
 
 	spdlog::level::level_enum logLevel = spdlog::level::info;
 	spdlog::level::level_enum logfileLevel = spdlog::level::info;
@@ -568,11 +925,13 @@ int main(int argc, char** argv)
 			//("w,working-dir", "The working directory", cxxopts::value<string>(), "PATH")
 			//("o,output-dir", "The output directory", cxxopts::value<string>(), "PATH")
 			("p,port", "The port on which the server listens", cxxopts::value<int>())("k,keep-files", "Keep generated files", cxxopts::value<bool>(keepGeneratedFiles))("dont-crash", "Catch all exceptions inside handlers", cxxopts::value<bool>(dontCrash))("help", "Print help");
-		options.add_options("Resource managment")("use-docker", "Each compiler process runs in its own docker container", cxxopts::value<bool>(docker)->default_value(MTOS(DEFAULT_DOCKER))->implicit_value("true"))("use-threads", "Multiple compiler processes/containers run in parallel", cxxopts::value<bool>(useThreads)->default_value(MTOS(DEFAULT_USE_THREAD))->implicit_value("true"))("max-batch-compilers", "Maximum number of parallel compiler processes/containers per batch", cxxopts::value<int>(maxWorkersPerBatch)->default_value(MTOS(DEFAULT_MAX_BATCH_WORKERS)), "INT")("max-compilers", "Maximum number of parallel compiler processes/containers", cxxopts::value<int>(maxWorkers)->default_value(MTOS(DEFAULT_MAX_WORKERS)), "INT")("max-compiler-memory", "Maximum memory per compiler process/container", cxxopts::value<int>(maxMemoryPerWorker)->default_value(MTOS(DEFAULT_MAX_MEMORY)), "BYTES")("max-compiler-cpu-time", "Maximum cpu time per compiler process, ignored if --use-docker is set", cxxopts::value<int>(maxCpuTimePerWorker)->default_value(MTOS(DEFAULT_MAX_CPU)), "SECONDS")("compiler-timeout", "Timeout after which compiler processes/containers are killed", cxxopts::value<int>(workerTimeout)->default_value(MTOS(DEFAULT_WORKER_TIMEOUT)), "SECONDS")("batch-timeout", "Timeout after which a batch is killed, not implemented yet", cxxopts::value<int>(batchTimeout)->default_value(MTOS(DEFAULT_TIMEOUT)), "SECONDS");
+		options.add_options("Resource managment")("use-docker", "Each compiler process runs in its own docker container", cxxopts::value<bool>(docker)->default_value(MTOS(DEFAULT_DOCKER))->implicit_value("true"))("use-threads", "Multiple compiler processes/containers run in parallel", cxxopts::value<bool>(useThreads)->default_value(MTOS(DEFAULT_USE_THREAD))->implicit_value("true"))("max-batch-compilers", "Maximum number of parallel compiler processes/containers per batch", cxxopts::value<int>(maxWorkersPerBatch)->default_value(MTOS(DEFAULT_MAX_BATCH_WORKERS)), "INT")("max-compilers", "Maximum number of parallel compiler processes/containers", cxxopts::value<int>(maxWorkers)->default_value(MTOS(DEFAULT_MAX_WORKERS)), "INT")("max-compiler-memory", "Maximum memory per compiler process/container", cxxopts::value<int>(maxMemoryPerWorker)->default_value(MTOS(DEFAULT_MAX_MEMORY)), "BYTES")("max-compiler-cpu-time", "Maximum cpu time per compiler process, ignored if --use-docker is set", cxxopts::value<int>(maxCpuTimePerWorker)->default_value(MTOS(DEFAULT_MAX_CPU)), "SECONDS")("compiler-timeout", "Timeout after which compiler processes/containers are killed", cxxopts::value<int>(workerTimeout)->default_value(MTOS(DEFAULT_WORKER_TIMEOUT)), "SECONDS")("batch-timeout", "Timeout after which a batch is terminated, the pdfs generated until then are still returned by fetchResults, 0 for no timeout", cxxopts::value<int>(batchTimeout)->default_value(MTOS(DEFAULT_TIMEOUT)), "SECONDS")("precompile-preamble", "Precompile the static preamble of each template into a format file once per batch", cxxopts::value<bool>(precompilePreamble)->default_value(MTOS(DEFAULT_PRECOMPILE_PREAMBLE))->implicit_value("true"))("max-latex-passes", "Maximum number of times latex is run for a document, it is only run again if it requests a rerun", cxxopts::value<int>(maxLatexPasses)->default_value(MTOS(DEFAULT_MAX_LATEX_PASSES)), "INT")("warm-containers", "Compiler processes of a batch run in a pool of running containers, that only mount the files of that batch, instead of a new container each, ignored if --use-docker is not set", cxxopts::value<bool>(warmContainers)->default_value(MTOS(DEFAULT_WARM_CONTAINERS))->implicit_value("true"))("container-jobs", "Number of compiler processes after which a pooled container is replaced", cxxopts::value<int>(containerJobs)->default_value(MTOS(DEFAULT_CONTAINER_JOBS)), "INT")("memory-directory", "Place the files of batches in this directory on a tmpfs, like /dev/shm, instead of the working directory", cxxopts::value<string>(memoryDirectory), "DIR")("memory-directory-admission-limit", "New batches only use the memory directory while its files use less than this size, it is only checked when a batch starts, so running batches may exceed it", cxxopts::value<uint64_t>(memoryDirectoryAdmissionLimit)->default_value(MTOS(DEFAULT_MEMORY_DIRECTORY_ADMISSION_LIMIT)), "BYTES")("cgroup", "Run compiler processes in cgroups below this delegated cgroup v2 directory, limiting their memory, cpu and processes, docker containers are started below them, which requires the cgroupfs cgroup driver", cxxopts::value<string>(cgroup), "DIR");
+		options.add_options("Metrics")("metrics-port", "Serve metrics in the Prometheus text format over http on this port, disabled if 0", cxxopts::value<int>(metricsPort)->default_value("0"), "PORT")("metrics-address", "The IPv4 address on which metrics are served", cxxopts::value<string>(metricsAddress)->default_value("127.0.0.1"), "ADDRESS")("trace-directory", "Write a Chrome trace of the stages of every batch into this directory", cxxopts::value<string>(traceDirectory), "DIR");
+		options.add_options("Cache")("cache-directory", "Cache generated pdfs in this directory, disabled if not set", cxxopts::value<string>(cacheDirectory), "DIR")("cache-size", "Maximum size of all cached pdfs, least recently used pdfs are removed first", cxxopts::value<uint64_t>(cacheSize)->default_value(MTOS(DEFAULT_CACHE_SIZE)), "BYTES");
 		options.add_options("Logging")("d,debug", "Output information, errors and debug messages", cxxopts::value<bool>())("i,info", "Output information and errors", cxxopts::value<bool>()->default_value("true"))("e,error", "Output only errors", cxxopts::value<bool>())("q,quiet", "Output nothing", cxxopts::value<bool>())("log-directory", "Write logfiles into this directory", cxxopts::value<string>(logfileDirectory), "DIR")("log-debug", "Output debug messages, information and errors to logfiles", cxxopts::value<bool>())("log-info", "Output information and errors", cxxopts::value<bool>()->default_value("true"))("log-error", "Output only errors", cxxopts::value<bool>())("log-quiet", "Output nothing", cxxopts::value<bool>());
 		auto result = options.parse(argc, argv);
 		if (result.count("help") || result.arguments().size() == 0) {
-			cout << options.help({ "", "Resource managment", "Logging" }) << std::endl;
+			cout << options.help({ "", "Resource managment", "Metrics", "Cache", "Logging" }) << std::endl;
 			exit(EXIT_SUCCESS);
 		}
 		if (result.count("configuration")) {
@@ -600,12 +959,18 @@ int main(int argc, char** argv)
 		if (result.count("compiler-timeout") && workerTimeout < 0) {
 			throw cxxopts::OptionException("Invalid timeout per compiler process/container specified");
 		}
+		if (metricsPort < 0 || metricsPort > 65535) {
+			throw cxxopts::OptionException("Invalid metrics port specified");
+		}
 		if (result.count("batch-timeout") && batchTimeout < 0) {
 			throw cxxopts::OptionException("Invalid timeout per batch specified");
 		}
 		if (result.count("max-compilers") && maxWorkers <= 0) {
 			throw cxxopts::OptionException("Invalid number of parallel compiler processes/containers specified");
 		}
+		if (result.count("container-jobs") && containerJobs <= 0) {
+			throw cxxopts::OptionException("Invalid number of compiler processes per pooled container specified");
+		}
 		if (result.count("quiet") && result["quiet"].as<bool>()) {
 			logLevel = spdlog::level::off;
 		}
@@ -663,7 +1028,18 @@ int main(int argc, char** argv)
 
 	//Set configuration
 	spdlog::debug("Setting configuration");
-	Configuration::setup(docker, useThreads, maxWorkersPerBatch, maxMemoryPerWorker, maxCpuTimePerWorker, workerTimeout, batchTimeout, maxWorkers);
+	Configuration::setup(docker, useThreads, maxWorkersPerBatch, maxMemoryPerWorker, maxCpuTimePerWorker, workerTimeout, batchTimeout, maxWorkers, precompilePreamble, max(maxLatexPasses, 1));
+
+	//Enable pdf cache
+	if (cacheDirectory != "") {
+		spdlog::debug("Enabling pdf cache");
+		try {
+			PdfCache::setup(cacheDirectory, cacheSize);
+		} catch (const GeneratorError& error) {
+			spdlog::critical("Cannot access pdf cache directory: {}", error.what());
+			exit(EXIT_FAILURE);
+		}
+	}
 
 	//Load batch configuration
 	spdlog::debug("Loading base configuration");
@@ -696,6 +1072,83 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+	//Enable memory directory
+	if (memoryDirectory != "") {
+		spdlog::debug("Enabling memory directory");
+		try {
+			MemoryDirectory::setup(memoryDirectory, memoryDirectoryAdmissionLimit);
+		} catch (const GeneratorError& error) {
+			spdlog::critical("Cannot access memory directory: {}", error.what());
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	//Enable cgroups, for compiler processes or containers
+	if (cgroup != "") {
+		spdlog::debug("Enabling cgroups");
+		try {
+			CgroupManager::setup(cgroup);
+		} catch (const GeneratorError& error) {
+			spdlog::critical("Cannot use cgroup: {}", error.what());
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	//Enable traces
+	if (traceDirectory != "") {
+		spdlog::debug("Enabling traces");
+		try {
+			Trace::setOutputDirectory(traceDirectory);
+		} catch (const GeneratorError& error) {
+			spdlog::critical("Cannot access trace directory: {}", error.what());
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	//Enable container pool, the containers are started for the batches using them
+	if (docker && warmContainers) {
+		spdlog::debug("Enabling container pool");
+		try {
+			//The containers can only be used for batches below the mounted directory
+			filesystem::path baseWorkingDirectory = baseConfiguration["workingDirectory"].get<std::string>();
+			if (MemoryDirectory::get() != nullptr) {
+				baseWorkingDirectory = MemoryDirectory::get()->getPath();
+			}
+			filesystem::create_directories(baseWorkingDirectory);
+			DockerPool::setup(baseWorkingDirectory, maxWorkers, containerJobs);
+		} catch (const GeneratorError& error) {
+			spdlog::critical("Cannot start container pool: {}", error.what());
+			exit(EXIT_FAILURE);
+		} catch (const filesystem::filesystem_error& error) {
+			spdlog::critical("Cannot create working directory: {}", error.what());
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	//Start metrics endpoint
+	unique_ptr<MetricsEndpoint> metricsEndpoint;
+	if (metricsPort != 0) {
+		spdlog::debug("Starting metrics endpoint");
+		Metrics& metrics = Metrics::get();
+		metrics.callback("certgen_compiler_launches_total", "counter", "Compiler processes started", []() { return ProcessLauncher::getLaunches(); });
+		metrics.callback("certgen_compiler_launch_seconds_total", "counter", "Time spent starting compiler processes", []() { return chrono::duration<double>(ProcessLauncher::getLaunchTime()).count(); });
+		if (PdfCache::get() != nullptr) {
+			metrics.callback("certgen_pdf_cache_hits_total", "counter", "Pdfs taken from the pdf cache", []() { return PdfCache::get()->getHits(); });
+			metrics.callback("certgen_pdf_cache_misses_total", "counter", "Pdfs not found in the pdf cache", []() { return PdfCache::get()->getMisses(); });
+			metrics.callback("certgen_pdf_cache_bytes", "gauge", "Size of all pdfs in the pdf cache", []() { return PdfCache::get()->getSize(); });
+		}
+		if (MemoryDirectory::get() != nullptr) {
+			metrics.callback("certgen_memory_directory_bytes", "gauge", "Size of all files in the memory directory", []() { return MemoryDirectory::get()->getUsage(); });
+		}
+		try {
+			metricsEndpoint = make_unique<MetricsEndpoint>(metrics, metricsPort, metricsAddress);
+		} catch (const GeneratorError& error) {
+			spdlog::critical("Cannot start metrics endpoint: {}", error.what());
+			exit(EXIT_FAILURE);
+		}
+		spdlog::info("Serving metrics on http://{}:{}/metrics", metricsAddress, metricsEndpoint->getPort());
+	}
+
 	//Initialize thrift server
 	int port = serverPort;
 	::std::shared_ptr<CertificateGeneratorProcessorFactory> processorFactory(std::make_shared<CertificateGeneratorProcessorFactory>(std::make_shared<CertificateGeneratorCloneFactory>()));
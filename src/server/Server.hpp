@@ -3,18 +3,32 @@
 
 #include "Batch.hpp"
 #include "Certificate.hpp"
+#include "CgroupManager.hpp"
+#include "DockerPool.hpp"
 #include "Exceptions.hpp"
+#include "MemoryDirectory.hpp"
+#include "Metrics.hpp"
+#include "MetricsEndpoint.hpp"
+#include "PdfCache.hpp"
 #include "Student.hpp"
+#include "StudentStream.hpp"
 #include "TemplateCertificate.hpp"
+#include "Trace.hpp"
 #include <ctime>
+#include <condition_variable>
 #include <cxxopts.hpp>
+#include <deque>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #include <thrift/TToString.h>
 #include <thrift/concurrency/ThreadManager.h>
@@ -55,6 +69,60 @@ private:
 	string id;
 	string peerAddress;
 	json batchConfiguration;
+	//The students are read from the received configuration, when a batch is created
+	StudentStream students;
+	//The directory in the MemoryDirectory containing the working and output directory, empty if they are on disk
+	filesystem::path memoryDirectory;
+	//The batch started by startGeneration, its results are fetched while it is executing
+	unique_ptr<Batch> batch;
+	thread generationThread;
+	mutex resultsMutex;
+	condition_variable resultsAvailable;
+	deque<string> pendingResults;
+	bool generationFinished;
+	exception_ptr generationError;
+
+	/** @brief Reads generated PDF files to send them to the client
+    * @param [in] outputFiles a vector containing the paths of the PDF files
+    * @return A vector of File containing the names and contents of the PDF files
+    * @throw InvalidConfiguration if a PDF file can not be read
+    *
+    * The PDF files are removed after reading, unless --keep-files is set.
+    */
+	vector<File> readOutputFiles(const vector<string>& outputFiles) const;
+
+	/** @brief Takes the results of the running batch
+    * @param [out] _return the results, at most maxFiles PDF files
+    * @param [in] jobId the id returned by startGeneration
+    * @param [in] maxFiles the maximum number of returned PDF files, all available files if it is not positive
+    * @param [in] wait a bool specifying if it waits until a PDF file is available or the batch is finished
+    * @throw InvalidJob if no batch was started with jobId
+    *
+    * If the batch failed, its error is thrown after all PDF files generated before have been taken.
+    */
+	void takeResults(GenerationResults& _return, const string& jobId, int32_t maxFiles, bool wait);
+
+	/** @brief Logs how many compiler jobs a batch ran and how long they were queued
+    * @param [in] statistics the statistics of the job queue of the batch
+    */
+	void logQueueStatistics(const JobQueue::Statistics& statistics) const;
+
+	/** @brief Starts measuring a call to the service
+    * @param [in] method the name of the called method
+    * @return A timer recording the duration of the call, and whether it failed, when it is destroyed
+    */
+	Metrics::ScopedTimer measureCall(const string& method) const;
+
+	/** @brief Counts data received from the client
+    * @param [in] bytes the number of received bytes
+    */
+	void countReceivedBytes(size_t bytes) const;
+
+	/** @brief Converts a failed compilation into the error sent to the client
+    * @param [in] error the LatexExecutionError of the failed compiler
+    * @return A CompilationFailed containing the message, resource usage and end of the log of the compiler
+    */
+	static CompilationFailed createCompilationFailed(const LatexExecutionError& error);
 
 public:
 	CertificateGeneratorHandler(const string& id, const string& peerAddress);
@@ -75,6 +143,12 @@ public:
 
 	void generateCertificates(std::vector<File>& _return);
 
+	void startGeneration(std::string& _return);
+
+	void fetchResults(GenerationResults& _return, const std::string& jobId, const int32_t maxFiles);
+
+	void pollResults(GenerationResults& _return, const std::string& jobId, const int32_t maxFiles);
+
 	bool sanitizeFilename(string& filename);
 };
 
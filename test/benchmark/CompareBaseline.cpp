@@ -0,0 +1,119 @@
+#include <cxxopts.hpp>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+
+using json = nlohmann::json;
+using namespace std;
+
+/**
+ * Compares the json output of out/benchmark with the checked in baseline.
+ *
+ * The fastest repetition of every benchmark is compared, because slower ones
+ * mostly measure other processes. A benchmark regressed, if its cpu time grew
+ * by more than the time tolerance or its allocations per iteration grew by
+ * more than the allocation tolerance plus one allocation.
+ */
+
+struct Result {
+	double nanoseconds = -1;
+	double allocations = -1;
+};
+
+//Reads the fastest repetition of every benchmark
+static map<string, Result> readResults(const string& file)
+{
+	ifstream input(file);
+	if (!input) {
+		throw runtime_error("Error opening " + file);
+	}
+	json results = json::parse(input);
+	map<string, Result> fastest;
+	static const map<string, double> units = { { "ns", 1 }, { "us", 1e3 }, { "ms", 1e6 }, { "s", 1e9 } };
+	for (const json& benchmark : results.at("benchmarks")) {
+		if (benchmark.value("run_type", "iteration") != "iteration") {
+			continue;
+		}
+		string name = benchmark.value("run_name", benchmark.at("name").get<string>());
+		double nanoseconds = benchmark.at("cpu_time").get<double>() * units.at(benchmark.value("time_unit", "ns"));
+		Result& result = fastest[name];
+		if (result.nanoseconds < 0 || nanoseconds < result.nanoseconds) {
+			result.nanoseconds = nanoseconds;
+		}
+		if (benchmark.contains("allocations")) {
+			double allocations = benchmark["allocations"].get<double>();
+			if (result.allocations < 0 || allocations < result.allocations) {
+				result.allocations = allocations;
+			}
+		}
+	}
+	return fastest;
+}
+
+int main(int argc, char** argv)
+{
+	string baselineFile;
+	string resultsFile;
+	double timeTolerance;
+	double allocationTolerance;
+	try {
+		cxxopts::Options options(argv[0], "Compares benchmark results with a baseline");
+		options.positional_help("BASELINE RESULTS");
+		options.add_options()("baseline", "The baseline in the json format of google benchmark", cxxopts::value<string>(baselineFile))("results", "The results in the json format of google benchmark", cxxopts::value<string>(resultsFile))("time-tolerance", "Allowed relative increase of the cpu time", cxxopts::value<double>(timeTolerance)->default_value("0.5"))("allocation-tolerance", "Allowed relative increase of the allocations", cxxopts::value<double>(allocationTolerance)->default_value("0.1"))("h, help", "Print help");
+		options.parse_positional({ "baseline", "results" });
+		auto result = options.parse(argc, argv);
+		if (result.count("help") || !result.count("baseline") || !result.count("results")) {
+			cout << options.help({ "" }) << endl;
+			exit(result.count("help") ? 0 : 1);
+		}
+	} catch (const cxxopts::OptionException& e) {
+		cerr << "Error parsing options: " << e.what() << endl;
+		exit(1);
+	}
+
+	map<string, Result> baseline;
+	map<string, Result> results;
+	try {
+		baseline = readResults(baselineFile);
+		results = readResults(resultsFile);
+	} catch (const exception& e) {
+		cerr << "Error reading benchmark results: " << e.what() << endl;
+		exit(1);
+	}
+
+	int regressions = 0;
+	cout << fixed << setprecision(1);
+	for (const auto& [name, result] : results) {
+		auto expected = baseline.find(name);
+		if (expected == baseline.end()) {
+			cout << name << ": not in the baseline" << endl;
+			continue;
+		}
+		double timeChange = (result.nanoseconds / expected->second.nanoseconds - 1) * 100;
+		bool regressed = result.nanoseconds > expected->second.nanoseconds * (1 + timeTolerance);
+		cout << name << ": " << expected->second.nanoseconds << "ns -> " << result.nanoseconds << "ns (" << showpos << timeChange << noshowpos << "%)";
+		if (result.allocations >= 0 && expected->second.allocations >= 0) {
+			cout << ", " << expected->second.allocations << " -> " << result.allocations << " allocations";
+			regressed = regressed || result.allocations > expected->second.allocations * (1 + allocationTolerance) + 1;
+		}
+		if (regressed) {
+			cout << " REGRESSION";
+			regressions++;
+		}
+		cout << endl;
+	}
+	for (const auto& [name, result] : baseline) {
+		if (results.find(name) == results.end()) {
+			cout << name << ": missing in the results" << endl;
+		}
+	}
+
+	if (regressions > 0) {
+		cerr << regressions << " benchmarks regressed" << endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
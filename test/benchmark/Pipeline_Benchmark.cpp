@@ -0,0 +1,219 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Batch.hpp"
+#include "Configuration.hpp"
+#include "Metrics.hpp"
+#include "StudentStream.hpp"
+
+#include "spdlog/spdlog.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+/**
+ * Runs one synthetic batch end-to-end and prints a line of comma separated results.
+ *
+ * Every run should be a fresh process, so the peak values only describe that batch.
+ * test/benchmark/pipeline_benchmark.sh runs a matrix of batch sizes.
+ */
+
+//The bounds of the latency histogram grow by 10%, so the interpolated percentiles are off by 5% at most
+#define LATENCY_MIN_SECONDS 0.0001
+#define LATENCY_MAX_SECONDS 600
+#define LATENCY_BUCKET_FACTOR 1.1
+#define THREAD_SAMPLE_INTERVAL_MS 2
+
+//Generates a template, that substitutes a few values and contains the table of the student
+static string generateTemplate(int index)
+{
+	stringstream content;
+	content << "\\documentclass{article}\n"
+			   "\\usepackage{certificate-generator}\n"
+			   "\\begin{document}\n"
+			   "Certificate "
+			<< index << " for \\substitude{name} \\substitude{surname} on \\substitude[global]{date}.\n"
+						"\\begin{tabular}{ l | c }\n"
+						"\\optional{tasks}{\n"
+						"\\substitude{name} & \\substitude{grade} \\\\ \\hline\n"
+						"}\n"
+						"\\end{tabular}\n"
+						"\\end{document}\n";
+	return content.str();
+}
+
+//Generates a student with the given number of rows in its table
+static json generateStudent(int index, int rows)
+{
+	json student = { { "name", "Student" }, { "surname", to_string(index) }, { "tasks", json::array() } };
+	for (int i = 0; i < rows; i++) {
+		student["tasks"].push_back({ { "name", "Task " + to_string(i) }, { "grade", "1.0" } });
+	}
+	return student;
+}
+
+//Writes the templates and a batch in the json lines format, the students are written one by one
+static filesystem::path writeBatch(const filesystem::path& directory, const filesystem::path& resource, int students, int templates, int rows)
+{
+	json configuration = { { "templates", json::array() }, { "resources", json::array({ filesystem::absolute(resource).string() }) }, { "date", "1.1.2019" }, { "workingDirectory", (directory / "working").string() }, { "outputDirectory", (directory / "output").string() } };
+	for (int i = 0; i < templates; i++) {
+		filesystem::path templatePath = directory / ("template_" + to_string(i) + ".tex");
+		ofstream(templatePath) << generateTemplate(i);
+		configuration["templates"].push_back(templatePath.string());
+	}
+	filesystem::path batchPath = directory / "batch.jsonl";
+	ofstream batchFile(batchPath);
+	batchFile << configuration.dump() << "\n";
+	for (int i = 0; i < students; i++) {
+		batchFile << generateStudent(i, rows).dump() << "\n";
+	}
+	return batchPath;
+}
+
+//Returns a value from /proc/self/status, like Threads or VmHWM
+static long readStatus(const string& key)
+{
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line)) {
+		if (line.rfind(key + ":", 0) == 0) {
+			return atol(line.c_str() + key.size() + 1);
+		}
+	}
+	return 0;
+}
+
+//Estimates a quantile by interpolating linearly inside the bucket, that contains it
+static double quantile(const Metrics::Histogram& histogram, double q)
+{
+	unsigned long long count = histogram.getCount();
+	if (count == 0) {
+		return 0;
+	}
+	double rank = q * count;
+	const vector<double>& bounds = histogram.getBounds();
+	double lowerBound = 0;
+	unsigned long long below = 0;
+	for (size_t i = 0; i < bounds.size(); i++) {
+		unsigned long long cumulative = histogram.getCumulativeCount(i);
+		if (cumulative >= rank && cumulative > below) {
+			return lowerBound + (bounds[i] - lowerBound) * (rank - below) / (cumulative - below);
+		}
+		lowerBound = bounds[i];
+		below = cumulative;
+	}
+	return lowerBound;
+}
+
+int main(int argc, char** argv)
+{
+	int students;
+	int templates;
+	int rows;
+	int workers;
+	string compiler;
+	string directoryOption;
+	string stubDirectory;
+	string resource;
+	bool precompilePreamble;
+	try {
+		cxxopts::Options options(argv[0], "Certificate generator pipeline benchmark");
+		options.add_options()("s,students", "Number of students", cxxopts::value<int>(students)->default_value("100"))("t,templates", "Number of templates", cxxopts::value<int>(templates)->default_value("1"))("r,rows", "Number of table rows per student", cxxopts::value<int>(rows)->default_value("10"))("c,compiler", "stub or xelatex", cxxopts::value<string>(compiler)->default_value("stub"))("w,workers", "Number of parallel compiler processes", cxxopts::value<int>(workers)->default_value(to_string(max(1u, thread::hardware_concurrency()))))("precompile-preamble", "Precompile the preamble of the templates", cxxopts::value<bool>(precompilePreamble)->default_value("true"))("directory", "Directory for the generated batch, it is deleted afterwards", cxxopts::value<string>(directoryOption), "DIR")("stub-directory", "Directory containing the stub xelatex", cxxopts::value<string>(stubDirectory)->default_value("test/benchmark/stub"), "DIR")("resource", "The certificate-generator package", cxxopts::value<string>(resource)->default_value("res/certificate-generator.sty"), "FILE")("header", "Print the header of the results and exit")("h, help", "Print help");
+		auto result = options.parse(argc, argv);
+		if (result.count("help")) {
+			cout << options.help({ "" }) << endl;
+			exit(0);
+		}
+		if (result.count("header")) {
+			cout << "compiler,students,templates,rows,workers,pdfs,seconds,certificates_per_second,p50_ms,p99_ms,peak_rss_kb,peak_compiler_rss_kb,peak_threads" << endl;
+			exit(0);
+		}
+		if (compiler != "stub" && compiler != "xelatex") {
+			throw cxxopts::OptionException("The compiler has to be stub or xelatex");
+		}
+		if (students < 1 || templates < 1 || rows < 0 || workers < 1) {
+			throw cxxopts::OptionException("The number of students, templates and workers has to be positive");
+		}
+	} catch (const cxxopts::OptionException& e) {
+		cerr << "Error parsing options: " << e.what() << endl;
+		exit(1);
+	}
+
+	//The stub gets found first, ProcessLauncher passes the environment to the compiler
+	if (compiler == "stub") {
+		string path = filesystem::absolute(stubDirectory).string() + ":" + getenv("PATH");
+		setenv("PATH", path.c_str(), 1);
+	}
+	spdlog::set_level(spdlog::level::warn);
+	Configuration::setup(false, true, workers, DEFAULT_MAX_MEMORY, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, 0, workers, precompilePreamble);
+
+	//Registered before the first certificate, so the fine buckets are used instead of the default ones
+	vector<double> latencyBuckets;
+	for (double bound = LATENCY_MIN_SECONDS; bound < LATENCY_MAX_SECONDS; bound *= LATENCY_BUCKET_FACTOR) {
+		latencyBuckets.push_back(bound);
+	}
+	Metrics::Histogram& latency = Metrics::get().histogram("certgen_certificate_seconds", "Time to generate the pdf of a certificate, that was not cached", "", latencyBuckets);
+
+	filesystem::path directory = directoryOption.empty() ? filesystem::temp_directory_path() / ("certgenBenchmark-" + to_string(getpid())) : filesystem::path(directoryOption);
+	filesystem::create_directories(directory);
+	filesystem::path batchPath = writeBatch(directory, resource, students, templates, rows);
+
+	atomic_bool sampling(true);
+	atomic<long> peakThreads(0);
+	thread sampler([&]() {
+		while (sampling) {
+			long threads = readStatus("Threads");
+			if (threads > peakThreads) {
+				peakThreads = threads;
+			}
+			this_thread::sleep_for(chrono::milliseconds(THREAD_SAMPLE_INTERVAL_MS));
+		}
+	});
+
+	size_t pdfs = 0;
+	chrono::duration<double> duration(0);
+	int exitCode = EXIT_SUCCESS;
+	try {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		StudentStream studentStream = StudentStream::fromFile(batchPath);
+		Batch batch(studentStream.readConfiguration(), studentStream);
+		if (!batch.check()) {
+			throw runtime_error("The generated batch is invalid");
+		}
+		batch.executeBatch();
+		duration = chrono::steady_clock::now() - start;
+		pdfs = batch.getOutputFiles().size();
+	} catch (const exception& e) {
+		cerr << "Batch failed: " << e.what() << endl;
+		exitCode = EXIT_FAILURE;
+	}
+	sampling = false;
+	sampler.join();
+	filesystem::remove_all(directory);
+	if (exitCode != EXIT_SUCCESS) {
+		return exitCode;
+	}
+
+	rusage childUsage;
+	getrusage(RUSAGE_CHILDREN, &childUsage);
+	cout << fixed << setprecision(3);
+	cout << compiler << "," << students << "," << templates << "," << rows << "," << workers << "," << pdfs << ","
+		 << duration.count() << "," << (students * (double)templates) / duration.count() << ","
+		 << quantile(latency, 0.5) * 1000 << "," << quantile(latency, 0.99) * 1000 << ","
+		 << readStatus("VmHWM") << "," << childUsage.ru_maxrss << "," << peakThreads << endl;
+	return pdfs == (size_t)students * templates ? EXIT_SUCCESS : EXIT_FAILURE;
+}
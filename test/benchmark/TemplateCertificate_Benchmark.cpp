@@ -0,0 +1,237 @@
+#include "benchmark/benchmark.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "Student.hpp"
+
+#define protected public
+#define private public
+
+#include "TemplateCertificate.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+//Counts the heap allocations of the benchmark process, the default operator delete frees them
+static atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+	allocations++;
+	void* memory = malloc(size == 0 ? 1 : size);
+	if (memory == nullptr) {
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+//Generates a template with the given number of substitutions and an optional table
+static string generateTemplate(int tags)
+{
+	stringstream content;
+	content << "\\documentclass{article}\n"
+			   "\\usepackage{certificate-generator}\n"
+			   "\\title{\\substitude{name}}\n"
+			   "\\begin{document}\n";
+	for (int i = 0; i < tags; i++) {
+		content << "Line " << i << " for \\substitude[student]{name} \\substitude{surname} on \\substitude[global]{date}.\n";
+	}
+	content << "\\begin{tabular}{ l | c }\n"
+			   "\\optional{tasks}{\n"
+			   "\\substitude{name} & \\substitude{grade} \\\\ \\hline\n"
+			   "}\n"
+			   "\\end{tabular}\n"
+			   "\\end{document}\n";
+	return content.str();
+}
+
+//Generates a student with the given number of rows in its table
+static json generateStudent(int rows)
+{
+	json student = json::parse("{\"name\":\"Max\",\"surname\":\"Mustermann\",\"tasks\":[]}");
+	for (int i = 0; i < rows; i++) {
+		student["tasks"].push_back({ { "name", "Task " + to_string(i) }, { "grade", "1.0" } });
+	}
+	return student;
+}
+
+// Renders one certificate from a template with many substitutions
+static void BM_GenerateCertificate(benchmark::State& state)
+{
+	json globalProperties = json::parse("{\"date\":\"1.1.2019\"}");
+	TemplateCertificate templateCertificate("benchmark", generateTemplate(state.range(0)), globalProperties);
+	Student student(generateStudent(state.range(1)));
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(templateCertificate.generateCertificate(student));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GenerateCertificate)->ArgNames({ "tags", "rows" })->Args({ 10, 10 })->Args({ 100, 10 })->Args({ 500, 10 })->Args({ 100, 500 });
+
+//Generates a student with a table and an additional table, that is not used by the template
+static json generateLargeStudent(int rows)
+{
+	json student = generateStudent(rows);
+	for (int i = 0; i < rows; i++) {
+		student["history"].push_back({ { "year", to_string(2000 + i) }, { "comment", string(100, 'x') } });
+	}
+	return student;
+}
+
+// Counts the allocations per certificate for students with large tables
+static void BM_GenerateCertificateAllocations(benchmark::State& state)
+{
+	json globalProperties = json::parse("{\"date\":\"1.1.2019\"}");
+	for (int i = 0; i < state.range(0); i++) {
+		globalProperties["unused"].push_back(string(100, 'x'));
+	}
+	TemplateCertificate templateCertificate("benchmark", generateTemplate(100), globalProperties);
+	Student student(generateLargeStudent(state.range(0)));
+	size_t allocationsBefore = allocations;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(templateCertificate.generateCertificate(student));
+	}
+	state.counters["allocations"] = benchmark::Counter(allocations - allocationsBefore, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_GenerateCertificateAllocations)->ArgName("rows")->Arg(10)->Arg(1000)->Arg(10000);
+
+//Generates a template of about the given size in kilobytes, with the given number of substitutions per kilobyte between the filler text
+static string generateDenseTemplate(int kilobytes, int tagsPerKilobyte)
+{
+	const string tag = "\\substitude{name} ";
+	stringstream content;
+	content << "\\documentclass{article}\n"
+			   "\\begin{document}\n";
+	for (int i = 0; i < kilobytes; i++) {
+		size_t filler = (1024 - tagsPerKilobyte * tag.size()) / (tagsPerKilobyte + 1);
+		for (int j = 0; j <= tagsPerKilobyte; j++) {
+			content << string(filler, 'x');
+			if (j < tagsPerKilobyte) {
+				content << tag;
+			}
+		}
+		content << "\n";
+	}
+	content << "\\end{document}\n";
+	return content.str();
+}
+
+//Generates a template with the given number of tables, each one containing another table
+static string generateTableTemplate(int tables)
+{
+	stringstream content;
+	content << "\\documentclass{article}\n"
+			   "\\begin{document}\n";
+	for (int i = 0; i < tables; i++) {
+		content << "\\begin{tabular}{ l | c }\n"
+				   "\\optional{tasks}{\n"
+				   "\\substitude{name} & \\substitude{grade} \\optional{tasks}{ \\substitude{grade}} \\\\ \\hline\n"
+				   "}\n"
+				   "\\end{tabular}\n";
+	}
+	content << "\\end{document}\n";
+	return content.str();
+}
+
+//Generates a student with an unused property tree, every object has the given number of children
+static json generateDeepStudent(int depth, int children)
+{
+	json tree = "leaf";
+	for (int level = 0; level < depth; level++) {
+		json parent = json::object();
+		for (int i = 0; i < children; i++) {
+			parent["child" + to_string(i)] = tree;
+		}
+		tree = parent;
+	}
+	json student = generateStudent(10);
+	student["tree"] = tree;
+	for (int i = 0; i < children; i++) {
+		student["property" + to_string(i)] = "value";
+	}
+	return student;
+}
+
+// Compiles templates of increasing size and tag density, like it is done once per template of a batch
+static void BM_CompileTemplate(benchmark::State& state)
+{
+	json globalProperties = json::parse("{\"date\":\"1.1.2019\"}");
+	string content = generateDenseTemplate(state.range(0), state.range(1));
+	for (auto _ : state) {
+		TemplateCertificate templateCertificate("benchmark", content, globalProperties);
+		benchmark::DoNotOptimize(templateCertificate.compiledTemplate.data());
+	}
+	state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(BM_CompileTemplate)->ArgNames({ "kilobytes", "tagsPerKilobyte" })->Args({ 1, 1 })->Args({ 64, 1 })->Args({ 64, 16 })->Args({ 1024, 1 })->Args({ 256, 16 });
+
+// Scans a template for all substitutions
+static void BM_FindSubstitude(benchmark::State& state)
+{
+	json globalProperties = json::parse("{}");
+	TemplateCertificate templateCertificate("benchmark", "", globalProperties);
+	string content = generateDenseTemplate(state.range(0), state.range(1));
+	for (auto _ : state) {
+		size_t position = 0;
+		tagPosition tag;
+		while ((tag = templateCertificate.findSubstitude(content, position)).start != string::npos) {
+			position = tag.stop;
+		}
+		benchmark::DoNotOptimize(position);
+	}
+	state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(BM_FindSubstitude)->ArgNames({ "kilobytes", "tagsPerKilobyte" })->Args({ 64, 1 })->Args({ 64, 16 })->Args({ 1024, 16 });
+
+// Scans a template for all optionals, the nested ones are included in their enclosing optional
+static void BM_FindOptional(benchmark::State& state)
+{
+	json globalProperties = json::parse("{}");
+	TemplateCertificate templateCertificate("benchmark", "", globalProperties);
+	string content = generateTableTemplate(state.range(0));
+	for (auto _ : state) {
+		size_t position = 0;
+		tagPosition tag;
+		while ((tag = templateCertificate.findOptional(content, position)).start != string::npos) {
+			position = tag.stop;
+		}
+		benchmark::DoNotOptimize(position);
+	}
+	state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(BM_FindOptional)->ArgName("tables")->Arg(1)->Arg(100)->Arg(1000);
+
+// Renders nested optional tables, the inner table is repeated for every row of the outer one
+static void BM_RenderOptional(benchmark::State& state)
+{
+	json globalProperties = json::parse("{}");
+	TemplateCertificate templateCertificate("benchmark", generateTableTemplate(1), globalProperties);
+	Student student(generateStudent(state.range(0)));
+	size_t allocationsBefore = allocations;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(templateCertificate.generateCertificate(student));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+	state.counters["allocations"] = benchmark::Counter(allocations - allocationsBefore, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_RenderOptional)->ArgName("rows")->Arg(1)->Arg(10)->Arg(100)->Arg(300);
+
+// Renders certificates for students with large property trees, that are not used by the template
+static void BM_GenerateCertificateDeepStudent(benchmark::State& state)
+{
+	json globalProperties = json::parse("{\"date\":\"1.1.2019\"}");
+	TemplateCertificate templateCertificate("benchmark", generateTemplate(100), globalProperties);
+	Student student(generateDeepStudent(state.range(0), state.range(1)));
+	size_t allocationsBefore = allocations;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(templateCertificate.generateCertificate(student));
+	}
+	state.counters["allocations"] = benchmark::Counter(allocations - allocationsBefore, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_GenerateCertificateDeepStudent)->ArgNames({ "depth", "children" })->Args({ 1, 10 })->Args({ 4, 10 })->Args({ 8, 4 })->Args({ 2, 1000 });
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Runs the pipeline benchmark for every combination of the batch sizes below,
+# each one in a fresh process, and prints the results as csv.
+# Usage: pipeline_benchmark.sh [BENCHMARK_EXECUTABLE]
+#
+# The matrix can be changed with environment variables, the full range is
+# STUDENTS="1 100 1000 10000 100000" TEMPLATES="1 5 20" COMPILERS="stub xelatex"
+BENCHMARK=${1:-./out/pipelineBenchmark}
+COMPILERS=${COMPILERS:-stub}
+STUDENTS=${STUDENTS:-1 100 1000 10000}
+TEMPLATES=${TEMPLATES:-1 5}
+ROWS=${ROWS:-10 1000}
+WORKERS=${WORKERS:-$(nproc)}
+
+"$BENCHMARK" --header
+for compiler in $COMPILERS; do
+	if [ "$compiler" = xelatex ] && ! command -v xelatex > /dev/null; then
+		echo "Skipping xelatex, it is not in PATH" >&2
+		continue
+	fi
+	for students in $STUDENTS; do
+		for templates in $TEMPLATES; do
+			for rows in $ROWS; do
+				"$BENCHMARK" --compiler "$compiler" --students "$students" --templates "$templates" --rows "$rows" --workers "$WORKERS" || exit 1
+			done
+		done
+	done
+done
@@ -0,0 +1,181 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <malloc.h>
+#include <sstream>
+#include <string>
+
+#define protected public
+#define private public
+
+#include "Batch.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+class BatchTest : public ::testing::Test {
+protected:
+	filesystem::path directory;
+	filesystem::path resourceFile;
+	filesystem::path targetFile;
+
+	BatchTest()
+	{
+	}
+
+	~BatchTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+		directory = filesystem::temp_directory_path();
+		directory.append("batchTest");
+		filesystem::create_directories(directory / "resources");
+		filesystem::create_directories(directory / "working");
+		resourceFile = directory / "resources" / "logo.png";
+		targetFile = directory / "working" / "logo.png";
+	}
+
+	void TearDown() override
+	{
+		error_code ignoreErrors;
+		filesystem::remove_all(directory, ignoreErrors);
+	}
+
+	void writeFile(const filesystem::path& file, const string& content)
+	{
+		ofstream output(file, ios::out | ios::binary);
+		output << content;
+	}
+
+	string readFile(const filesystem::path& file)
+	{
+		ifstream input(file, ios::in | ios::binary);
+		stringstream content;
+		content << input.rdbuf();
+		return content.str();
+	}
+};
+
+// Tests that resources are linked into the working directory
+TEST_F(BatchTest, StageResourceLinks)
+{
+	writeFile(resourceFile, "LOGO");
+	Batch::stageResource(resourceFile, targetFile);
+	ASSERT_TRUE(filesystem::exists(targetFile));
+	EXPECT_TRUE(filesystem::equivalent(resourceFile, targetFile)) << "Resource was not linked";
+	EXPECT_THROW(Batch::stageResource(directory / "missing.png", targetFile), FileAccessError);
+}
+
+// Tests that a staged copy is only replaced, if the resource changed
+TEST_F(BatchTest, StageResourceKeepsUnchangedCopy)
+{
+	writeFile(resourceFile, "LOGO");
+	writeFile(targetFile, "LOGO");
+	filesystem::file_time_type targetTime = filesystem::last_write_time(resourceFile) - chrono::hours(1);
+	filesystem::last_write_time(targetFile, targetTime);
+	Batch::stageResource(resourceFile, targetFile);
+	EXPECT_FALSE(filesystem::equivalent(resourceFile, targetFile)) << "Unchanged copy was replaced";
+	EXPECT_EQ(filesystem::last_write_time(targetFile), filesystem::last_write_time(resourceFile)) << "Modification time was not updated";
+
+	writeFile(resourceFile, "NEW!");
+	Batch::stageResource(resourceFile, targetFile);
+	EXPECT_EQ(readFile(targetFile), "NEW!") << "Changed resource was not staged";
+}
+
+// Tests that a batch does not copy its configuration for every template
+TEST_F(BatchTest, ConfigurationIsNotCopied)
+{
+	json configuration;
+	configuration["workingDirectory"] = (directory / "working").string();
+	configuration["outputDirectory"] = (directory / "output").string();
+	configuration["resources"] = json::array();
+	for (int i = 0; i < 5; i++) {
+		filesystem::path templateFile = directory / ("template" + to_string(i) + ".tex");
+		writeFile(templateFile, "\\substitude{name} \\substitude[global]{date}");
+		configuration["templates"].push_back(templateFile.string());
+	}
+	configuration["date"] = "1.1.2019";
+	//Large global properties, that are not used by the templates
+	for (int i = 0; i < 5000; i++) {
+		configuration["history"].push_back({ { "year", to_string(i) }, { "comment", string(100, 'x') } });
+	}
+
+	for (int i = 0; i < 5000; i++) {
+		configuration["students"].push_back({ { "name", "Student " + to_string(i) }, { "comment", string(100, 'x') } });
+	}
+
+	//The heap memory used by one copy of the configuration
+	long long before = mallinfo2().uordblks;
+	long long configurationSize;
+	{
+		json copy = configuration;
+		configurationSize = (long long)mallinfo2().uordblks - before;
+	}
+
+	before = mallinfo2().uordblks;
+	Batch batch(move(configuration));
+	long long batchSize = (long long)mallinfo2().uordblks - before;
+	EXPECT_LT(batchSize, configurationSize / 2) << "The batch uses " << batchSize << " bytes for a configuration of " << configurationSize << " bytes";
+
+	ASSERT_EQ(batch.templateCertificates.size(), 5);
+	EXPECT_EQ(batch.templateCertificates[0].globalProperties.get(), batch.templateCertificates[4].globalProperties.get()) << "Global properties are not shared";
+	EXPECT_FALSE(batch.templateCertificates[0].globalProperties->contains("students")) << "Students are part of the global properties";
+	EXPECT_TRUE(batch.check());
+}
+
+// Tests that a batch stops at its deadline and reports the timeout
+TEST_F(BatchTest, DeadlineStopsBatch)
+{
+	json configuration;
+	configuration["workingDirectory"] = (directory / "working").string();
+	configuration["outputDirectory"] = (directory / "output").string();
+	filesystem::path templateFile = directory / "template.tex";
+	writeFile(templateFile, "\\substitude{name}");
+	configuration["templates"].push_back(templateFile.string());
+	for (int i = 0; i < 10; i++) {
+		configuration["students"].push_back({ { "name", "Student " + to_string(i) } });
+	}
+	Batch batch(move(configuration));
+
+	batch.deadline = chrono::steady_clock::now() - chrono::seconds(1);
+	EXPECT_THROW(batch.outputCertificates(), BatchTimeoutError);
+	EXPECT_TRUE(batch.deadlineExceeded);
+	EXPECT_TRUE(batch.getOutputFiles().empty());
+	EXPECT_FALSE(batch.killswitch) << "The timeout canceled the batch instead";
+}
+
+// Tests that a shared format is dumped once by the batch queue and its temporary files are removed
+TEST_F(BatchTest, PrepareFormatsDumpsSharedFormatOnce)
+{
+	Configuration::singleton = nullptr;
+	Configuration::setup(false, true, DEFAULT_MAX_BATCH_WORKERS, DEFAULT_MAX_MEMORY, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS, true);
+	json configuration;
+	configuration["workingDirectory"] = (directory / "working").string();
+	configuration["outputDirectory"] = (directory / "output").string();
+	for (int i = 0; i < 2; i++) {
+		filesystem::path templateFile = directory / ("template" + to_string(i) + ".tex");
+		writeFile(templateFile, "\\documentclass{article}\n\\begin{document}\n\\substitude{name} " + to_string(i) + "\n\\end{document}\n");
+		configuration["templates"].push_back(templateFile.string());
+	}
+	configuration["students"].push_back({ { "name", "Student" } });
+	Batch batch(move(configuration));
+
+	batch.prepareFormats();
+	EXPECT_TRUE(batch.templateCertificates[0].formatEnabled);
+	EXPECT_TRUE(batch.templateCertificates[1].formatEnabled);
+	vector<string> workingFiles;
+	for (const filesystem::directory_entry& file : filesystem::directory_iterator(directory / "working")) {
+		workingFiles.push_back(file.path().filename().string());
+	}
+	ASSERT_EQ(workingFiles.size(), 1) << "Temporary files of the format were not removed";
+	EXPECT_EQ(filesystem::path(workingFiles[0]).extension(), ".fmt");
+	EXPECT_EQ(batch.getJobQueue()->getStatistics().executedJobs, 1) << "The format was not dumped by the batch queue";
+
+	Configuration::singleton = nullptr;
+}
@@ -185,6 +185,36 @@ TEST_F(CertificateTest, moveResultToOutputDirectoryWorks)
 	ASSERT_EQ(outputFileContent.str(), "CONTENT");
 }
 
+// Tests that the Certificate::copyFile copies files completely, also between filesystems
+TEST_F(CertificateTest, copyFileCopiesContent)
+{
+	filesystem::path directory = getWorkingDirectory();
+	filesystem::path originalFile = directory;
+	originalFile.append("original.pdf");
+	string content;
+	for (int i = 0; i < 300000; i++) {
+		content.append(to_string(i));
+	}
+	ofstream originalFileStream(originalFile, ios::out | ios::binary);
+	originalFileStream << content << flush;
+	originalFileStream.close();
+
+	vector<filesystem::path> copies = { directory / "copy.pdf" };
+	if (filesystem::is_directory("/dev/shm")) {
+		copies.push_back(filesystem::path("/dev/shm") / "certificateTestCopy.pdf");
+	}
+	for (const filesystem::path& copy : copies) {
+		Certificate::copyFile(originalFile, copy);
+		ifstream copyStream(copy, ios::in | ios::binary);
+		stringstream copyContent;
+		copyContent << copyStream.rdbuf();
+		copyStream.close();
+		filesystem::remove(copy);
+		EXPECT_EQ(copyContent.str(), content) << "Copy " << copy << " differs";
+	}
+	EXPECT_THROW(Certificate::copyFile(directory / "missing.pdf", directory / "copy.pdf"), FileAccessError);
+}
+
 // Tests that the Certificate::generatePDF does not crash with valid input
 TEST_F(CertificateTest, generatePdfGeneratesNotCrashing)
 {
@@ -258,6 +288,38 @@ TEST_F(CertificateTest, generatePdfGeneratesOneFile)
 	EXPECT_EQ(files, 1) << "There is not exactly one file in the output directory";
 }
 
+// Tests that the Certificate::createJobDirectory creates separate directories with links to the shared files
+TEST_F(CertificateTest, createJobDirectoryLinksSharedFiles)
+{
+	filesystem::path workingDirectory = getWorkingDirectory();
+	ofstream(workingDirectory / "logo.png") << "LOGO";
+	ofstream(workingDirectory / "testName.pdf") << "OLD";
+
+	filesystem::path firstJob = testCertificate->createJobDirectory(workingDirectory, { testName });
+	filesystem::path secondJob = testCertificate->createJobDirectory(workingDirectory, { testName });
+	EXPECT_NE(firstJob, secondJob) << "Jobs share a directory";
+	EXPECT_EQ(firstJob.parent_path(), workingDirectory);
+	ASSERT_TRUE(filesystem::exists(firstJob / "logo.png"));
+	EXPECT_TRUE(filesystem::equivalent(firstJob / "logo.png", workingDirectory / "logo.png")) << "Shared file was not linked";
+	EXPECT_FALSE(filesystem::exists(firstJob / "testName.pdf")) << "File named like a generated file was linked";
+	EXPECT_FALSE(filesystem::exists(firstJob / secondJob.filename())) << "Directory of another job was linked";
+}
+
+// Tests that the Certificate::generatePDF leaves no temporary files in the working directory
+TEST_F(CertificateTest, generatePdfRemovesJobDirectory)
+{
+	filesystem::path directory = getWorkingDirectory();
+	filesystem::path workingDirectory = directory / "working";
+	filesystem::create_directories(workingDirectory);
+	filesystem::path outputDirectory = directory / "output";
+	filesystem::create_directories(outputDirectory);
+
+	resetConfiguration();
+	Configuration::setup(false, DEFAULT_USE_THREAD, DEFAULT_MAX_BATCH_WORKERS, 4000000000, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS);
+	testCertificate->generatePDF(workingDirectory, outputDirectory, false);
+	EXPECT_TRUE(filesystem::is_empty(workingDirectory)) << "Temporary files were left in the working directory";
+}
+
 // Tests that the Certificate::generatePDF generates something that really looks like a pdf file
 TEST_F(CertificateTest, generatePdfGeneratesRealPDF)
 {
@@ -328,3 +390,145 @@ TEST_F(CertificateTest, generateLatexArgumentsRespectsConfiguration)
 	//Reset configuration for next tests
 	resetConfiguration();
 }
+
+// Tests that the Certificate::generateLatexArguments starts latex with the format of the certificate
+TEST_F(CertificateTest, generateLatexArgumentsUsesFormat)
+{
+	filesystem::path directory = getWorkingDirectory();
+	Certificate withFormat("NAME", "CONTENT", "FORMAT");
+	
+	//Check that the format is used
+	vector<string> arguments = withFormat.generateLatexArguments(directory);
+	EXPECT_NE(find(arguments.begin(), arguments.end(), "-fmt=FORMAT"), arguments.end()) << "Format is not passed to latex";
+	
+	//Check that no format is used by default
+	vector<string> defaultArguments = testCertificate->generateLatexArguments(directory);
+	for(string argument: defaultArguments){
+		EXPECT_NE(argument.substr(0,5), "-fmt=") << "Format is passed to latex, even though the certificate has none";
+	}
+	
+	//Check that dumping a format uses ini mode
+	vector<string> dumpArguments = testCertificate->generateLatexArguments(directory, true);
+	EXPECT_NE(find(dumpArguments.begin(), dumpArguments.end(), "-ini"), dumpArguments.end()) << "Latex is not started in ini mode";
+	EXPECT_NE(find(dumpArguments.begin(), dumpArguments.end(), "-jobname=testName"), dumpArguments.end()) << "Format is not named after the certificate";
+}
+
+// Tests that the cache key depends on content, resources and format
+TEST_F(CertificateTest, generateCacheKeyDependsOnInputs)
+{
+	string key = testCertificate->generateCacheKey("RESOURCES");
+	EXPECT_EQ(key, Certificate(testName, testContent).generateCacheKey("RESOURCES")) << "Same certificate has different keys";
+	EXPECT_NE(key, Certificate(testName, testContent + " ").generateCacheKey("RESOURCES")) << "Key does not depend on the content";
+	EXPECT_NE(key, testCertificate->generateCacheKey("OTHER")) << "Key does not depend on the resources";
+	EXPECT_NE(key, Certificate(testName, testContent, "FORMAT").generateCacheKey("RESOURCES")) << "Key does not depend on the format";
+}
+
+// Tests that a failed compiler reports its exit code, resource usage and the end of its log
+TEST_F(CertificateTest, runLatexReportsFailedRun)
+{
+	filesystem::path directory = getWorkingDirectory();
+	resetConfiguration();
+	Configuration::setup(false, DEFAULT_USE_THREAD, DEFAULT_MAX_BATCH_WORKERS, 4000000000, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS);
+	Trace trace("failing");
+	testCertificate->setTrace(&trace);
+	testCertificate->setTemplateName("template");
+
+	//Write a log longer than the tail and fail like latex
+	string script = "for i in $(seq 100); do echo line $i; done > testName.log; echo '! Undefined control sequence.' >> testName.log; exit 3";
+	CompilerRun run;
+	try {
+		testCertificate->runLatex({ "sh", "-c", script }, directory, false, run);
+		FAIL() << "Failed compiler did not throw";
+	} catch (const LatexExecutionError& error) {
+		const CompilerRun& failedRun = error.getRun();
+		EXPECT_EQ(failedRun.certificate, "testName");
+		EXPECT_EQ(failedRun.exitCode, 3);
+		EXPECT_EQ(failedRun.passes, 1);
+		EXPECT_GT(failedRun.wallTime.count(), 0);
+		EXPECT_GT(failedRun.peakMemory, 0);
+		EXPECT_NE(failedRun.logTail.find("! Undefined control sequence."), string::npos) << failedRun.logTail;
+		EXPECT_EQ(failedRun.logTail.find("line 81\n"), string::npos) << "Log tail is too long";
+		EXPECT_EQ(failedRun.logTail.rfind("line 82\n", 0), 0) << failedRun.logTail;
+		EXPECT_NE(string(error.what()).find("exited with code 3"), string::npos) << error.what();
+	}
+	EXPECT_EQ(run.passes, 1);
+
+	map<string, Trace::CompilerStatistics> statistics = trace.getCompilerStatistics();
+	ASSERT_EQ(statistics.count("template"), 1);
+	EXPECT_EQ(statistics["template"].runs, 1);
+	EXPECT_EQ(statistics["template"].failures, 1);
+}
+
+// Tests that rerun requests are found in the log, even if latex wrapped the line
+TEST_F(CertificateTest, logRequestsRerunDetectsRequests)
+{
+	EXPECT_TRUE(Certificate::logRequestsRerun("LaTeX Warning: Label(s) may have changed. Rerun to get cross-references right.\n"));
+	EXPECT_TRUE(Certificate::logRequestsRerun("Package longtable Warning: Table widths have changed. Rerun LaTeX.\n"));
+	string line = "Package rerunfilecheck Warning: File `testName.out' has changed.             Re";
+	ASSERT_EQ(line.size(), 79);
+	EXPECT_TRUE(Certificate::logRequestsRerun(line + "\nrun to get outlines right\n")) << "Wrapped request not detected";
+	EXPECT_FALSE(Certificate::logRequestsRerun("Package: rerunfilecheck 2022/07/10 v1.10 Rerun checks for auxiliary files (HO)\n"));
+	EXPECT_FALSE(Certificate::logRequestsRerun("Output written on testName.pdf (1 page).\n"));
+}
+
+// Tests that latex is only run again, if it requests a rerun, and at most maxLatexPasses times
+TEST_F(CertificateTest, compileRerunsOnlyWhenRequested)
+{
+	filesystem::path directory = getWorkingDirectory();
+	resetConfiguration();
+	Configuration::setup(false, DEFAULT_USE_THREAD, DEFAULT_MAX_BATCH_WORKERS, 4000000000, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS, DEFAULT_PRECOMPILE_PREAMBLE, 3);
+
+	//Like latex without references, the .aux file is always written
+	CompilerRun singleRun;
+	ASSERT_TRUE(testCertificate->compile({ "sh", "-c", "printf '%s\\n' '\\relax' > testName.aux; echo 'Output written' > testName.log" }, directory, false, singleRun));
+	EXPECT_EQ(singleRun.passes, 1) << "Latex was run again without a rerun request";
+
+	//Like lastpage, the label is only known in the second pass
+	filesystem::remove(directory / "testName.aux");
+	string lastPage = "if grep -q LastPage testName.aux 2>/dev/null; then echo 'Output written' > testName.log; "
+					  "else echo 'LaTeX Warning: Label(s) may have changed. Rerun to get cross-references right.' > testName.log; fi; "
+					  "printf '%s\\n' '\\newlabel{LastPage}{{}{1}}' > testName.aux";
+	CompilerRun referenceRun;
+	ASSERT_TRUE(testCertificate->compile({ "sh", "-c", lastPage }, directory, false, referenceRun));
+	EXPECT_EQ(referenceRun.passes, 2);
+
+	//A table of contents is read in the next pass
+	filesystem::remove(directory / "testName.aux");
+	CompilerRun tocRun;
+	ASSERT_TRUE(testCertificate->compile({ "sh", "-c", "printf '%s\\n' '\\contentsline{section}{Section}{1}' > testName.toc; echo 'Output written' > testName.log" }, directory, false, tocRun));
+	EXPECT_EQ(tocRun.passes, 2) << "Changed table of contents did not cause exactly one rerun";
+	filesystem::remove(directory / "testName.toc");
+
+	//Documents that never settle are not compiled forever
+	CompilerRun endlessRun;
+	ASSERT_TRUE(testCertificate->compile({ "sh", "-c", "echo 'Rerun to get cross-references right.' > testName.log" }, directory, false, endlessRun));
+	EXPECT_EQ(endlessRun.passes, CONFIG.maxLatexPasses);
+}
+
+// Tests that the Certificate::generatePDF removes the job directory, if latex fails or the generation is canceled
+TEST_F(CertificateTest, generatePdfRemovesJobDirectoryOnFailure)
+{
+	filesystem::path directory = getWorkingDirectory();
+	filesystem::path workingDirectory = directory / "working";
+	filesystem::create_directories(workingDirectory);
+	filesystem::path outputDirectory = directory / "output";
+	filesystem::create_directories(outputDirectory);
+	resetConfiguration();
+	Configuration::setup(false, DEFAULT_USE_THREAD, DEFAULT_MAX_BATCH_WORKERS, 4000000000, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS);
+
+	//A xelatex, that always fails, is found first
+	filesystem::path binDirectory = directory / "bin";
+	filesystem::create_directories(binDirectory);
+	ofstream failingCompiler(binDirectory / "xelatex");
+	failingCompiler << "#!/bin/sh\necho '! Undefined control sequence.' > testName.log\nexit 1\n";
+	failingCompiler.close();
+	filesystem::permissions(binDirectory / "xelatex", filesystem::perms::owner_all);
+	string path = getenv("PATH");
+	setenv("PATH", (binDirectory.string() + ":" + path).c_str(), 1);
+	EXPECT_THROW(testCertificate->generatePDF(workingDirectory, outputDirectory, false), LatexExecutionError);
+	setenv("PATH", path.c_str(), 1);
+	EXPECT_TRUE(filesystem::is_empty(workingDirectory)) << "Job directory was left after a failed compile";
+
+	EXPECT_EQ(testCertificate->generatePDF(workingDirectory, outputDirectory, true), "");
+	EXPECT_TRUE(filesystem::is_empty(workingDirectory)) << "Job directory was left after the generation was canceled";
+}
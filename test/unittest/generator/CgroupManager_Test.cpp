@@ -0,0 +1,172 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <wait.h>
+
+#define private public
+#include "CgroupManager.hpp"
+#include "Configuration.hpp"
+#include "ProcessLauncher.hpp"
+
+using namespace std;
+
+class CgroupManagerTest : public ::testing::Test {
+protected:
+	filesystem::path root;
+
+	CgroupManagerTest()
+	{
+	}
+
+	~CgroupManagerTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+		Configuration::singleton = nullptr;
+		Configuration::setup();
+		//Use the first writable cgroup v2 hierarchy
+		ifstream mounts("/proc/self/mounts");
+		string device, mountPoint, type, rest;
+		while (mounts >> device >> mountPoint >> type && getline(mounts, rest)) {
+			if (type != "cgroup2") {
+				continue;
+			}
+			filesystem::path testRoot(mountPoint);
+			testRoot.append("cgroupManagerTest");
+			error_code error;
+			filesystem::create_directory(testRoot, error);
+			if (!error) {
+				root = testRoot;
+				break;
+			}
+		}
+	}
+
+	void TearDown() override
+	{
+		if (!root.empty()) {
+			//Cgroups can only be removed with rmdir, children first
+			for (const filesystem::directory_entry& batch : filesystem::directory_iterator(root)) {
+				if (batch.is_directory()) {
+					for (const filesystem::directory_entry& job : filesystem::directory_iterator(batch)) {
+						if (job.is_directory()) {
+							rmdir(job.path().c_str());
+						}
+					}
+					rmdir(batch.path().c_str());
+				}
+			}
+			rmdir(root.c_str());
+		}
+		CgroupManager::singleton = nullptr;
+	}
+
+	string readFile(const filesystem::path& file)
+	{
+		ifstream input(file);
+		stringstream content;
+		content << input.rdbuf();
+		return content.str();
+	}
+};
+
+// Tests that only cgroup v2 directories are accepted
+TEST_F(CgroupManagerTest, RejectsOtherDirectories)
+{
+	EXPECT_FALSE(CgroupManager::isCgroup2(filesystem::temp_directory_path()));
+	EXPECT_FALSE(CgroupManager::isCgroup2("/certificate-generator-missing-directory"));
+	EXPECT_THROW(CgroupManager::setup(filesystem::temp_directory_path()), ConfigurationError);
+	EXPECT_EQ(CgroupManager::get(), nullptr);
+}
+
+// Tests that jobs are placed below the cgroup of the batch containing their working directory
+TEST_F(CgroupManagerTest, CreatesJobGroupsBelowBatchGroups)
+{
+	if (root.empty()) {
+		GTEST_SKIP() << "No writable cgroup v2 hierarchy";
+	}
+	CgroupManager::setup(root);
+	CgroupManager* cgroups = CgroupManager::get();
+	ASSERT_NE(cgroups, nullptr);
+
+	filesystem::path batchGroup = cgroups->createBatchGroup("/tmp/batch/working/");
+	ASSERT_FALSE(batchGroup.empty());
+	EXPECT_EQ(batchGroup.parent_path(), root);
+
+	filesystem::path jobGroup = cgroups->createJobGroup("/tmp/batch/working/format");
+	ASSERT_FALSE(jobGroup.empty());
+	EXPECT_EQ(jobGroup.parent_path(), batchGroup);
+	cgroups->removeJobGroup(jobGroup);
+	EXPECT_FALSE(filesystem::exists(jobGroup));
+
+	filesystem::path otherJobGroup = cgroups->createJobGroup("/tmp/batch/workingOther");
+	ASSERT_FALSE(otherJobGroup.empty());
+	EXPECT_EQ(otherJobGroup.parent_path(), root);
+	cgroups->removeJobGroup(otherJobGroup);
+
+	cgroups->removeBatchGroup("/tmp/batch/working/");
+	EXPECT_FALSE(filesystem::exists(batchGroup));
+}
+
+// Tests that processes are started in job groups and killed with their children, when the group is removed
+TEST_F(CgroupManagerTest, KillsRemainingProcesses)
+{
+	if (root.empty()) {
+		GTEST_SKIP() << "No writable cgroup v2 hierarchy";
+	}
+	CgroupManager::setup(root);
+	CgroupManager* cgroups = CgroupManager::get();
+	filesystem::path jobGroup = cgroups->createJobGroup(filesystem::temp_directory_path());
+	ASSERT_FALSE(jobGroup.empty());
+
+	//The forked sleep has to be in the group as well
+	ProcessLauncher launcher({ "sh", "-c", "sleep 10 & wait" }, filesystem::temp_directory_path());
+	launcher.setCgroup(jobGroup);
+	pid_t pid = launcher.launch();
+	EXPECT_NE(readFile(jobGroup / "cgroup.procs").find(to_string(pid)), string::npos) << "Process was not started in the cgroup";
+	string processes = readFile(jobGroup / "cgroup.procs");
+	for (int attempt = 0; attempt < 100 && count(processes.begin(), processes.end(), '\n') < 2; attempt++) {
+		this_thread::sleep_for(chrono::milliseconds(10));
+		processes = readFile(jobGroup / "cgroup.procs");
+	}
+	EXPECT_EQ(count(processes.begin(), processes.end(), '\n'), 2) << "Forked process is not in the cgroup";
+
+	cgroups->removeJobGroup(jobGroup);
+	EXPECT_FALSE(filesystem::exists(jobGroup));
+	int status;
+	waitpid(pid, &status, 0);
+	EXPECT_TRUE(WIFSIGNALED(status));
+}
+
+// Tests that docker containers can be started below job groups and are removed with them
+TEST_F(CgroupManagerTest, StartsContainersBelowJobGroups)
+{
+	if (root.empty()) {
+		GTEST_SKIP() << "No writable cgroup v2 hierarchy";
+	}
+	CgroupManager::setup(root);
+	CgroupManager* cgroups = CgroupManager::get();
+	filesystem::path batchGroup = cgroups->createBatchGroup("/tmp/batch/working/");
+	filesystem::path jobGroup = cgroups->createJobGroup("/tmp/batch/working/test.job0", true);
+	ASSERT_FALSE(jobGroup.empty());
+	EXPECT_EQ(cgroups->getBatchGroup("/tmp/batch/working/test.job0"), batchGroup);
+
+	//The path is relative to the root of the hierarchy, which is the parent of the test root
+	filesystem::path parent = filesystem::path("/") / root.filename() / batchGroup.filename() / jobGroup.filename();
+	EXPECT_EQ(CgroupManager::generateDockerArgument(jobGroup), "--cgroup-parent=" + parent.string());
+
+	//Docker creates the cgroup of the container below the job group
+	filesystem::path containerGroup = jobGroup / "container";
+	ASSERT_TRUE(filesystem::create_directory(containerGroup));
+	cgroups->removeJobGroup(jobGroup);
+	EXPECT_FALSE(filesystem::exists(containerGroup));
+	EXPECT_FALSE(filesystem::exists(jobGroup));
+	cgroups->removeBatchGroup("/tmp/batch/working/");
+}
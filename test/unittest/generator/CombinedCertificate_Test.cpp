@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define protected public
+#define private public
+
+#include "CombinedCertificate.hpp"
+#include "Configuration.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+class CombinedCertificateTest : public ::testing::Test {
+protected:
+	filesystem::path workingDirectory;
+	vector<Certificate> parts = { Certificate("first_part", ""), Certificate("second_part", ""), Certificate("third_part", "") };
+
+	CombinedCertificateTest()
+	{
+	}
+
+	~CombinedCertificateTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+		Configuration::setup(false, DEFAULT_USE_THREAD, DEFAULT_MAX_BATCH_WORKERS, DEFAULT_MAX_MEMORY, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS);
+		workingDirectory = filesystem::temp_directory_path();
+		workingDirectory.append("combinedCertificateTest");
+		filesystem::create_directories(workingDirectory);
+	}
+
+	void TearDown() override
+	{
+		error_code ignoreErrors;
+		filesystem::remove_all(workingDirectory, ignoreErrors);
+		Configuration::singleton = nullptr;
+	}
+
+	//Writes the page marks latex would record for the combined certificate
+	void writePages(const string& pages)
+	{
+		filesystem::path pagesFile(workingDirectory);
+		pagesFile.append("combined.pages");
+		ofstream output(pagesFile);
+		output << pages;
+	}
+};
+
+// Tests that the recorded page marks are converted to page ranges
+TEST_F(CombinedCertificateTest, ReadPageRanges)
+{
+	CombinedCertificate combined("combined", "", "", parts);
+	writePages("0\n1\n3\n4\n");
+	vector<pair<unsigned int, unsigned int>> pageRanges = combined.readPageRanges(workingDirectory);
+	ASSERT_EQ(pageRanges.size(), 3);
+	EXPECT_EQ(pageRanges[0], make_pair(1u, 1u));
+	EXPECT_EQ(pageRanges[1], make_pair(2u, 3u));
+	EXPECT_EQ(pageRanges[2], make_pair(4u, 4u));
+}
+
+// Tests that missing or inconsistent page marks are detected
+TEST_F(CombinedCertificateTest, InvalidPageRangesThrow)
+{
+	CombinedCertificate combined("combined", "", "", parts);
+	EXPECT_THROW(combined.readPageRanges(workingDirectory), LatexExecutionError) << "Missing pages file not detected";
+	writePages("0\n1\n2\n");
+	EXPECT_THROW(combined.readPageRanges(workingDirectory), LatexExecutionError) << "Missing page mark not detected";
+	writePages("0\n1\n1\n2\n");
+	EXPECT_THROW(combined.readPageRanges(workingDirectory), LatexExecutionError) << "Certificate without pages not detected";
+}
+
+// Tests that the pdf is split into files named like the parts
+TEST_F(CombinedCertificateTest, SplitArgumentsUsePartNames)
+{
+	CombinedCertificate combined("combined", "", "", parts);
+	vector<string> arguments = combined.generateSplitArguments({ { 1, 1 }, { 2, 3 }, { 4, 4 } });
+	ASSERT_EQ(arguments.size(), 11);
+	EXPECT_EQ(arguments[0], "sh");
+	EXPECT_EQ(arguments[4], "combined.pdf");
+	EXPECT_EQ(arguments[5], "1-1");
+	EXPECT_EQ(arguments[6], "first_part.pdf");
+	EXPECT_EQ(arguments[7], "2-3");
+	EXPECT_EQ(arguments[8], "second_part.pdf");
+	EXPECT_EQ(arguments[9], "4-4");
+	EXPECT_EQ(arguments[10], "third_part.pdf");
+}
+
+// Tests that the job directory is removed, if compiling the combined document fails
+TEST_F(CombinedCertificateTest, GeneratePdfsRemovesJobDirectoryOnFailure)
+{
+	filesystem::path batchDirectory = workingDirectory / "working";
+	filesystem::path outputDirectory = workingDirectory / "output";
+	filesystem::path binDirectory = workingDirectory / "bin";
+	filesystem::create_directories(batchDirectory);
+	filesystem::create_directories(outputDirectory);
+	filesystem::create_directories(binDirectory);
+	ofstream failingCompiler(binDirectory / "xelatex");
+	failingCompiler << "#!/bin/sh\nexit 1\n";
+	failingCompiler.close();
+	filesystem::permissions(binDirectory / "xelatex", filesystem::perms::owner_all);
+
+	CombinedCertificate combined("combined", "", "", parts);
+	string path = getenv("PATH");
+	setenv("PATH", (binDirectory.string() + ":" + path).c_str(), 1);
+	EXPECT_THROW(combined.generatePDFs(batchDirectory, outputDirectory, false), LatexExecutionError);
+	setenv("PATH", path.c_str(), 1);
+	EXPECT_TRUE(filesystem::is_empty(batchDirectory)) << "Job directory was left after a failed compile";
+
+	EXPECT_TRUE(combined.generatePDFs(batchDirectory, outputDirectory, true).empty());
+	EXPECT_TRUE(filesystem::is_empty(batchDirectory)) << "Job directory was left after the generation was canceled";
+}
@@ -89,12 +89,14 @@ TEST_F(ConfigurationTest, setupSetsDefaultValues)
 	EXPECT_EQ(CONFIG.workerTimeout, DEFAULT_WORKER_TIMEOUT);
 	EXPECT_EQ(CONFIG.batchTimeout, DEFAULT_TIMEOUT);
 	EXPECT_EQ(CONFIG.maxWorkers, DEFAULT_MAX_WORKERS);
+	EXPECT_EQ(CONFIG.precompilePreamble, DEFAULT_PRECOMPILE_PREAMBLE);
+	EXPECT_EQ(CONFIG.maxLatexPasses, DEFAULT_MAX_LATEX_PASSES);
 }
 
 // Tests that Configuration::setup sets the given values
 TEST_F(ConfigurationTest, setupSetsGivenValues)
 {
-	Configuration::setup(!DEFAULT_DOCKER, !DEFAULT_USE_THREAD, 3453, 945, 4533, 748, 1348, 898);
+	Configuration::setup(!DEFAULT_DOCKER, !DEFAULT_USE_THREAD, 3453, 945, 4533, 748, 1348, 898, !DEFAULT_PRECOMPILE_PREAMBLE, 5);
 	EXPECT_EQ(CONFIG.docker, !DEFAULT_DOCKER);
 	EXPECT_EQ(CONFIG.useThreads, !DEFAULT_USE_THREAD);
 	EXPECT_EQ(CONFIG.maxWorkersPerBatch, 3453);
@@ -103,6 +105,8 @@ TEST_F(ConfigurationTest, setupSetsGivenValues)
 	EXPECT_EQ(CONFIG.workerTimeout, 748);
 	EXPECT_EQ(CONFIG.batchTimeout, 1348);
 	EXPECT_EQ(CONFIG.maxWorkers, 898);
+	EXPECT_EQ(CONFIG.precompilePreamble, !DEFAULT_PRECOMPILE_PREAMBLE);
+	EXPECT_EQ(CONFIG.maxLatexPasses, 5);
 }
 
 // Tests that Configuration::setup does not set values on second call
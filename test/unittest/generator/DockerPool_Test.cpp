@@ -0,0 +1,164 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#define protected public
+#define private public
+
+#include "Configuration.hpp"
+#include "DockerPool.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+class DockerPoolTest : public ::testing::Test {
+protected:
+	filesystem::path mountDirectory;
+	filesystem::path workingDirectory;
+
+	DockerPoolTest()
+	{
+	}
+
+	~DockerPoolTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+		mountDirectory = filesystem::temp_directory_path();
+		mountDirectory.append("dockerPoolTest");
+		workingDirectory = mountDirectory;
+		workingDirectory.append("batch");
+		filesystem::create_directories(workingDirectory);
+		//A pool without containers, so no docker is needed
+		DockerPool::setup(mountDirectory, 0, 2);
+	}
+
+	void TearDown() override
+	{
+		error_code ignoreErrors;
+		filesystem::remove_all(mountDirectory, ignoreErrors);
+		DockerPool::singleton = nullptr;
+		Configuration::singleton = nullptr;
+	}
+
+	//Adds an idle container, whose input can be checked with the returned file descriptor
+	int addFakeContainer(const string& name)
+	{
+		int input[2];
+		EXPECT_EQ(pipe(input), 0);
+		DockerPool& pool = *DockerPool::get();
+		pool.idle.push_back(DockerPool::Container { name, 0, input[1], 0, filesystem::canonical(workingDirectory) });
+		pool.running++;
+		return input[0];
+	}
+
+	//Checks whether the write end of the pipe was closed
+	bool isClosed(int output)
+	{
+		//Do not block, if the pipe is still open
+		fcntl(output, F_SETFL, O_NONBLOCK);
+		char buffer;
+		bool closed = read(output, &buffer, 1) == 0;
+		close(output);
+		return closed;
+	}
+};
+
+// Tests that pooled containers have the restrictions of single compiler containers
+TEST_F(DockerPoolTest, RunArgumentsRestrictContainer)
+{
+	vector<string> arguments = DockerPool::get()->generateRunArguments("container", filesystem::canonical(workingDirectory));
+	auto contains = [&arguments](const string& argument) { return find(arguments.begin(), arguments.end(), argument) != arguments.end(); };
+	EXPECT_TRUE(contains("--name=container"));
+	EXPECT_TRUE(contains(filesystem::canonical(workingDirectory).string() + ":/src/")) << "Container does not mount only its batch";
+	EXPECT_TRUE(contains("--network=none"));
+	EXPECT_TRUE(contains("--cap-drop=ALL"));
+	EXPECT_TRUE(contains("--memory=" + to_string(CONFIG.maxMemoryPerWorker)));
+	EXPECT_TRUE(contains("--env=openin_any=p"));
+	EXPECT_TRUE(contains(DOCKER_IMAGE));
+}
+
+// Tests that commands are executed in the working directory inside the container
+TEST_F(DockerPoolTest, ExecArgumentsUseWorkingDirectory)
+{
+	DockerPool::Container container { "container", 0, -1, 0, filesystem::canonical(workingDirectory) };
+	filesystem::create_directories(workingDirectory / "working" / "test.job0");
+	vector<string> arguments = DockerPool::get()->generateExecArguments(container, workingDirectory / "working" / "test.job0", { "xelatex", "test.tex" });
+	ASSERT_EQ(arguments.size(), 6);
+	EXPECT_EQ(arguments[0], "docker");
+	EXPECT_EQ(arguments[1], "exec");
+	EXPECT_EQ(arguments[2], "-w=/src/working/test.job0");
+	EXPECT_EQ(arguments[3], "container");
+	EXPECT_EQ(arguments[4], "xelatex");
+	EXPECT_EQ(arguments[5], "test.tex");
+}
+
+// Tests that no container is used for working directories outside the mount directory
+TEST_F(DockerPoolTest, AcquireOnlyBelowMountDirectory)
+{
+	addFakeContainer("container");
+	DockerPool::Container container;
+	EXPECT_FALSE(DockerPool::get()->acquire(filesystem::temp_directory_path(), container));
+	ASSERT_TRUE(DockerPool::get()->acquire(workingDirectory, container));
+	EXPECT_EQ(container.name, "container");
+	EXPECT_FALSE(DockerPool::get()->acquire(workingDirectory, container)) << "Busy container was acquired again";
+}
+
+// Tests that containers are replaced after the maximum number of jobs or a failed job
+TEST_F(DockerPoolTest, ContainersAreRecycled)
+{
+	DockerPool& pool = *DockerPool::get();
+	int firstOutput = addFakeContainer("first");
+	DockerPool::Container container;
+
+	ASSERT_TRUE(pool.acquire(workingDirectory, container));
+	pool.release(container, false);
+	ASSERT_TRUE(pool.acquire(workingDirectory, container));
+	EXPECT_EQ(container.name, "first") << "Container was not reused";
+	EXPECT_EQ(container.jobs, 1);
+	pool.release(container, false);
+	EXPECT_TRUE(isClosed(firstOutput)) << "Container was not stopped after the maximum number of jobs";
+
+	int secondOutput = addFakeContainer("second");
+	ASSERT_TRUE(pool.acquire(workingDirectory, container));
+	EXPECT_EQ(container.name, "second");
+	pool.release(container, true);
+	EXPECT_TRUE(isClosed(secondOutput)) << "Container was not stopped after a failed job";
+}
+
+// Tests that containers are only used for the batch, whose directory they mount
+TEST_F(DockerPoolTest, ContainersAreBoundToBatch)
+{
+	DockerPool& pool = *DockerPool::get();
+	filesystem::path otherDirectory = mountDirectory / "other";
+	filesystem::create_directories(otherDirectory / "working");
+	int output = addFakeContainer("container");
+	EXPECT_EQ(pool.getBatchDirectory(workingDirectory / "."), filesystem::canonical(workingDirectory));
+	EXPECT_EQ(pool.getBatchDirectory(otherDirectory / "working"), filesystem::canonical(otherDirectory));
+	EXPECT_EQ(pool.getBatchDirectory(mountDirectory), "");
+
+	//No docker is found, so the replacing container can not be started
+	string path = getenv("PATH");
+	setenv("PATH", mountDirectory.c_str(), 1);
+	DockerPool::Container container;
+	bool acquired = pool.acquire(otherDirectory / "working", container);
+	setenv("PATH", path.c_str(), 1);
+	EXPECT_FALSE(acquired) << "Container of another batch was acquired";
+	EXPECT_TRUE(isClosed(output)) << "Idle container of another batch was not replaced in a full pool";
+	EXPECT_TRUE(pool.idle.empty());
+	EXPECT_EQ(pool.running, 0);
+
+	int batchOutput = addFakeContainer("batch");
+	pool.releaseBatch(workingDirectory / "output");
+	EXPECT_TRUE(isClosed(batchOutput)) << "Container of a finished batch was not stopped";
+	EXPECT_EQ(pool.running, 0);
+}
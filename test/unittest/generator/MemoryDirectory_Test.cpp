@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#define protected public
+#define private public
+
+#include "MemoryDirectory.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+class MemoryDirectoryTest : public ::testing::Test {
+protected:
+	filesystem::path directory;
+
+	MemoryDirectoryTest()
+	{
+	}
+
+	~MemoryDirectoryTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+		directory = filesystem::temp_directory_path();
+		directory.append("memoryDirectoryTest");
+	}
+
+	void TearDown() override
+	{
+		error_code ignoreErrors;
+		filesystem::remove_all(directory, ignoreErrors);
+		MemoryDirectory::singleton = nullptr;
+	}
+
+	//Writes a file of the given size
+	void writeFile(const filesystem::path& file, size_t size)
+	{
+		ofstream output(file, ios::out | ios::binary);
+		output << string(size, 'x');
+	}
+};
+
+// Tests that the memory directory is disabled until it is set up
+TEST_F(MemoryDirectoryTest, DisabledByDefault)
+{
+	EXPECT_EQ(MemoryDirectory::get(), nullptr);
+	MemoryDirectory::setup(directory);
+	ASSERT_NE(MemoryDirectory::get(), nullptr);
+	EXPECT_TRUE(filesystem::is_directory(directory));
+	EXPECT_THROW(MemoryDirectory::setup(directory), ConfigurationError);
+}
+
+// Tests that the size of all files in the batch directories is counted
+TEST_F(MemoryDirectoryTest, CountsUsage)
+{
+	MemoryDirectory::setup(directory, 100);
+	MemoryDirectory& memoryDirectory = *MemoryDirectory::get();
+	filesystem::path first = memoryDirectory.createDirectory("first");
+	ASSERT_FALSE(first.empty());
+	filesystem::create_directories(first / "working");
+	writeFile(first / "working" / "a.pdf", 30);
+	filesystem::path second = memoryDirectory.createDirectory("second");
+	ASSERT_FALSE(second.empty());
+	writeFile(second / "b.pdf", 20);
+	EXPECT_EQ(memoryDirectory.getUsage(), 50);
+
+	//Resources are linked into every job directory, but only stored once
+	filesystem::create_directories(second / "test.job0");
+	filesystem::create_hard_link(second / "b.pdf", second / "test.job0" / "b.pdf");
+	EXPECT_EQ(memoryDirectory.getUsage(), 50) << "Hard linked file was counted twice";
+}
+
+// Tests that no more batch directories are created, if the size limit is reached
+TEST_F(MemoryDirectoryTest, RespectsSizeLimit)
+{
+	MemoryDirectory::setup(directory, 100);
+	MemoryDirectory& memoryDirectory = *MemoryDirectory::get();
+	filesystem::path first = memoryDirectory.createDirectory("first");
+	ASSERT_FALSE(first.empty());
+	writeFile(first / "a.pdf", 100);
+	EXPECT_TRUE(memoryDirectory.createDirectory("second").empty()) << "Directory was created in full memory directory";
+	filesystem::remove(first / "a.pdf");
+	EXPECT_FALSE(memoryDirectory.createDirectory("second").empty());
+}
+
+// Tests that tmpfs directories are recognized
+TEST_F(MemoryDirectoryTest, RecognizesTmpfs)
+{
+	if (!filesystem::is_directory("/dev/shm")) {
+		GTEST_SKIP() << "No /dev/shm";
+	}
+	EXPECT_TRUE(MemoryDirectory::isMemoryBacked("/dev/shm"));
+	EXPECT_FALSE(MemoryDirectory::isMemoryBacked(directory / "missing"));
+}
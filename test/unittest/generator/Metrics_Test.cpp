@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Metrics.hpp"
+#include "MetricsEndpoint.hpp"
+
+using namespace std;
+
+class MetricsTest : public ::testing::Test {
+protected:
+	MetricsTest()
+	{
+	}
+
+	~MetricsTest() override
+	{
+	}
+
+	//Sends a request to the endpoint and returns the response
+	string request(unsigned short port, const string& request)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in address {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+		if (connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+			close(fd);
+			return "";
+		}
+		send(fd, request.data(), request.size(), 0);
+		string response;
+		char buffer[1024];
+		ssize_t received;
+		while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+			response.append(buffer, received);
+		}
+		close(fd);
+		return response;
+	}
+};
+
+// Tests that counters, gauges and callbacks are rendered in the text exposition format
+TEST_F(MetricsTest, RendersCountersAndGauges)
+{
+	Metrics metrics;
+	metrics.counter("test_requests_total", "Requests", "method=\"a\"").increment(3);
+	metrics.counter("test_requests_total", "Requests", "method=\"b\"").increment();
+	metrics.counter("test_requests_total", "Requests", "method=\"a\"").increment();
+	metrics.gauge("test_running", "Running").add(2);
+	metrics.callback("test_size_bytes", "gauge", "Size", []() { return 1.5; });
+
+	string rendered = metrics.render();
+	EXPECT_NE(rendered.find("# HELP test_requests_total Requests\n# TYPE test_requests_total counter\n"), string::npos) << rendered;
+	EXPECT_NE(rendered.find("test_requests_total{method=\"a\"} 4\n"), string::npos) << rendered;
+	EXPECT_NE(rendered.find("test_requests_total{method=\"b\"} 1\n"), string::npos) << rendered;
+	EXPECT_NE(rendered.find("# TYPE test_running gauge\ntest_running 2\n"), string::npos) << rendered;
+	EXPECT_NE(rendered.find("test_size_bytes 1.5\n"), string::npos) << rendered;
+	EXPECT_THROW(metrics.gauge("test_requests_total", "Requests"), ConfigurationError);
+}
+
+// Tests that histograms count observations in cumulative buckets
+TEST_F(MetricsTest, RendersHistograms)
+{
+	Metrics metrics;
+	Metrics::Histogram& histogram = metrics.histogram("test_seconds", "Durations", "", { 0.1, 1 });
+	histogram.observe(0.05);
+	histogram.observe(0.5);
+	histogram.observe(0.5);
+	histogram.observe(5);
+	EXPECT_EQ(histogram.getCount(), 4);
+	EXPECT_DOUBLE_EQ(histogram.getSum(), 6.05);
+
+	string rendered = metrics.render();
+	EXPECT_NE(rendered.find("test_seconds_bucket{le=\"0.1\"} 1\ntest_seconds_bucket{le=\"1\"} 3\ntest_seconds_bucket{le=\"+Inf\"} 4\n"), string::npos) << rendered;
+	EXPECT_NE(rendered.find("test_seconds_sum 6.05\ntest_seconds_count 4\n"), string::npos) << rendered;
+}
+
+// Tests that a timer records the duration of its scope and counts exceptions
+TEST_F(MetricsTest, ScopedTimerCountsErrors)
+{
+	Metrics metrics;
+	Metrics::Histogram& histogram = metrics.histogram("test_call_seconds", "Calls");
+	Metrics::Counter& errors = metrics.counter("test_call_errors_total", "Errors");
+	{
+		Metrics::ScopedTimer timer(histogram, &errors);
+	}
+	try {
+		Metrics::ScopedTimer timer(histogram, &errors);
+		throw runtime_error("failed");
+	} catch (const runtime_error&) {
+	}
+	EXPECT_EQ(histogram.getCount(), 2);
+	EXPECT_EQ(errors.getValue(), 1);
+}
+
+// Tests that the endpoint serves the metrics over http
+TEST_F(MetricsTest, EndpointServesMetrics)
+{
+	Metrics metrics;
+	metrics.counter("test_served_total", "Served").increment(7);
+	MetricsEndpoint endpoint(metrics, 0);
+	ASSERT_NE(endpoint.getPort(), 0);
+
+	string response = request(endpoint.getPort(), "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+	EXPECT_EQ(response.rfind("HTTP/1.1 200 OK\r\n", 0), 0) << response;
+	EXPECT_NE(response.find("\r\n\r\n# HELP test_served_total Served\n"), string::npos) << response;
+	EXPECT_NE(response.find("test_served_total 7\n"), string::npos) << response;
+
+	response = request(endpoint.getPort(), "GET /other HTTP/1.1\r\n\r\n");
+	EXPECT_EQ(response.rfind("HTTP/1.1 404 Not Found\r\n", 0), 0) << response;
+}
@@ -0,0 +1,137 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#define protected public
+#define private public
+
+#include "PdfCache.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+class PdfCacheTest : public ::testing::Test {
+protected:
+	filesystem::path directory;
+	filesystem::path cacheDirectory;
+
+	PdfCacheTest()
+	{
+	}
+
+	~PdfCacheTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+		directory = filesystem::temp_directory_path();
+		directory.append("pdfCacheTest");
+		cacheDirectory = directory;
+		cacheDirectory.append("cache");
+		filesystem::create_directories(directory);
+	}
+
+	void TearDown() override
+	{
+		error_code ignoreErrors;
+		filesystem::remove_all(directory, ignoreErrors);
+		PdfCache::singleton = nullptr;
+	}
+
+	//Writes a file of the given size and returns its path
+	filesystem::path writeFile(const string& name, size_t size)
+	{
+		filesystem::path file(directory);
+		file.append(name);
+		ofstream output(file, ios::out | ios::binary);
+		output << string(size, name[0]);
+		return file;
+	}
+};
+
+// Tests that the cache is disabled until it is set up
+TEST_F(PdfCacheTest, DisabledByDefault)
+{
+	EXPECT_EQ(PdfCache::get(), nullptr);
+	PdfCache::setup(cacheDirectory);
+	EXPECT_NE(PdfCache::get(), nullptr);
+	EXPECT_THROW(PdfCache::setup(cacheDirectory), ConfigurationError);
+}
+
+// Tests that stored pdfs are retrieved and hits and misses are counted
+TEST_F(PdfCacheTest, StoreAndRetrieve)
+{
+	PdfCache::setup(cacheDirectory);
+	PdfCache& cache = *PdfCache::get();
+	filesystem::path destination(directory);
+	destination.append("retrieved.pdf");
+
+	EXPECT_FALSE(cache.retrieve("key", destination));
+	cache.store("key", writeFile("a.pdf", 10));
+	EXPECT_TRUE(cache.contains("key"));
+	ASSERT_TRUE(cache.retrieve("key", destination));
+	EXPECT_EQ(filesystem::file_size(destination), 10);
+	EXPECT_EQ(cache.getHits(), 1);
+	EXPECT_EQ(cache.getMisses(), 1);
+	EXPECT_EQ(cache.getSize(), 10);
+}
+
+// Tests that the least recently used pdfs are removed, if the cache gets too big
+TEST_F(PdfCacheTest, EvictsLeastRecentlyUsed)
+{
+	PdfCache::setup(cacheDirectory, 25);
+	PdfCache& cache = *PdfCache::get();
+	filesystem::path destination(directory);
+	destination.append("retrieved.pdf");
+
+	cache.store("a", writeFile("a.pdf", 10));
+	cache.store("b", writeFile("b.pdf", 10));
+	ASSERT_TRUE(cache.retrieve("a", destination));
+	cache.store("c", writeFile("c.pdf", 10));
+
+	EXPECT_TRUE(cache.contains("a"));
+	EXPECT_FALSE(cache.contains("b")) << "Least recently used pdf was not evicted";
+	EXPECT_TRUE(cache.contains("c"));
+	EXPECT_EQ(cache.getSize(), 20);
+	EXPECT_FALSE(filesystem::exists(cache.getPath("b")));
+}
+
+// Tests that cached pdfs of an earlier run are loaded
+TEST_F(PdfCacheTest, LoadsExistingPdfs)
+{
+	PdfCache::setup(cacheDirectory);
+	PdfCache::get()->store("old", writeFile("a.pdf", 10));
+	PdfCache::singleton = nullptr;
+
+	PdfCache::setup(cacheDirectory);
+	EXPECT_TRUE(PdfCache::get()->contains("old"));
+	EXPECT_EQ(PdfCache::get()->getSize(), 10);
+}
+
+// Tests that pdfs, that are being retrieved, are not evicted
+TEST_F(PdfCacheTest, KeepsPinnedPdfs)
+{
+	PdfCache::setup(cacheDirectory, 15);
+	PdfCache& cache = *PdfCache::get();
+	filesystem::path destination(directory);
+	destination.append("retrieved.pdf");
+
+	cache.store("a", writeFile("a.pdf", 10));
+	cache.entries["a"].pins++;
+	cache.store("b", writeFile("b.pdf", 10));
+	EXPECT_TRUE(cache.contains("a")) << "Pinned pdf was evicted";
+	EXPECT_FALSE(cache.contains("b"));
+	cache.entries["a"].pins--;
+
+	ASSERT_TRUE(cache.retrieve("a", destination));
+	EXPECT_EQ(cache.entries["a"].pins, 0);
+	EXPECT_EQ(filesystem::file_size(destination), 10);
+	EXPECT_EQ(distance(filesystem::directory_iterator(directory), filesystem::directory_iterator()), 4) << "Temporary file was not renamed";
+}
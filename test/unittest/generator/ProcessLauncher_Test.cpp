@@ -0,0 +1,109 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <wait.h>
+
+#include "ProcessLauncher.hpp"
+
+using namespace std;
+
+class ProcessLauncherTest : public ::testing::Test {
+protected:
+	filesystem::path directory;
+
+	ProcessLauncherTest()
+	{
+	}
+
+	~ProcessLauncherTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+		directory = filesystem::temp_directory_path();
+		directory.append("processLauncherTest");
+		filesystem::create_directories(directory);
+	}
+
+	void TearDown() override
+	{
+		error_code ignoreErrors;
+		filesystem::remove_all(directory, ignoreErrors);
+	}
+
+	//Launches the process and returns its exit status
+	int run(ProcessLauncher& launcher)
+	{
+		pid_t pid = launcher.launch();
+		int status;
+		waitpid(pid, &status, 0);
+		return status;
+	}
+
+	string readFile(const filesystem::path& file)
+	{
+		ifstream input(file);
+		stringstream content;
+		content << input.rdbuf();
+		return content.str();
+	}
+};
+
+// Tests that the process is executed in the working directory
+TEST_F(ProcessLauncherTest, UsesWorkingDirectory)
+{
+	ProcessLauncher launcher({ "sh", "-c", "pwd > pwd.txt; echo ignored" }, directory);
+	EXPECT_EQ(run(launcher), 0);
+	EXPECT_EQ(readFile(directory / "pwd.txt"), filesystem::canonical(directory).string() + "\n");
+}
+
+// Tests that resource limits and niceness are applied to the process, before it is executed
+TEST_F(ProcessLauncherTest, AppliesLimits)
+{
+	ProcessLauncher launcher({ "sh", "-c", "ulimit -t > limits.txt; ulimit -v >> limits.txt; nice >> limits.txt" }, directory);
+	launcher.setCpuTimeLimit(7);
+	launcher.setMemoryLimit(512 * 1024 * 1024);
+	launcher.setNiceness(5);
+	unsigned long long launches = ProcessLauncher::getLaunches();
+	EXPECT_EQ(run(launcher), 0);
+	EXPECT_EQ(readFile(directory / "limits.txt"), "7\n524288\n" + to_string(min(getpriority(PRIO_PROCESS, 0) + 5, 19)) + "\n");
+	EXPECT_EQ(ProcessLauncher::getLaunches(), launches + 1);
+}
+
+// Tests that a missing program is reported to the caller
+TEST_F(ProcessLauncherTest, MissingProgramThrows)
+{
+	ProcessLauncher launcher({ "certificate-generator-missing-program" }, directory);
+	EXPECT_THROW(launcher.launch(), LatexMissingError);
+	ProcessLauncher missingDirectory({ "true" }, directory / "missing");
+	EXPECT_THROW(missingDirectory.launch(), LatexMissingError);
+}
+
+// Tests that standard input and output can be connected to pipes
+TEST_F(ProcessLauncherTest, ConnectsInputAndOutput)
+{
+	int input[2];
+	int output[2];
+	ASSERT_EQ(pipe2(input, O_CLOEXEC), 0);
+	ASSERT_EQ(pipe2(output, O_CLOEXEC), 0);
+	ProcessLauncher launcher({ "tr", "a", "b" }, directory);
+	launcher.setInput(input[0]);
+	launcher.setOutput(output[1]);
+	pid_t pid = launcher.launch();
+	close(input[0]);
+	close(output[1]);
+	EXPECT_EQ(write(input[1], "aaa", 3), 3);
+	close(input[1]);
+	char buffer[4] = {};
+	EXPECT_EQ(read(output[0], buffer, 3), 3);
+	close(output[0]);
+	EXPECT_STREQ(buffer, "bbb");
+	int status;
+	waitpid(pid, &status, 0);
+	EXPECT_EQ(status, 0);
+}
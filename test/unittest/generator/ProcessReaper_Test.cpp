@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "ProcessReaper.hpp"
+
+using namespace std;
+
+class ProcessReaperTest : public ::testing::Test {
+protected:
+	ProcessReaperTest()
+	{
+	}
+
+	~ProcessReaperTest() override
+	{
+	}
+
+	//Starts /bin/sleep with the given argument
+	pid_t startSleep(const char* seconds)
+	{
+		pid_t pid = fork();
+		if (pid == 0) {
+			execl("/bin/sleep", "sleep", seconds, nullptr);
+			_exit(127);
+		}
+		return pid;
+	}
+};
+
+// Tests that the exit status of a finished process is returned
+TEST_F(ProcessReaperTest, ReturnsExitStatus)
+{
+	atomic_bool killswitch = false;
+	pid_t pid = startSleep("0");
+	ASSERT_GT(pid, 0);
+	int status = ProcessReaper::get().waitForExit(pid, killswitch, 10s);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+// Tests that the resource usage of the process is returned
+TEST_F(ProcessReaperTest, ReturnsResourceUsage)
+{
+	atomic_bool killswitch = false;
+	pid_t pid = startSleep("0");
+	ASSERT_GT(pid, 0);
+	rusage usage = {};
+	ProcessReaper::get().waitForExit(pid, killswitch, 10s, &usage);
+	EXPECT_GT(usage.ru_maxrss, 0) << "Peak memory of the process is missing";
+}
+
+// Tests that a short process is reaped without the delay of a polling interval
+TEST_F(ProcessReaperTest, ShortProcessReturnsQuickly)
+{
+	atomic_bool killswitch = false;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < 20; i++) {
+		pid_t pid = startSleep("0");
+		ASSERT_GT(pid, 0);
+		ProcessReaper::get().waitForExit(pid, killswitch, 10s);
+	}
+	chrono::steady_clock::duration duration = chrono::steady_clock::now() - start;
+	EXPECT_LT(duration, 2s);
+}
+
+// Tests that a process gets terminated after the timeout
+TEST_F(ProcessReaperTest, TimeoutTerminatesProcess)
+{
+	atomic_bool killswitch = false;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	pid_t pid = startSleep("30");
+	ASSERT_GT(pid, 0);
+	int status = ProcessReaper::get().waitForExit(pid, killswitch, 1s);
+	chrono::steady_clock::duration duration = chrono::steady_clock::now() - start;
+	EXPECT_TRUE(WIFSIGNALED(status));
+	EXPECT_EQ(WTERMSIG(status), SIGTERM);
+	EXPECT_LT(duration, 5s);
+}
+
+// Tests that setting the killswitch kills the process
+TEST_F(ProcessReaperTest, KillswitchKillsProcess)
+{
+	atomic_bool killswitch = false;
+	pid_t pid = startSleep("30");
+	ASSERT_GT(pid, 0);
+	thread trigger([&killswitch]() {
+		this_thread::sleep_for(50ms);
+		killswitch = true;
+		ProcessReaper::get().notifyKillswitch();
+	});
+	int status = ProcessReaper::get().waitForExit(pid, killswitch, 30s);
+	trigger.join();
+	EXPECT_TRUE(WIFSIGNALED(status));
+	EXPECT_EQ(WTERMSIG(status), SIGKILL);
+}
+
+// Tests that multiple processes can be waited for in parallel
+TEST_F(ProcessReaperTest, ParallelWaitsWork)
+{
+	atomic_bool killswitch = false;
+	atomic_int successful = 0;
+	vector<thread> threads;
+	for (int i = 0; i < 8; i++) {
+		threads.emplace_back([this, &killswitch, &successful]() {
+			pid_t pid = startSleep("0.1");
+			int status = ProcessReaper::get().waitForExit(pid, killswitch, 10s);
+			if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+				successful++;
+			}
+		});
+	}
+	for (thread& t : threads) {
+		t.join();
+	}
+	EXPECT_EQ(successful, 8);
+}
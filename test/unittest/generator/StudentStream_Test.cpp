@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#define protected public
+#define private public
+
+#include "StudentStream.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+class StudentStreamTest : public ::testing::Test {
+protected:
+	StudentStreamTest()
+	{
+	}
+
+	~StudentStreamTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+	}
+
+	void TearDown() override
+	{
+	}
+
+	//Returns the names of the students of a StudentStream
+	vector<string> readNames(const StudentStream& students)
+	{
+		vector<string> names;
+		students.forEachStudent([&names](const Student& student) {
+			names.push_back(*student.getStringProperty("name"));
+			return true;
+		});
+		return names;
+	}
+};
+
+// Tests that the configuration of a json batch configuration is read without the students
+TEST_F(StudentStreamTest, ReadsConfigurationWithoutStudents)
+{
+	StudentStream students = StudentStream::fromString("{\n\"students\":[{\"name\":\"Max\"},{\"name\":\"Tim\"}],\n\"templates\":[\"a.tex\"],\"tester\":{\"name\":\"Someone\"}\n}");
+	json configuration = students.readConfiguration();
+	EXPECT_FALSE(configuration.contains("students"));
+	EXPECT_EQ(configuration["templates"], json::array({ "a.tex" }));
+	EXPECT_EQ(configuration["tester"]["name"], "Someone");
+	EXPECT_EQ(readNames(students), vector<string>({ "Max", "Tim" }));
+}
+
+// Tests that the configuration is read without parsing the students
+TEST_F(StudentStreamTest, SkipsStudentsInConfiguration)
+{
+	//The students are invalid, but only their brackets are matched
+	StudentStream students = StudentStream::fromString("{\"students\" : [{\"name\":\"M]a}x\\\"\", \"tasks\":[invalid]}] ,\"templates\":[\"a.tex\"]}");
+	EXPECT_EQ(students.readConfiguration(), json::parse("{\"templates\":[\"a.tex\"]}"));
+	EXPECT_EQ(StudentStream::fromString("{\"templates\":[],\"students\":null}").readConfiguration(), json::parse("{\"templates\":[]}"));
+	EXPECT_THROW(StudentStream::fromString("{\"students\":{}}").readConfiguration(), InvalidConfigurationError);
+	EXPECT_THROW(StudentStream::fromString("{\"students\":[{}").readConfiguration(), InvalidConfigurationError);
+}
+
+// Tests that json lines contain the configuration in the first line and a student in every other line
+TEST_F(StudentStreamTest, ReadsJsonLines)
+{
+	StudentStream students = StudentStream::fromString("{\"templates\":[\"a.tex\"]}\n{\"name\":\"Max\",\"tasks\":[{\"name\":\"a\"}]}\n\n{\"name\":\"Tim\"}\n");
+	json configuration = students.readConfiguration();
+	EXPECT_EQ(configuration, json::parse("{\"templates\":[\"a.tex\"]}"));
+	EXPECT_EQ(readNames(students), vector<string>({ "Max", "Tim" }));
+}
+
+// Tests that invalid batch configurations are reported as InvalidConfigurationError
+TEST_F(StudentStreamTest, InvalidConfigurationThrows)
+{
+	EXPECT_THROW(StudentStream::fromString("{\"students\":[").readConfiguration(), InvalidConfigurationError);
+	EXPECT_THROW(StudentStream::fromString("[]").readConfiguration(), InvalidConfigurationError);
+	EXPECT_THROW(readNames(StudentStream::fromString("{\"students\":{}}")), InvalidConfigurationError);
+	EXPECT_THROW(readNames(StudentStream::fromString("{\"students\":[\"Max\"]}")), InvalidConfigurationError);
+	EXPECT_THROW(readNames(StudentStream::fromString("{}\n{\"name\":")), InvalidConfigurationError);
+	EXPECT_THROW(StudentStream::fromFile("/nonexistent/batch.json").readConfiguration(), FileAccessError);
+}
+
+// Tests that students in memory are iterated without reading a configuration
+TEST_F(StudentStreamTest, StudentsInMemory)
+{
+	StudentStream students(json::parse("[{\"name\":\"Max\"},{\"name\":\"Tim\"}]"));
+	EXPECT_EQ(readNames(students), vector<string>({ "Max", "Tim" }));
+	EXPECT_EQ(students.readConfiguration(), json::object());
+	EXPECT_TRUE(readNames(StudentStream(json())).empty());
+}
+
+// Tests that the students after the callback returned false are not parsed
+TEST_F(StudentStreamTest, CallbackStopsParsing)
+{
+	//The students after Max are invalid, so parsing them would throw
+	for (const char* configuration : { "{\"students\":[{\"name\":\"Max\"},{\"name\":", "{}\n{\"name\":\"Max\"}\n{\"name\":" }) {
+		vector<string> names;
+		EXPECT_NO_THROW(StudentStream::fromString(configuration).forEachStudent([&names](const Student& student) {
+			names.push_back(*student.getStringProperty("name"));
+			return false;
+		}));
+		EXPECT_EQ(names, vector<string>({ "Max" }));
+	}
+	size_t count = 0;
+	StudentStream(json::parse("[{\"name\":\"Max\"},{\"name\":\"Tim\"}]")).forEachStudent([&count](const Student&) {
+		count++;
+		return false;
+	});
+	EXPECT_EQ(count, 1);
+}
@@ -0,0 +1,146 @@
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#define protected public
+#define private public
+
+#include "TemplateCertificate.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+class TemplateCertificateTest : public ::testing::Test {
+protected:
+	json globalProperties;
+	string staticPreamble = "\\documentclass{article}\n"
+							"\\usepackage{amsmath}\n";
+	string testTemplate = staticPreamble + "\\usepackage{certificate-generator}\n"
+										   "\\title{\\substitude{name}}\n"
+										   "\\begin{document}\n"
+										   "Hello \\substitude{name}\n"
+										   "\\end{document}\n";
+
+	TemplateCertificateTest()
+	{
+		globalProperties = json::parse("{\"name\":\"global\"}");
+	}
+
+	~TemplateCertificateTest() override
+	{
+	}
+};
+
+// Tests that the static preamble ends before the first line with a substitution
+TEST_F(TemplateCertificateTest, StaticPreambleStopsAtFirstTag)
+{
+	TemplateCertificate templateCertificate("test", testTemplate, globalProperties);
+	ASSERT_TRUE(templateCertificate.hasFormat());
+	EXPECT_EQ(templateCertificate.formatPreamble, staticPreamble + "\n");
+}
+
+// Tests that templates without a documentclass before the first tag have no format
+TEST_F(TemplateCertificateTest, NoFormatWithoutStaticDocumentclass)
+{
+	TemplateCertificate templateCertificate("test", "\\documentclass{\\substitude{class}}\n\\begin{document}\n\\end{document}\n", globalProperties);
+	EXPECT_FALSE(templateCertificate.hasFormat());
+}
+
+// Tests that the format certificate contains the static preamble and dumps it
+TEST_F(TemplateCertificateTest, FormatCertificateDumpsPreamble)
+{
+	TemplateCertificate templateCertificate("test", testTemplate, globalProperties);
+	Certificate formatCertificate = templateCertificate.generateFormatCertificate();
+	EXPECT_EQ(formatCertificate.getContent(), templateCertificate.formatPreamble + "\\dump\n");
+	EXPECT_EQ(formatCertificate.getName().substr(0, 7), "format_");
+}
+
+// Tests that templates with the same preamble share a format
+TEST_F(TemplateCertificateTest, SamePreambleSameFormat)
+{
+	TemplateCertificate first("first", testTemplate, globalProperties);
+	TemplateCertificate second("second", testTemplate + "% different body\n", globalProperties);
+	EXPECT_EQ(first.generateFormatCertificate().getName(), second.generateFormatCertificate().getName());
+}
+
+// Tests that generated certificates omit the static preamble only if the format is enabled
+TEST_F(TemplateCertificateTest, EnabledFormatStripsPreamble)
+{
+	Student student(json::parse("{\"name\":\"student\"}"));
+	TemplateCertificate templateCertificate("test", testTemplate, globalProperties);
+
+	Certificate withoutFormat = templateCertificate.generateCertificate(student);
+	EXPECT_EQ(withoutFormat.getFormat(), "");
+	EXPECT_EQ(withoutFormat.getContent().substr(0, staticPreamble.size()), staticPreamble);
+
+	templateCertificate.enableFormat();
+	Certificate withFormat = templateCertificate.generateCertificate(student);
+	EXPECT_EQ(withFormat.getFormat(), templateCertificate.generateFormatCertificate().getName());
+	EXPECT_EQ(templateCertificate.formatPreamble + withFormat.getContent(), withoutFormat.getContent());
+}
+
+// Tests that combined certificates contain the static preamble once and every body in order
+TEST_F(TemplateCertificateTest, CombinedCertificateContainsEveryBody)
+{
+	TemplateCertificate templateCertificate("test", testTemplate, globalProperties);
+	ASSERT_TRUE(templateCertificate.canCombine());
+	vector<Certificate> parts = { templateCertificate.generateCertificate(Student(json::parse("{\"name\":\"first\"}"))),
+		templateCertificate.generateCertificate(Student(json::parse("{\"name\":\"second\"}"))) };
+	CombinedCertificate combined = templateCertificate.generateCombinedCertificate(parts);
+	string content = combined.getContent();
+
+	EXPECT_EQ(combined.getParts().size(), 2);
+	EXPECT_EQ(combined.getName(), "test_combined_1");
+	EXPECT_EQ(content.substr(0, staticPreamble.size()), staticPreamble);
+	EXPECT_EQ(content.find("\\documentclass", 1), string::npos) << "Static preamble is contained more than once";
+	size_t first = content.find("Hello first");
+	size_t second = content.find("Hello second");
+	ASSERT_NE(first, string::npos);
+	ASSERT_NE(second, string::npos);
+	EXPECT_LT(first, second);
+	EXPECT_LT(content.find("\\title{first}"), first);
+	EXPECT_EQ(content.find("\\begin{document}"), content.rfind("\\begin{document}"));
+	EXPECT_EQ(content.find("\\end{document}"), content.rfind("\\end{document}"));
+}
+
+// Tests that templates are compiled into literals, substitutions and optionals
+TEST_F(TemplateCertificateTest, CompilesTemplateOnce)
+{
+	TemplateCertificate templateCertificate("test", "A \\substitude[student]{name} B \\optional{tasks}{\\substitude{grade}}\nC", globalProperties);
+	const vector<TemplateSegment>& segments = templateCertificate.compiledTemplate;
+	ASSERT_EQ(segments.size(), 5);
+	EXPECT_EQ(segments[0].type, TemplateSegment::LITERAL);
+	EXPECT_EQ(segments[1].type, TemplateSegment::SUBSTITUTION);
+	EXPECT_EQ(segments[1].tagNamespace, "student");
+	EXPECT_EQ(segments[1].name, "name");
+	EXPECT_EQ(segments[3].type, TemplateSegment::OPTIONAL);
+	EXPECT_EQ(segments[3].name, "tasks");
+	ASSERT_EQ(segments[3].body.size(), 1);
+	EXPECT_EQ(segments[3].body[0].tagNamespace, "auto");
+	EXPECT_EQ(segments[4].type, TemplateSegment::LITERAL);
+}
+
+// Tests that optionals are repeated for every entry and fall back to the student and global properties
+TEST_F(TemplateCertificateTest, RendersOptionals)
+{
+	TemplateCertificate templateCertificate("test", "\\optional{tasks}{\\substitude{grade}/\\substitude{name};}\nEnd", globalProperties);
+	Student student(json::parse("{\"name\":\"student\",\"tasks\":[{\"grade\":\"1\",\"name\":\"first\"},{\"grade\":\"2\"}]}"));
+	EXPECT_EQ(templateCertificate.generateCertificate(student).getContent(), "1/first;2/student;End");
+
+	Student withoutArray(json::parse("{\"name\":\"student\"}"));
+	EXPECT_THROW(templateCertificate.generateCertificate(withoutArray), InvalidConfigurationError);
+}
+
+// Tests that missing properties and unterminated tags are detected
+TEST_F(TemplateCertificateTest, InvalidTagsThrow)
+{
+	EXPECT_THROW(TemplateCertificate("test", "\\substitude{name", globalProperties), InvalidTemplateError);
+	EXPECT_THROW(TemplateCertificate("test", "\\optional{tasks}{\\substitude{name}", globalProperties), InvalidTemplateError);
+
+	TemplateCertificate templateCertificate("test", "\\substitude[student]{missing}", globalProperties);
+	EXPECT_THROW(templateCertificate.generateCertificate(Student(json::parse("{}"))), InvalidConfigurationError);
+}
@@ -0,0 +1,150 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#define protected public
+#define private public
+
+#include "Certificate.hpp"
+#include "Configuration.hpp"
+#include "Trace.hpp"
+
+#undef protected
+#undef private
+
+using namespace std;
+
+class TraceTest : public ::testing::Test {
+protected:
+	filesystem::path directory;
+
+	TraceTest()
+	{
+	}
+
+	~TraceTest() override
+	{
+	}
+
+	void SetUp() override
+	{
+		directory = filesystem::temp_directory_path() / "traceTest";
+		filesystem::remove_all(directory);
+		filesystem::create_directories(directory);
+	}
+
+	void TearDown() override
+	{
+		Trace::outputDirectory.clear();
+		Configuration::singleton = nullptr;
+		filesystem::remove_all(directory);
+	}
+};
+
+// Tests that the durations of every stage are summed up
+TEST_F(TraceTest, RecordsStageStatistics)
+{
+	Trace trace("42");
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	trace.record(Trace::COMPILE, start, start + chrono::milliseconds(30), "a");
+	trace.record(Trace::COMPILE, start, start + chrono::milliseconds(10), "b");
+	string name = "a";
+	{
+		Trace::Span span(&trace, Trace::LAUNCH, name);
+	}
+	Trace::Span ignoredSpan(nullptr, Trace::LAUNCH, name);
+
+	Trace::StageStatistics compile = trace.getStatistics(Trace::COMPILE);
+	EXPECT_EQ(compile.count, 2);
+	EXPECT_EQ(compile.totalTime, chrono::milliseconds(40));
+	EXPECT_EQ(compile.maxTime, chrono::milliseconds(30));
+	EXPECT_EQ(trace.getStatistics(Trace::LAUNCH).count, 1);
+	EXPECT_EQ(trace.getStatistics(Trace::QUEUE_WAIT).count, 0);
+	EXPECT_TRUE(trace.events.empty());
+
+	string summary = trace.summary();
+	EXPECT_EQ(summary.rfind("Batch 42 stages:", 0), 0) << summary;
+	EXPECT_NE(summary.find(" compile 2x 40ms (max 30ms)"), string::npos) << summary;
+	EXPECT_EQ(summary.find("queueWait"), string::npos) << summary;
+}
+
+// Tests that the events are written as a Chrome trace, if an output directory is set
+TEST_F(TraceTest, WritesChromeTrace)
+{
+	Trace::setOutputDirectory(directory / "traces");
+	Trace trace("/tmp/batch 1");
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	trace.record(Trace::QUEUE_WAIT, start, start + chrono::milliseconds(5), "certificate");
+	trace.record(Trace::COMPILE, start + chrono::milliseconds(5), start + chrono::milliseconds(15), "certificate");
+
+	filesystem::path file = trace.writeChromeTrace();
+	ASSERT_FALSE(file.empty());
+	EXPECT_EQ(file.parent_path(), directory / "traces");
+	EXPECT_EQ(file.filename().string().rfind("trace-_tmp_batch_1-", 0), 0) << file;
+
+	ifstream input(file);
+	json written = json::parse(input);
+	ASSERT_EQ(written["traceEvents"].size(), 3);
+	EXPECT_EQ(written["traceEvents"][0]["ph"], "b");
+	EXPECT_EQ(written["traceEvents"][1]["ph"], "e");
+	json compile = written["traceEvents"][2];
+	EXPECT_EQ(compile["name"], "compile");
+	EXPECT_EQ(compile["ph"], "X");
+	EXPECT_EQ(compile["args"]["batch"], "/tmp/batch 1");
+	EXPECT_EQ(compile["args"]["certificate"], "certificate");
+	EXPECT_NEAR(compile["dur"].get<double>(), 10000, 1);
+}
+
+// Tests that a Certificate records the stages of generating its pdf
+TEST_F(TraceTest, CertificateRecordsStages)
+{
+	Configuration::setup(false, DEFAULT_USE_THREAD, DEFAULT_MAX_BATCH_WORKERS, 4000000000, DEFAULT_MAX_CPU, DEFAULT_WORKER_TIMEOUT, DEFAULT_TIMEOUT, DEFAULT_MAX_WORKERS);
+	filesystem::create_directories(directory / "working");
+	filesystem::create_directories(directory / "output");
+	Certificate certificate("traced", "\\documentclass{article}\\begin{document}Traced\\end{document}");
+	Trace trace("traced");
+	certificate.setTrace(&trace);
+
+	ASSERT_FALSE(certificate.generatePDF(directory / "working", directory / "output", false).empty());
+	for (Trace::Stage stage : { Trace::GENERATE_PDF, Trace::CREATE_JOB_DIRECTORY, Trace::WRITE_TO_WORKING_DIRECTORY, Trace::LAUNCH, Trace::COMPILE, Trace::MOVE_RESULT_TO_OUTPUT_DIRECTORY, Trace::CLEAN_WORKING_DIRECTORY }) {
+		EXPECT_EQ(trace.getStatistics(stage).count, 1) << Trace::getStageName(stage);
+	}
+	EXPECT_EQ(trace.getStatistics(Trace::CACHE_LOOKUP).count, 0);
+	EXPECT_GE(trace.getStatistics(Trace::GENERATE_PDF).totalTime, trace.getStatistics(Trace::COMPILE).totalTime);
+}
+
+// Tests that the compiler runs are summed up per template and the slowest templates are summarized
+TEST_F(TraceTest, RecordsCompilerRunsPerTemplate)
+{
+	Trace trace("42");
+	CompilerRun run;
+	run.wallTime = chrono::milliseconds(100);
+	run.cpuTime = chrono::milliseconds(80);
+	run.peakMemory = 64 * 1024 * 1024;
+	trace.recordCompilerRun("slow", run, false);
+	trace.recordCompilerRun("slow", run, true);
+	run.wallTime = chrono::milliseconds(10);
+	trace.recordCompilerRun("fast", run, false);
+
+	map<string, Trace::CompilerStatistics> statistics = trace.getCompilerStatistics();
+	EXPECT_EQ(statistics["slow"].runs, 2);
+	EXPECT_EQ(statistics["slow"].failures, 1);
+	EXPECT_EQ(statistics["slow"].totalWallTime, chrono::milliseconds(200));
+	EXPECT_EQ(statistics["slow"].maxWallTime, chrono::milliseconds(100));
+	EXPECT_EQ(statistics["slow"].totalCpuTime, chrono::milliseconds(160));
+
+	string summary = trace.compilerSummary();
+	EXPECT_EQ(summary, "Batch 42 compilers: slow 2x 200ms (max 100ms) cpu 160ms peak 64MiB 1 failed, fast 1x 10ms (max 10ms) cpu 80ms peak 64MiB");
+	EXPECT_EQ(trace.compilerSummary(1), "Batch 42 compilers: slow 2x 200ms (max 100ms) cpu 160ms peak 64MiB 1 failed, 1 more");
+	EXPECT_EQ(Trace("empty").compilerSummary(), "Batch empty compilers: none");
+
+	//The usage of compilers in docker containers is unknown
+	run.measured = false;
+	Trace dockerTrace("docker");
+	dockerTrace.recordCompilerRun("container", run, false);
+	EXPECT_EQ(dockerTrace.getCompilerStatistics()["container"].totalCpuTime, chrono::microseconds(0));
+	EXPECT_EQ(dockerTrace.compilerSummary(), "Batch docker compilers: container 1x 10ms (max 10ms)");
+}
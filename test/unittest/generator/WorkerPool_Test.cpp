@@ -0,0 +1,221 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "WorkerPool.hpp"
+
+using namespace std;
+
+class WorkerPoolTest : public ::testing::Test {
+protected:
+	WorkerPoolTest()
+	{
+	}
+
+	~WorkerPoolTest() override
+	{
+	}
+};
+
+// Tests that every submitted job gets executed before JobQueue::wait returns
+TEST_F(WorkerPoolTest, WaitReturnsAfterAllJobs)
+{
+	WorkerPool pool(4);
+	shared_ptr<JobQueue> queue = pool.createQueue(4);
+	atomic_int executed = 0;
+	for (int i = 0; i < 100; i++) {
+		queue->submit([&executed]() { executed++; });
+	}
+	queue->wait();
+	EXPECT_EQ(executed, 100);
+}
+
+// Tests that the pool never uses more threads than it was created with
+TEST_F(WorkerPoolTest, ThreadCountIsBounded)
+{
+	WorkerPool pool(3);
+	shared_ptr<JobQueue> queue = pool.createQueue(100);
+	mutex threadIdsMutex;
+	set<thread::id> threadIds;
+	for (int i = 0; i < 1000; i++) {
+		queue->submit([&threadIds, &threadIdsMutex]() {
+			unique_lock<mutex> lock(threadIdsMutex);
+			threadIds.insert(this_thread::get_id());
+		});
+	}
+	queue->wait();
+	EXPECT_EQ(pool.size(), 3);
+	EXPECT_LE(threadIds.size(), 3) << "More threads than workers executed jobs";
+}
+
+// Tests that a queue never runs more jobs in parallel than it allows
+TEST_F(WorkerPoolTest, QueueRespectsMaxParallel)
+{
+	WorkerPool pool(8);
+	shared_ptr<JobQueue> queue = pool.createQueue(2);
+	atomic_int running = 0;
+	atomic_int maxRunning = 0;
+	for (int i = 0; i < 20; i++) {
+		queue->submit([&running, &maxRunning]() {
+			int now = ++running;
+			int seen = maxRunning;
+			while (now > seen && !maxRunning.compare_exchange_weak(seen, now)) {
+			}
+			this_thread::sleep_for(2ms);
+			running--;
+		});
+	}
+	queue->wait();
+	EXPECT_LE(maxRunning, 2) << "Queue ran more jobs in parallel than allowed";
+	EXPECT_GE(maxRunning, 1);
+}
+
+// Tests that a small queue gets its jobs executed while a big queue is still busy
+TEST_F(WorkerPoolTest, QueuesAreServedRoundRobin)
+{
+	WorkerPool pool(1);
+	shared_ptr<JobQueue> bigQueue = pool.createQueue(1);
+	shared_ptr<JobQueue> smallQueue = pool.createQueue(1);
+	atomic_int bigExecuted = 0;
+	atomic_int bigExecutedWhenSmallRan = -1;
+	for (int i = 0; i < 50; i++) {
+		bigQueue->submit([&bigExecuted]() {
+			this_thread::sleep_for(1ms);
+			bigExecuted++;
+		});
+	}
+	smallQueue->submit([&bigExecuted, &bigExecutedWhenSmallRan]() { bigExecutedWhenSmallRan = bigExecuted.load(); });
+	smallQueue->wait();
+	bigQueue->wait();
+	EXPECT_GE(bigExecutedWhenSmallRan, 0);
+	EXPECT_LT(bigExecutedWhenSmallRan, 50) << "Small queue had to wait for the whole big queue";
+}
+
+// Tests that an exception escaping a job does not stop the pool
+TEST_F(WorkerPoolTest, ThrowingJobDoesNotStopPool)
+{
+	WorkerPool pool(1);
+	shared_ptr<JobQueue> queue = pool.createQueue(1);
+	atomic_bool executed = false;
+	queue->submit([]() { throw runtime_error("job failed"); });
+	queue->submit([&executed]() { executed = true; });
+	queue->wait();
+	EXPECT_TRUE(executed);
+}
+
+// Tests that submit blocks while a bounded queue is full, unless it is told not to wait
+TEST_F(WorkerPoolTest, BoundedQueueBlocksSubmit)
+{
+	WorkerPool pool(1);
+	shared_ptr<JobQueue> queue = pool.createQueue(1, 1);
+	atomic_bool release = false;
+	atomic_bool started = false;
+	queue->submit([&release, &started]() {
+		started = true;
+		while (!release) {
+			this_thread::sleep_for(1ms);
+		}
+	});
+	while (!started) {
+		this_thread::sleep_for(1ms);
+	}
+	queue->submit([]() {});
+	queue->submit([]() {}, false);
+
+	atomic_bool submitted = false;
+	thread producer([&queue, &submitted]() {
+		queue->submit([]() {});
+		submitted = true;
+	});
+	this_thread::sleep_for(50ms);
+	EXPECT_FALSE(submitted) << "Job was submitted to a full queue";
+	release = true;
+	producer.join();
+	queue->wait();
+	EXPECT_TRUE(submitted);
+}
+
+// Tests that queues start jobs in proportion to their weights, while both have jobs waiting
+TEST_F(WorkerPoolTest, QueuesShareByWeight)
+{
+	WorkerPool pool(1);
+	shared_ptr<JobQueue> blockingQueue = pool.createQueue(1);
+	shared_ptr<JobQueue> heavyQueue = pool.createQueue(1, 0, 30);
+	shared_ptr<JobQueue> lightQueue = pool.createQueue(1, 0, 10);
+	atomic_bool release = false;
+	blockingQueue->submit([&release]() {
+		while (!release) {
+			this_thread::sleep_for(1ms);
+		}
+	});
+	mutex orderMutex;
+	string order;
+	for (int i = 0; i < 40; i++) {
+		heavyQueue->submit([&order, &orderMutex]() {
+			unique_lock<mutex> lock(orderMutex);
+			order.push_back('h');
+		});
+		lightQueue->submit([&order, &orderMutex]() {
+			unique_lock<mutex> lock(orderMutex);
+			order.push_back('l');
+		});
+	}
+	release = true;
+	heavyQueue->wait();
+	lightQueue->wait();
+	ASSERT_EQ(order.size(), 80);
+	long heavyJobs = count(order.begin(), order.begin() + 40, 'h');
+	EXPECT_GE(heavyJobs, 29) << "Order of jobs: " << order;
+	EXPECT_LE(heavyJobs, 31) << "Order of jobs: " << order;
+}
+
+// Tests that the statistics count the executed jobs and their wait times
+TEST_F(WorkerPoolTest, QueueRecordsStatistics)
+{
+	WorkerPool pool(1);
+	shared_ptr<JobQueue> queue = pool.createQueue(1);
+	for (int i = 0; i < 5; i++) {
+		queue->submit([]() { this_thread::sleep_for(2ms); });
+	}
+	queue->wait();
+	JobQueue::Statistics statistics = queue->getStatistics();
+	EXPECT_EQ(statistics.queuedJobs, 0);
+	EXPECT_GE(statistics.peakQueuedJobs, 4);
+	EXPECT_EQ(statistics.executedJobs, 5);
+	EXPECT_GE(statistics.maxWaitTime, 6ms);
+	EXPECT_GE(statistics.totalWaitTime, statistics.maxWaitTime);
+}
+
+// Tests that the waiting jobs of a queue are dropped after its deadline
+TEST_F(WorkerPoolTest, QueueDropsJobsAfterDeadline)
+{
+	WorkerPool pool(1);
+	shared_ptr<JobQueue> queue = pool.createQueue(1);
+	atomic_bool release = false;
+	atomic_int executed = 0;
+	queue->setDeadline(chrono::steady_clock::now() + 20ms);
+	queue->submit([&release, &executed]() {
+		while (!release) {
+			this_thread::sleep_for(1ms);
+		}
+		executed++;
+	});
+	for (int i = 0; i < 10; i++) {
+		queue->submit([&executed]() { executed++; });
+	}
+	this_thread::sleep_for(50ms);
+	release = true;
+	queue->wait();
+	queue->submit([&executed]() { executed++; });
+	queue->wait();
+	EXPECT_EQ(executed, 1) << "Jobs were executed after the deadline";
+	JobQueue::Statistics statistics = queue->getStatistics();
+	EXPECT_EQ(statistics.executedJobs, 1);
+	EXPECT_EQ(statistics.droppedJobs, 11);
+}